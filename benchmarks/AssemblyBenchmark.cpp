@@ -0,0 +1,173 @@
+// Checks that resolving independent assemblies on worker threads gives the same boards
+// as resolving them one after another, then measures turns with several large assemblies.
+//
+// Build and run natively:
+//     make bench
+//     ./build/bench/AssemblyBenchmark
+//
+// or with the Emscripten toolchain, threads need -pthread:
+//     emcc -O2 -pthread -s PTHREAD_POOL_SIZE=4 ./benchmarks/AssemblyBenchmark.cpp ./source/EntityManager.cpp ./source/TrajectoryCache.cpp ./source/Bitboard.cpp ./source/BitboardTranslator.cpp -I./source -s USE_SDL=2 -s ALLOW_MEMORY_GROWTH=1 -o assembly_benchmark.js
+//     node assembly_benchmark.js
+
+#include "EntityManager.h"
+
+#include <chrono>
+#include <cstdio>
+#include <stdint.h>
+
+static uint64_t randomState = 88172645463325252ull;
+
+static unsigned int Random()
+{
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 7;
+    randomState ^= randomState << 17;
+    return static_cast<unsigned int>(randomState);
+}
+
+// count blobs of movable pieces spread over the board among scattered obstacles,
+// blobs may start close enough to push each other
+static void Populate(EntityManager& em, BoardGeometry board, int count, int radius, int obstacleDensity)
+{
+    em.LoadBoard(board);
+
+    for (int k = 0; k < count; k++) {
+        int assemblyIndex = k == 0 ? 0 : em.AddAssembly();
+        pos center = pos{static_cast<int>(radius + Random() % (board.columns - 2 * radius)),
+                         static_cast<int>(radius + Random() % (board.rows - 2 * radius))};
+        em.AddEntity(EntityType::BENT_PIPE, center, true, UP, assemblyIndex);
+
+        for (int y = -radius; y <= radius; y++) {
+            for (int x = -radius; x <= radius; x++) {
+                if (Random() % 100 < 50) {
+                    EntityType type = Random() % 2 ? EntityType::BENT_PIPE : EntityType::STRAIGHT_PIPE;
+                    em.AddEntity(type, pos{center.x + x, center.y + y}, true, static_cast<Direction>(Random() % 4), assemblyIndex);
+                }
+            }
+        }
+    }
+
+    int obstacles = board.TileCount() * obstacleDensity / 100;
+    for (int i = 0; i < obstacles; i++) {
+        pos position = pos{static_cast<int>(Random() % board.columns), static_cast<int>(Random() % board.rows)};
+        EntityType type = Random() % 2 ? EntityType::BENT_PIPE : EntityType::STRAIGHT_PIPE;
+        em.AddEntity(type, position, false, static_cast<Direction>(Random() % 4));
+    }
+}
+
+static void Turn(EntityManager& em, unsigned int move)
+{
+    if (move < 4)
+        em.MoveAllToAdjacent(static_cast<Direction>(move));
+    else
+        em.RotateAll(move == 4 ? LEFT : RIGHT);
+}
+
+static bool SameState(EntityManager& a, EntityManager& b)
+{
+    if (a.numEntities != b.numEntities || a.isTurnOk != b.isTurnOk || a.assemblies.size() != b.assemblies.size())
+        return false;
+
+    for (int i = 0; i < a.numEntities; i++) {
+        if (a.positions[i].x != b.positions[i].x || a.positions[i].y != b.positions[i].y ||
+            a.orientations[i] != b.orientations[i] || a.isMovable.Test(i) != b.isMovable.Test(i))
+            return false;
+
+        for (int k = 0; k < a.assemblies.size(); k++) {
+            if (a.assemblies[k].members.Test(i) != b.assemblies[k].members.Test(i))
+                return false;
+        }
+    }
+
+    for (int tileIndex = 0; tileIndex < a.board.TileCount(); tileIndex++) {
+        if (a.tileToEntityMapping[tileIndex] != b.tileToEntityMapping[tileIndex])
+            return false;
+    }
+
+    return true;
+}
+
+static int CountDisagreements(int& turns)
+{
+    struct Case {
+        BoardGeometry board;
+        int count;
+        int radius;
+    };
+
+    const Case cases[] = {{{20, 16}, 3, 1}, {{40, 30}, 4, 2}, {{48, 24}, 12, 1}, {{64, 64}, 6, 3}, {{130, 40}, 8, 4}};
+    int disagreements = 0;
+
+    for (Case c : cases) {
+        for (int game = 0; game < 60; game++) {
+            EntityManager serial(c.board);
+            EntityManager parallel(c.board);
+            serial.workerCount = 1;
+            parallel.workerCount = 4;
+            parallel.parallelMinimumMembers = 0;
+
+            uint64_t seed = randomState;
+            int density = 2 + Random() % 40;
+            for (EntityManager* em : {&serial, &parallel}) {
+                randomState = seed;
+                Populate(*em, c.board, c.count, c.radius, density);
+            }
+
+            for (int turn = 0; turn < 80; turn++) {
+                unsigned int move = Random() % 6;
+                Turn(serial, move);
+                Turn(parallel, move);
+                turns++;
+
+                if (!SameState(serial, parallel)) {
+                    printf("disagreement on %dx%d, game %d, turn %d\n", c.board.columns, c.board.rows, game, turn);
+                    disagreements++;
+                    break;
+                }
+            }
+        }
+    }
+
+    return disagreements;
+}
+
+static double MicrosecondsPerTurn(BoardGeometry board, int count, int radius, int workerCount, bool isRotation, int turns)
+{
+    EntityManager em(board);
+    em.workerCount = workerCount;
+    randomState = 12345;
+    Populate(em, board, count, radius, 2);
+    em.PrebuildTrajectoryCache(BoardGeometry{2 * radius + 1, 2 * radius + 1});
+
+    static const unsigned int moveCycle[] = {RIGHT, DOWN, LEFT, UP};
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < turns; i++) {
+        Turn(em, isRotation ? 4 + i % 2 : moveCycle[i % 4]);
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::micro>(end - start).count() / turns;
+}
+
+int main()
+{
+    int turns = 0;
+    int disagreements = CountDisagreements(turns);
+    printf("differential check: %s over %d turns\n\n", disagreements == 0 ? "parallel matches serial" : "DISAGREEMENT", turns);
+
+    const BoardGeometry board = BoardGeometry{512, 512};
+    const int workers[] = {1, 2, 4};
+
+    printf("%dx%d, 4 assemblies of radius 40\n", board.columns, board.rows);
+    printf("%-8s %16s %16s\n", "workers", "move us/turn", "rotate us/turn");
+
+    for (int workerCount : workers) {
+        double move = MicrosecondsPerTurn(board, 4, 40, workerCount, false, 200);
+        double rotate = MicrosecondsPerTurn(board, 4, 40, workerCount, true, 40);
+        printf("%-8d %16.1f %16.1f\n", workerCount, move, rotate);
+    }
+
+    return disagreements == 0 ? 0 : 1;
+}
@@ -0,0 +1,197 @@
+// Checks that every lane of a batch plays a move as the engine plays it from the same
+// board, blocked lanes and lanes sitting out included, then compares playing the same
+// moves on many boards batched with playing them on one engine per board.
+//
+// Build and run natively, lanes are also spread over every hardware thread:
+//     make bench
+//     ./build/bench/BatchBenchmark
+//
+// Build with make SIMD=avx2 to have a block of lanes in one register.
+
+#include "EntityManager.h"
+#include "BoardBatch.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+static uint64_t randomState = 88172645463325252ull;
+
+static unsigned int Random()
+{
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 7;
+    randomState ^= randomState << 17;
+    return static_cast<unsigned int>(randomState);
+}
+
+// a movable blob about the pivot among scattered pieces of every type
+static void Populate(EntityManager& em, BoardGeometry board, int density)
+{
+    em.LoadBoard(board);
+    pos center = pos{board.columns / 2, board.rows / 2};
+    em.AddEntity(EntityType::BENT_PIPE, center, true, UP);
+
+    for (int y = -1; y <= 1; y++) {
+        for (int x = -1; x <= 1; x++) {
+            if (Random() % 100 < 40)
+                em.AddEntity(EntityType::STRAIGHT_PIPE, pos{center.x + x, center.y + y}, true, static_cast<Direction>(Random() % 4));
+        }
+    }
+
+    int count = board.columns * board.rows * density / 100;
+    for (int i = 0; i < count; i++) {
+        pos position = pos{static_cast<int>(Random() % board.columns), static_cast<int>(Random() % board.rows)};
+        unsigned int roll = Random() % 20;
+        EntityType type = roll == 0 ? EntityType::SOURCE : roll == 1 ? EntityType::SINK :
+                          roll == 2 ? EntityType::TEE_PIPE : roll == 3 ? EntityType::CROSS_PIPE :
+                          roll == 4 ? EntityType::BOX :
+                          roll % 2 ? EntityType::BENT_PIPE : EntityType::STRAIGHT_PIPE;
+        em.AddEntity(type, position, false, static_cast<Direction>(Random() % 4));
+    }
+}
+
+static Direction MoveDirection(int move)
+{
+    static const Direction directions[6] = {UP, LEFT, DOWN, RIGHT, LEFT, RIGHT};
+    return directions[move];
+}
+
+static bool IsLaneAsEngine(const BoardBatch& batch, int lane, const EntityManager& em)
+{
+    BoardGeometry board = batch.Geometry();
+    std::vector<PackedTile> tiles(board.TileCount(), 0);
+    for (int i = 0; i < static_cast<int>(em.numEntities); i++) {
+        tiles[em.positions[i].x + em.positions[i].y * board.columns] = PackTile(em.types[i], em.orientations[i], em.isMovable.Test(i));
+    }
+
+    for (int tileIndex = 0; tileIndex < board.TileCount(); tileIndex++) {
+        if (batch.Tile(lane, tileIndex) != tiles[tileIndex])
+            return false;
+    }
+
+    pos pivot;
+    int pivotTile = em.getPivotPosition(em.assemblies[0], pivot) ? pivot.x + pivot.y * board.columns : -1;
+    return batch.PivotTile(lane) == pivotTile && batch.Hash(lane) == em.hash;
+}
+
+static int CountDisagreements(int& laneTurns, int& blockedLaneTurns)
+{
+    const BoardGeometry boards[] = {{20, 16}, {9, 7}, {13, 11}};
+    const int laneCount = 300;
+    int disagreements = 0;
+
+    for (BoardGeometry board : boards) {
+        BoardBatch batch(board, laneCount);
+        batch.parallelMinimumLanes = 1;
+        EntityManager em(board);
+
+        for (int lane = 0; lane < laneCount; lane++) {
+            Populate(em, board, 10 + Random() % 50);
+            batch.Load(lane, em);
+            batch.SetActive(lane, lane % 7 != 3);
+        }
+
+        std::vector<EntityManager> expected(laneCount, em);
+        for (int step = 0; step < 40; step++) {
+            int move = Random() % 6;
+
+            // every lane's board played by the engine, lanes sitting out are only copied
+            for (int lane = 0; lane < laneCount; lane++) {
+                batch.Store(lane, expected[lane]);
+                if (batch.IsActive(lane))
+                    expected[lane].RunTurn(MoveDirection(move), move >= 4);
+            }
+
+            if (move >= 4)
+                batch.RotateAll(MoveDirection(move));
+            else
+                batch.MoveAllToAdjacent(MoveDirection(move));
+
+            for (int lane = 0; lane < laneCount; lane++) {
+                bool isTurnOk = batch.IsActive(lane) && expected[lane].isTurnOk;
+                laneTurns += batch.IsActive(lane);
+                blockedLaneTurns += batch.IsActive(lane) && !isTurnOk;
+
+                if (batch.IsTurnOk(lane) != isTurnOk || !IsLaneAsEngine(batch, lane, expected[lane])) {
+                    printf("lane %d differs from the engine on %dx%d, step %d, move %d\n", lane, board.columns, board.rows, step, move);
+                    disagreements++;
+                    batch.SetActive(lane, false);
+                }
+            }
+        }
+    }
+
+    return disagreements;
+}
+
+template<typename Turn>
+static double NanosecondsPerBoard(int boardCount, Turn turn)
+{
+    const int turns = 16;
+    auto start = std::chrono::steady_clock::now();
+    for (int n = 0; n < turns; n++) {
+        turn(n);
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / turns / boardCount;
+}
+
+int main()
+{
+    int laneTurns = 0;
+    int blockedLaneTurns = 0;
+    int disagreements = CountDisagreements(laneTurns, blockedLaneTurns);
+    printf("differential check: %s over %d lane turns, %d blocked\n\n",
+           disagreements == 0 ? "lanes play as the engine" : "DISAGREEMENT", laneTurns, blockedLaneTurns);
+
+    // right, down, left, up brings an unblocked assembly back where it started
+    const Direction cycle[] = {RIGHT, DOWN, LEFT, UP};
+    BoardGeometry board = BoardGeometry{20, 16};
+    // a batch stays on one thread unless told otherwise, so the hardware's count is asked for
+    std::vector<int> threadCounts = {1};
+    int hardwareThreads = static_cast<int>(std::thread::hardware_concurrency());
+    if (hardwareThreads > 1)
+        threadCounts.push_back(hardwareThreads);
+
+    printf("%-8s %8s %8s %16s %18s\n", "20x16", "boards", "threads", "move ns/board", "rotate ns/board");
+
+    std::vector<EntityManager> engines;
+    randomState = 12345;
+    for (int k = 0; k < 1024; k++) {
+        engines.emplace_back(board);
+        Populate(engines.back(), board, 20);
+    }
+
+    double move = NanosecondsPerBoard(engines.size(), [&](int n) {
+        for (EntityManager& em : engines) {
+            em.MoveAllToAdjacent(cycle[n % 4]);
+        }
+    });
+    double rotate = NanosecondsPerBoard(engines.size(), [&](int n) {
+        for (EntityManager& em : engines) {
+            em.RotateAll(n % 2 ? RIGHT : LEFT);
+        }
+    });
+    printf("%-8s %8zu %8d %16.0f %18.0f\n", "engines", engines.size(), 1, move, rotate);
+
+    for (int laneCount : {256, 4096, 16384}) {
+        for (int threads : threadCounts) {
+            BoardBatch batch(board, laneCount);
+            batch.workerCount = threads;
+            batch.parallelMinimumLanes = 1;
+            for (int lane = 0; lane < laneCount; lane++) {
+                batch.Load(lane, engines[lane % engines.size()]);
+            }
+
+            move = NanosecondsPerBoard(laneCount, [&](int n) { batch.MoveAllToAdjacent(cycle[n % 4]); });
+            rotate = NanosecondsPerBoard(laneCount, [&](int n) { batch.RotateAll(n % 2 ? RIGHT : LEFT); });
+            printf("%-8s %8d %8d %16.0f %18.0f\n", "batch", laneCount, threads, move, rotate);
+        }
+    }
+
+    return disagreements == 0 ? 0 : 1;
+}
@@ -0,0 +1,203 @@
+// Checks the incrementally kept source to sink and loop status against a full walk of
+// the link graph after every turn, then compares the cost of the two.
+//
+// Build and run natively:
+//     make bench
+//     ./build/bench/FlowBenchmark
+//
+// or with the Emscripten toolchain:
+//     emcc -O2 ./benchmarks/FlowBenchmark.cpp ./source/EntityManager.cpp ./source/TrajectoryCache.cpp ./source/Bitboard.cpp ./source/BitboardTranslator.cpp -I./source -s USE_SDL=2 -s ALLOW_MEMORY_GROWTH=1 -o flow_benchmark.js
+//     node flow_benchmark.js
+
+#include "EntityManager.h"
+
+#include <chrono>
+#include <cstdio>
+#include <stdint.h>
+
+static uint64_t randomState = 88172645463325252ull;
+
+static unsigned int Random()
+{
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 7;
+    randomState ^= randomState << 17;
+    return static_cast<unsigned int>(randomState);
+}
+
+static void Populate(EntityManager& em, BoardGeometry board, int density)
+{
+    em.LoadBoard(board);
+    em.AddEntity(EntityType::BENT_PIPE, pos{board.columns / 2, board.rows / 2}, true, UP);
+
+    int count = board.TileCount() * density / 100;
+    for (int i = 0; i < count; i++) {
+        pos position = pos{static_cast<int>(Random() % board.columns), static_cast<int>(Random() % board.rows)};
+        unsigned int roll = Random() % 20;
+        EntityType type = roll == 0 ? EntityType::SOURCE : roll == 1 ? EntityType::SINK :
+                          roll == 2 ? EntityType::TEE_PIPE : roll == 3 ? EntityType::CROSS_PIPE :
+                          roll % 2 ? EntityType::BENT_PIPE : EntityType::STRAIGHT_PIPE;
+        em.AddEntity(type, position, Random() % 10 == 0, static_cast<Direction>(Random() % 4));
+    }
+}
+
+static void Turn(EntityManager& em, unsigned int move)
+{
+    if (move < 4)
+        em.MoveAllToAdjacent(static_cast<Direction>(move));
+    else
+        em.RotateAll(move == 4 ? LEFT : RIGHT);
+}
+
+// the walk over every component the evaluator saves
+static FlowStatus FullWalk(EntityManager& em, std::vector<char>& isVisited, std::vector<int>& queue)
+{
+    FlowStatus status = FlowStatus{0, 0};
+    int tileCount = em.board.TileCount();
+    isVisited.assign(tileCount, false);
+
+    for (int start = 0; start < tileCount; start++) {
+        if (isVisited[start] || !em.doesEntityExist(em.tileToEntityMapping[start]))
+            continue;
+
+        FlowComponent component = FlowComponent{0, 0, 0, 0, true, false};
+        isVisited[start] = true;
+        queue.assign(1, start);
+
+        while (!queue.empty()) {
+            int current = queue.back();
+            queue.pop_back();
+
+            int index = em.tileToEntityMapping[current];
+            component.pieces++;
+            component.linkEnds += __builtin_popcount(em.tileLinks[current]);
+            component.sources += em.types[index] == EntityType::SOURCE;
+            component.sinks += em.types[index] == EntityType::SINK;
+
+            pos position = em.getPositionFromTileIndex(current);
+            for (int d = 0; d < 4; d++) {
+                if (!(em.tileLinks[current] & (1 << d)))
+                    continue;
+
+                int next = em.getTileIndexFromPosition(em.GetAdjacentPosition(position, static_cast<Direction>(d)));
+                if (!isVisited[next]) {
+                    isVisited[next] = true;
+                    queue.push_back(next);
+                }
+            }
+        }
+
+        status.connectedPaths += component.IsConnectedPath();
+        status.closedLoops += component.IsClosedLoop();
+    }
+
+    return status;
+}
+
+static int CountDisagreements(int& turns, int& pathTurns, int& loopTurns)
+{
+    const BoardGeometry boards[] = {{20, 16}, {7, 5}, {64, 12}, {40, 40}};
+    std::vector<char> isVisited;
+    std::vector<int> queue;
+    int disagreements = 0;
+
+    for (BoardGeometry board : boards) {
+        for (int game = 0; game < 100; game++) {
+            EntityManager em(board);
+            Populate(em, board, 20 + Random() % 60);
+
+            for (int turn = 0; turn < 60; turn++) {
+                Turn(em, Random() % 6);
+
+                // edits between turns are folded in lazily
+                if (Random() % 8 == 0) {
+                    pos position = pos{static_cast<int>(Random() % board.columns), static_cast<int>(Random() % board.rows)};
+                    if (em.doesEntityExistAtPosition(position))
+                        em.DeleteEntity(position);
+                    else
+                        em.AddEntity(Random() % 2 ? EntityType::SOURCE : EntityType::SINK, position, false, static_cast<Direction>(Random() % 4));
+                }
+
+                FlowStatus expected = FullWalk(em, isVisited, queue);
+                const FlowStatus& status = em.EvaluateFlow();
+                turns++;
+                pathTurns += expected.connectedPaths > 0;
+                loopTurns += expected.closedLoops > 0;
+
+                if (status.connectedPaths != expected.connectedPaths || status.closedLoops != expected.closedLoops) {
+                    printf("disagreement on %dx%d, game %d, turn %d: %d/%d paths, %d/%d loops\n", board.columns, board.rows,
+                           game, turn, status.connectedPaths, expected.connectedPaths, status.closedLoops, expected.closedLoops);
+                    disagreements++;
+                    break;
+                }
+            }
+        }
+    }
+
+    return disagreements;
+}
+
+struct FlowCost {
+    double turn;
+    double query;
+    double fullWalk;
+};
+
+static FlowCost MeasureFlow(BoardGeometry board, int turns)
+{
+    EntityManager em(board);
+    randomState = 12345;
+    Populate(em, board, 40);
+    em.EvaluateFlow();
+
+    std::vector<char> isVisited;
+    std::vector<int> queue;
+    static const unsigned int moveCycle[] = {RIGHT, DOWN, LEFT, UP};
+    double turnTime = 0;
+    double queryTime = 0;
+    double walkTime = 0;
+    int found = 0;
+
+    for (int i = 0; i < turns; i++) {
+        auto start = std::chrono::steady_clock::now();
+        Turn(em, moveCycle[i % 4]);
+        auto turned = std::chrono::steady_clock::now();
+        found += em.EvaluateFlow().connectedPaths;
+        auto queried = std::chrono::steady_clock::now();
+        found += FullWalk(em, isVisited, queue).connectedPaths;
+        auto walked = std::chrono::steady_clock::now();
+
+        turnTime += std::chrono::duration<double, std::nano>(turned - start).count();
+        queryTime += std::chrono::duration<double, std::nano>(queried - turned).count();
+        walkTime += std::chrono::duration<double, std::nano>(walked - queried).count();
+    }
+
+    if (found < 0)
+        printf("%d\n", found);
+
+    return FlowCost{turnTime / turns, queryTime / turns, walkTime / turns};
+}
+
+int main()
+{
+    int turns = 0;
+    int pathTurns = 0;
+    int loopTurns = 0;
+    int disagreements = CountDisagreements(turns, pathTurns, loopTurns);
+    printf("differential check: %s over %d turns, %d with a connected path, %d with a closed loop\n\n",
+           disagreements == 0 ? "incremental status matches full walk" : "DISAGREEMENT", turns, pathTurns, loopTurns);
+
+    const BoardGeometry boards[] = {{20, 16}, {64, 64}, {256, 256}, {1024, 1024}};
+
+    printf("%-12s %16s %16s %16s\n", "board", "turn ns", "query ns", "full walk ns");
+
+    for (BoardGeometry board : boards) {
+        FlowCost cost = MeasureFlow(board, board.columns >= 1024 ? 40 : 400);
+
+        char name[32];
+        snprintf(name, sizeof(name), "%dx%d", board.columns, board.rows);
+        printf("%-12s %16.1f %16.1f %16.1f\n", name, cost.turn, cost.query, cost.fullWalk);
+    }
+
+    return disagreements == 0 ? 0 : 1;
+}
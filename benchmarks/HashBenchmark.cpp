@@ -0,0 +1,200 @@
+// Checks that the incrementally kept board hash matches a full recompute through turns,
+// blocked turns, attaching pieces and regions paged in and out, and that equal boards hash
+// equal whatever their tile layout and piece order. Then compares its cost to a recompute.
+//
+// Build and run natively:
+//     make bench
+//     ./build/bench/HashBenchmark
+//
+// or with the Emscripten toolchain, add -DPIPE_VERIFY_HASH to also have every
+// turn check itself:
+//     emcc -O2 ./benchmarks/HashBenchmark.cpp ./source/EntityManager.cpp ./source/TrajectoryCache.cpp ./source/Bitboard.cpp ./source/BitboardTranslator.cpp -I./source -s USE_SDL=2 -s ALLOW_MEMORY_GROWTH=1 -o hash_benchmark.js
+//     node hash_benchmark.js
+
+#include "EntityManager.h"
+
+#include <chrono>
+#include <cstdio>
+#include <stdint.h>
+#include <vector>
+
+static uint64_t randomState = 88172645463325252ull;
+
+static unsigned int Random()
+{
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 7;
+    randomState ^= randomState << 17;
+    return static_cast<unsigned int>(randomState);
+}
+
+static PackedTile RandomTile(int density, int movableChance)
+{
+    if (Random() % 100 >= density)
+        return PackTile(EntityType::BACKGROUND, UP, false);
+
+    unsigned int roll = Random() % 20;
+    EntityType type = roll == 0 ? EntityType::SOURCE : roll == 1 ? EntityType::SINK :
+                      roll == 2 ? EntityType::TEE_PIPE : roll == 3 ? EntityType::CROSS_PIPE :
+                      roll == 4 ? EntityType::BOX :
+                      roll % 2 ? EntityType::BENT_PIPE : EntityType::STRAIGHT_PIPE;
+    return PackTile(type, static_cast<Direction>(Random() % 4), Random() % 100 < movableChance);
+}
+
+// a second assembly on some boards, so turns also roll back one assembly of several
+static void Populate(EntityManager& em, BoardGeometry board)
+{
+    em.LoadBoard(board);
+    em.AddEntity(EntityType::BENT_PIPE, pos{board.columns / 2, board.rows / 2}, true, UP);
+    if (Random() % 2)
+        em.AddEntity(EntityType::CROSS_PIPE, pos{board.columns / 4, board.rows / 4}, true, UP, em.AddAssembly());
+
+    std::vector<PackedTile> tiles(board.columns * board.rows);
+    int density = 10 + Random() % 50;
+    for (PackedTile& tile : tiles) {
+        tile = RandomTile(density, 5);
+    }
+    em.InsertRegion(BoardRegion{pos{0, 0}, board.columns, board.rows}, tiles.data());
+}
+
+static int CountMismatches(int& steps, int& blockedTurns, int& attachingTurns)
+{
+    const BoardGeometry boards[] = {{20, 16}, {7, 5}, {64, 12}, {40, 40, TileLayout::TILED}};
+    std::vector<PackedTile> tiles;
+    int mismatches = 0;
+
+    for (BoardGeometry board : boards) {
+        for (int game = 0; game < 100; game++) {
+            EntityManager em(board);
+            Populate(em, board);
+            em.translationBackend = game % 2 ? TranslationBackend::BITBOARD : TranslationBackend::PUSH_CHAINS;
+
+            for (int step = 0; step < 60; step++) {
+                unsigned int operation = Random() % 10;
+                uint64_t before = em.hash;
+                int movableBefore = em.isMovable.Count(em.numEntities);
+                steps++;
+
+                if (operation < 7) {
+                    bool isRotation = operation >= 4;
+                    em.RunTurn(isRotation ? (Random() % 2 ? LEFT : RIGHT) : static_cast<Direction>(Random() % 4), isRotation);
+                    blockedTurns += !em.isTurnOk;
+                    attachingTurns += em.isMovable.Count(em.numEntities) != movableBefore;
+
+                    // a blocked turn of a lone assembly leaves the board as it was
+                    if (!em.isTurnOk && em.assemblies.size() == 1 && em.hash != before) {
+                        printf("blocked turn changed the hash on %dx%d, game %d, step %d\n", board.columns, board.rows, game, step);
+                        mismatches++;
+                        break;
+                    }
+                } else if (operation == 7) {
+                    pos position = pos{static_cast<int>(Random() % board.columns), static_cast<int>(Random() % board.rows)};
+                    if (em.doesEntityExistAtPosition(position))
+                        em.DeleteEntity(position);
+                    else
+                        em.AddEntity(EntityType::STRAIGHT_PIPE, position, Random() % 4 == 0, static_cast<Direction>(Random() % 4));
+                } else {
+                    BoardRegion region = BoardRegion{pos{static_cast<int>(Random() % board.columns) - 2,
+                                                         static_cast<int>(Random() % board.rows) - 2},
+                                                     1 + static_cast<int>(Random() % 8), 1 + static_cast<int>(Random() % 8)};
+                    tiles.resize(region.TileCount());
+                    if (operation == 8) {
+                        em.RemoveRegion(region, tiles.data());
+                    } else {
+                        for (PackedTile& tile : tiles) {
+                            tile = RandomTile(40, 10);
+                        }
+                        em.InsertRegion(region, tiles.data());
+                    }
+                }
+
+                if (em.hash != em.ComputeHash()) {
+                    printf("hash differs from the recompute on %dx%d, game %d, step %d\n", board.columns, board.rows, game, step);
+                    mismatches++;
+                    break;
+                }
+            }
+        }
+    }
+
+    return mismatches;
+}
+
+// the same pieces added in opposite orders on row major and tiled boards, then moved
+// away and back
+static bool IsHashStable()
+{
+    const int columns = 48;
+    const int rows = 40;
+    std::vector<PackedTile> tiles(columns * rows);
+    for (PackedTile& tile : tiles) {
+        tile = RandomTile(30, 0);
+    }
+
+    EntityManager rowMajor(BoardGeometry{columns, rows});
+    EntityManager tiled(BoardGeometry{columns, rows, TileLayout::TILED});
+    rowMajor.LoadBoard(BoardGeometry{columns, rows});
+    tiled.LoadBoard(BoardGeometry{columns, rows, TileLayout::TILED});
+
+    rowMajor.InsertRegion(BoardRegion{pos{0, 0}, columns, rows}, tiles.data());
+    for (int k = columns * rows - 1; k >= 0; k--) {
+        if (PackedType(tiles[k]) != EntityType::BACKGROUND)
+            tiled.AddEntity(PackedType(tiles[k]), pos{k % columns, k / columns}, false, PackedOrientation(tiles[k]));
+    }
+
+    if (rowMajor.hash != tiled.hash || rowMajor.hash == ZobristBoardKey(BoardGeometry{columns, rows}))
+        return false;
+
+    // a lone piece in a cleared corner
+    uint64_t start = rowMajor.hash;
+    rowMajor.RemoveRegion(BoardRegion{pos{0, 0}, 4, 4});
+    rowMajor.AddEntity(EntityType::BENT_PIPE, pos{1, 1}, true, LEFT);
+    uint64_t placed = rowMajor.hash;
+    rowMajor.MoveAllToAdjacent(RIGHT);
+    rowMajor.MoveAllToAdjacent(DOWN);
+    bool hasChanged = rowMajor.hash != placed;
+    rowMajor.MoveAllToAdjacent(UP);
+    rowMajor.MoveAllToAdjacent(LEFT);
+
+    return hasChanged && rowMajor.hash == placed && placed != start;
+}
+
+int main()
+{
+    int steps = 0;
+    int blockedTurns = 0;
+    int attachingTurns = 0;
+    int mismatches = CountMismatches(steps, blockedTurns, attachingTurns);
+    printf("differential check: %s over %d steps, %d blocked, %d attaching pieces\n",
+           mismatches == 0 ? "hash matches recompute" : "MISMATCH", steps, blockedTurns, attachingTurns);
+
+    bool isStable = IsHashStable();
+    printf("stability check: %s\n\n", isStable ? "equal boards hash equal" : "FAILED");
+
+    printf("%-12s %12s %18s %16s %14s\n", "board", "pieces", "hash", "recompute us", "move us");
+    for (BoardGeometry board : {BoardGeometry{128, 128}, BoardGeometry{512, 512}, BoardGeometry{2048, 2048}}) {
+        EntityManager em(board);
+        randomState = 12345;
+        Populate(em, board);
+
+        int rounds = 20;
+        uint64_t recomputedHash = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int round = 0; round < rounds; round++) {
+            recomputedHash = em.ComputeHash();
+        }
+        auto recomputed = std::chrono::steady_clock::now();
+        for (int round = 0; round < rounds; round++) {
+            em.MoveAllToAdjacent(static_cast<Direction>(round % 4));
+        }
+        auto end = std::chrono::steady_clock::now();
+
+        char name[32];
+        snprintf(name, sizeof(name), "%dx%d", board.columns, board.rows);
+        printf("%-12s %12u %18llx %16.1f %14.1f\n", name, em.numEntities, static_cast<unsigned long long>(recomputedHash),
+               std::chrono::duration<double, std::micro>(recomputed - start).count() / rounds,
+               std::chrono::duration<double, std::micro>(end - recomputed).count() / rounds);
+    }
+
+    return mismatches == 0 && isStable ? 0 : 1;
+}
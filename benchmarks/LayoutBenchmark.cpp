@@ -0,0 +1,107 @@
+// Compares rotation throughput on a 1024x1024 board between the row major
+// and the tiled tile layouts. "rotate" is a whole RotateAll, "apply" is only
+// the quarter turn and link refresh that follow a completed sweep.
+//
+// Build and run natively:
+//     make bench
+//     ./build/bench/LayoutBenchmark
+//
+// or with the Emscripten toolchain:
+//     emcc -O2 ./benchmarks/LayoutBenchmark.cpp ./source/EntityManager.cpp ./source/TrajectoryCache.cpp ./source/Bitboard.cpp ./source/BitboardTranslator.cpp -I./source -s USE_SDL=2 -s ALLOW_MEMORY_GROWTH=1 -o layout_benchmark.js
+//     node layout_benchmark.js
+
+#include "EntityManager.h"
+
+#include <chrono>
+#include <cstdio>
+
+struct AssemblyShape {
+    const char* name;
+    int radius;
+    int spacing;
+    int rotations;
+};
+
+struct RotationCost {
+    double rotate;
+    double apply;
+};
+
+// a square lattice of movable pieces centered on the pivot, it maps onto itself under
+// a quarter turn so every rotation completes. Spacings are kept off powers of two,
+// which would alias the lattice onto a few cache sets in either layout
+static pos BuildAssembly(EntityManager& em, BoardGeometry board, AssemblyShape assembly)
+{
+    em.LoadBoard(board);
+
+    pos pivot = pos{board.columns / 2, board.rows / 2};
+    em.AddEntity(EntityType::BENT_PIPE, pivot, true, UP);
+
+    for (int y = -assembly.radius; y <= assembly.radius; y += assembly.spacing) {
+        for (int x = -assembly.radius; x <= assembly.radius; x += assembly.spacing) {
+            if (x == 0 && y == 0)
+                continue;
+
+            EntityType type = (x + y) % 2 == 0 ? EntityType::STRAIGHT_PIPE : EntityType::BENT_PIPE;
+            em.AddEntity(type, pos{pivot.x + x, pivot.y + y}, true, UP);
+        }
+    }
+
+    return pivot;
+}
+
+static RotationCost MeasureRotations(EntityManager& em, pos pivot, int rotations)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < rotations; i++) {
+        em.RotateAll(i % 2 == 0 ? LEFT : RIGHT);
+    }
+
+    auto middle = std::chrono::steady_clock::now();
+
+    Assembly& assembly = em.assemblies.front();
+    for (int i = 0; i < rotations; i++) {
+        em.InitializeTurn(assembly);
+        em.RotateMovables(assembly, i % 2 == 0 ? LEFT : RIGHT, pivot);
+        em.FinalizeTurn(assembly);
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    return RotationCost{std::chrono::duration<double, std::micro>(middle - start).count() / rotations,
+                        std::chrono::duration<double, std::micro>(end - middle).count() / rotations};
+}
+
+int main()
+{
+    const AssemblyShape shapes[] = {
+        {"dense r=48", 48, 1, 20},
+        {"lattice r=192/5", 192, 5, 20},
+        {"lattice r=360/3", 360, 3, 4}
+    };
+    const TileLayout layouts[] = {TileLayout::ROW_MAJOR, TileLayout::TILED};
+
+    printf("%-16s %10s %14s %14s %14s %14s\n", "assembly", "entities", 
+           "rotate rows us", "rotate tiled", "apply rows us", "apply tiled");
+
+    for (AssemblyShape assembly : shapes) {
+        RotationCost cost[2];
+        unsigned int entities = 0;
+
+        for (int l = 0; l < 2; l++) {
+            BoardGeometry board = BoardGeometry{1024, 1024, layouts[l]};
+            EntityManager em(board);
+            pos pivot = BuildAssembly(em, board, assembly);
+
+            // the first rotations fill the trajectory cache
+            MeasureRotations(em, pivot, 2);
+            cost[l] = MeasureRotations(em, pivot, assembly.rotations);
+            entities = em.numEntities;
+        }
+
+        printf("%-16s %10u %14.1f %14.1f %14.1f %14.1f\n", assembly.name, entities, 
+               cost[0].rotate, cost[1].rotate, cost[0].apply, cost[1].apply);
+    }
+
+    return 0;
+}
@@ -0,0 +1,260 @@
+// Checks that evaluating a move predicts what playing it does, then measures evaluation
+// on one shared board from several threads against playing the move.
+//
+// Build and run natively:
+//     make bench
+//     ./build/bench/MoveEvaluationBenchmark
+//
+// or with the Emscripten toolchain, threads need -pthread:
+//     emcc -O2 -pthread -s PTHREAD_POOL_SIZE=4 ./benchmarks/MoveEvaluationBenchmark.cpp ./source/EntityManager.cpp ./source/TrajectoryCache.cpp ./source/Bitboard.cpp ./source/BitboardTranslator.cpp -I./source -s USE_SDL=2 -s ALLOW_MEMORY_GROWTH=1 -o move_evaluation_benchmark.js
+//     node move_evaluation_benchmark.js
+
+#include "EntityManager.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+static uint64_t randomState = 88172645463325252ull;
+
+static unsigned int Random()
+{
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 7;
+    randomState ^= randomState << 17;
+    return static_cast<unsigned int>(randomState);
+}
+
+// a blob of movable pieces around the pivot among scattered pieces of every type
+static void Populate(EntityManager& em, BoardGeometry board, int radius, int density)
+{
+    em.LoadBoard(board);
+    pos center = pos{board.columns / 2, board.rows / 2};
+    em.AddEntity(EntityType::BENT_PIPE, center, true, UP);
+
+    for (int y = -radius; y <= radius; y++) {
+        for (int x = -radius; x <= radius; x++) {
+            if (Random() % 100 < 40)
+                em.AddEntity(EntityType::STRAIGHT_PIPE, pos{center.x + x, center.y + y}, true, static_cast<Direction>(Random() % 4));
+        }
+    }
+
+    int count = board.TileCount() * density / 100;
+    for (int i = 0; i < count; i++) {
+        pos position = pos{static_cast<int>(Random() % board.columns), static_cast<int>(Random() % board.rows)};
+        unsigned int roll = Random() % 20;
+        EntityType type = roll == 0 ? EntityType::SOURCE : roll == 1 ? EntityType::SINK :
+                          roll == 2 ? EntityType::TEE_PIPE : roll == 3 ? EntityType::CROSS_PIPE :
+                          roll == 4 ? EntityType::BOX :
+                          roll % 2 ? EntityType::BENT_PIPE : EntityType::STRAIGHT_PIPE;
+        em.AddEntity(type, position, false, static_cast<Direction>(Random() % 4));
+    }
+}
+
+static MoveQuery Move(unsigned int move)
+{
+    if (move < 4)
+        return MoveQuery{static_cast<Direction>(move), false};
+    return MoveQuery{move == 4 ? LEFT : RIGHT, true};
+}
+
+static void Play(EntityManager& em, const MoveQuery& query)
+{
+    if (query.isRotation)
+        em.RotateAll(query.direction);
+    else
+        em.MoveAllToAdjacent(query.direction);
+}
+
+// plays the move and reports where the board differs from the evaluation
+static bool PlayMatchesEvaluation(EntityManager& em, const MoveQuery& query, const MoveResult& result)
+{
+    std::vector<pos> positions(em.positions.begin(), em.positions.begin() + em.numEntities);
+    std::vector<Direction> orientations(em.orientations.begin(), em.orientations.begin() + em.numEntities);
+    std::vector<char> isMovable(em.numEntities);
+    for (int i = 0; i < em.numEntities; i++) {
+        isMovable[i] = em.isMovable.Test(i);
+    }
+
+    for (const EntityPlacement& placement : result.placements) {
+        positions[placement.entityIndex] = placement.position;
+        orientations[placement.entityIndex] = placement.orientation;
+    }
+    for (int index : result.connectedEntities) {
+        if (isMovable[index])
+            return false;
+        isMovable[index] = true;
+    }
+
+    Play(em, query);
+
+    if (em.isTurnOk != result.isOk)
+        return false;
+
+    if (query.isRotation && !em.assemblies[0].collision.canComplete &&
+        em.assemblies[0].collision.maximumAngle != result.collisionAngle)
+        return false;
+
+    for (int i = 0; i < em.numEntities; i++) {
+        if (em.positions[i].x != positions[i].x || em.positions[i].y != positions[i].y ||
+            em.orientations[i] != orientations[i] || em.isMovable.Test(i) != static_cast<bool>(isMovable[i]))
+            return false;
+    }
+
+    return true;
+}
+
+static int CountDisagreements(int& turns, int& blockedTurns, int& connectingTurns)
+{
+    const BoardGeometry boards[] = {{20, 16}, {7, 5}, {64, 12}, {40, 40}};
+    MoveScratch scratch;
+    int disagreements = 0;
+
+    for (BoardGeometry board : boards) {
+        for (int game = 0; game < 100; game++) {
+            EntityManager em(board);
+            Populate(em, board, 1 + Random() % 3, 10 + Random() % 50);
+            em.translationBackend = game % 2 ? TranslationBackend::BITBOARD : TranslationBackend::PUSH_CHAINS;
+
+            for (int turn = 0; turn < 60; turn++) {
+                MoveQuery query = Move(Random() % 6);
+                const EntityManager& view = em;
+                const MoveResult& result = view.EvaluateMove(query, scratch);
+                turns++;
+                blockedTurns += !result.isOk;
+                connectingTurns += !result.connectedEntities.empty();
+
+                if (!PlayMatchesEvaluation(em, query, result)) {
+                    printf("disagreement on %dx%d, game %d, turn %d\n", board.columns, board.rows, game, turn);
+                    disagreements++;
+                    break;
+                }
+
+                if (Random() % 8 == 0) {
+                    pos position = pos{static_cast<int>(Random() % board.columns), static_cast<int>(Random() % board.rows)};
+                    if (em.doesEntityExistAtPosition(position))
+                        em.DeleteEntity(position);
+                    else
+                        em.AddEntity(EntityType::BENT_PIPE, position, false, static_cast<Direction>(Random() % 4));
+                }
+            }
+        }
+    }
+
+    return disagreements;
+}
+
+static bool IsSameResult(const MoveResult& a, const MoveResult& b)
+{
+    if (a.isOk != b.isOk || a.collisionAngle != b.collisionAngle ||
+        a.placements.size() != b.placements.size() || a.connectedEntities != b.connectedEntities)
+        return false;
+
+    for (size_t k = 0; k < a.placements.size(); k++) {
+        const EntityPlacement& p = a.placements[k];
+        const EntityPlacement& q = b.placements[k];
+        if (p.entityIndex != q.entityIndex || p.position.x != q.position.x || p.position.y != q.position.y ||
+            p.orientation != q.orientation)
+            return false;
+    }
+    return true;
+}
+
+// evaluates every move rounds times spread over threadCount threads, each with its own
+// scratch, and checks every answer against the serial one
+static double MeasureEvaluation(const EntityManager& em, const std::vector<MoveResult>& expected,
+                                int threadCount, int rounds, int& mismatches)
+{
+    std::atomic<int> next(0);
+    std::atomic<int> wrong(0);
+    int total = rounds * 6;
+
+    auto work = [&]() {
+        MoveScratch scratch;
+        for (int n = next++; n < total; n = next++) {
+            const MoveResult& result = em.EvaluateMove(Move(n % 6), scratch);
+            if (!IsSameResult(result, expected[n % 6]))
+                wrong++;
+        }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+#ifdef PARALLEL_ASSEMBLIES
+    std::vector<std::thread> workers;
+    for (int t = 1; t < threadCount; t++) {
+        workers.emplace_back(work);
+    }
+    work();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+#else
+    work();
+#endif
+    auto end = std::chrono::steady_clock::now();
+
+    mismatches += wrong;
+    return std::chrono::duration<double, std::micro>(end - start).count() / total;
+}
+
+static double MeasurePlay(const EntityManager& em, int rounds)
+{
+    double time = 0;
+    for (int n = 0; n < rounds * 6; n++) {
+        EntityManager copy = em;
+        auto start = std::chrono::steady_clock::now();
+        Play(copy, Move(n % 6));
+        auto end = std::chrono::steady_clock::now();
+        time += std::chrono::duration<double, std::micro>(end - start).count();
+    }
+    return time / (rounds * 6);
+}
+
+int main()
+{
+    int turns = 0;
+    int blockedTurns = 0;
+    int connectingTurns = 0;
+    int disagreements = CountDisagreements(turns, blockedTurns, connectingTurns);
+    printf("differential check: %s over %d turns, %d blocked, %d connecting pieces\n\n",
+           disagreements == 0 ? "evaluation matches play" : "DISAGREEMENT", turns, blockedTurns, connectingTurns);
+
+    BoardGeometry board = BoardGeometry{256, 256};
+    EntityManager em(board);
+    randomState = 12345;
+    Populate(em, board, 12, 20);
+    em.PrebuildTrajectoryCache(BoardGeometry{25, 25});
+
+    MoveScratch scratch;
+    std::vector<MoveResult> expected;
+    for (unsigned int move = 0; move < 6; move++) {
+        expected.push_back(em.EvaluateMove(Move(move), scratch));
+    }
+
+    // a query for an assembly the board does not have is a blocked move
+    for (int assemblyIndex : {-1, static_cast<int>(em.assemblies.size())}) {
+        MoveQuery query = Move(0);
+        query.assemblyIndex = assemblyIndex;
+        if (em.EvaluateMove(query, scratch).isOk) {
+            printf("assembly %d evaluates as a move that goes through\n", assemblyIndex);
+            disagreements++;
+        }
+    }
+
+    int mismatches = 0;
+    printf("%dx%d, assembly of radius 12, every move evaluated 2000 times\n", board.columns, board.rows);
+    printf("%-8s %16s\n", "threads", "us/evaluation");
+    for (int threadCount : {1, 2, 4}) {
+        double cost = MeasureEvaluation(em, expected, threadCount, 2000, mismatches);
+        printf("%-8d %16.2f\n", threadCount, cost);
+    }
+    printf("playing the move on a copy: %.2f us, without the copy\n", MeasurePlay(em, 50));
+
+    if (mismatches > 0)
+        printf("%d threaded evaluations differ from the serial ones\n", mismatches);
+
+    return disagreements == 0 && mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,219 @@
+// Checks that inserting and removing whole regions leaves the same board as adding and
+// deleting their pieces one by one, then compares the cost of paging a region in and out.
+//
+// Build and run natively:
+//     make bench
+//     ./build/bench/RegionBenchmark
+//
+// or with the Emscripten toolchain:
+//     emcc -O2 ./benchmarks/RegionBenchmark.cpp ./source/EntityManager.cpp ./source/TrajectoryCache.cpp ./source/Bitboard.cpp ./source/BitboardTranslator.cpp -I./source -s USE_SDL=2 -s ALLOW_MEMORY_GROWTH=1 -o region_benchmark.js
+//     node region_benchmark.js
+
+#include "EntityManager.h"
+
+#include <chrono>
+#include <cstdio>
+#include <stdint.h>
+#include <vector>
+
+static uint64_t randomState = 88172645463325252ull;
+
+static unsigned int Random()
+{
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 7;
+    randomState ^= randomState << 17;
+    return static_cast<unsigned int>(randomState);
+}
+
+static PackedTile RandomTile(int density)
+{
+    if (Random() % 100 >= density)
+        return PackTile(EntityType::BACKGROUND, UP, false);
+
+    unsigned int roll = Random() % 20;
+    EntityType type = roll == 0 ? EntityType::SOURCE : roll == 1 ? EntityType::SINK :
+                      roll == 2 ? EntityType::TEE_PIPE : roll == 3 ? EntityType::CROSS_PIPE :
+                      roll % 2 ? EntityType::BENT_PIPE : EntityType::STRAIGHT_PIPE;
+    return PackTile(type, static_cast<Direction>(Random() % 4), Random() % 10 == 0);
+}
+
+static void InsertOneByOne(EntityManager& em, BoardRegion region, const PackedTile* tiles)
+{
+    for (int y = 0; y < region.rows; y++) {
+        for (int x = 0; x < region.columns; x++) {
+            PackedTile tile = tiles[x + y * region.columns];
+            if (PackedType(tile) != EntityType::BACKGROUND)
+                em.AddEntity(PackedType(tile), pos{region.low.x + x, region.low.y + y}, IsPackedMovable(tile), PackedOrientation(tile));
+        }
+    }
+}
+
+static void RemoveOneByOne(EntityManager& em, BoardRegion region, PackedTile* tiles)
+{
+    for (int y = 0; y < region.rows; y++) {
+        for (int x = 0; x < region.columns; x++) {
+            pos position = pos{region.low.x + x, region.low.y + y};
+            PackedTile tile = PackTile(EntityType::BACKGROUND, UP, false);
+            if (em.doesEntityExistAtPosition(position)) {
+                int index = em.getEntityIndexFromPosition(position);
+                tile = PackTile(em.types[index], em.orientations[index], em.isMovable.Test(index));
+                em.DeleteEntity(position);
+            }
+            tiles[x + y * region.columns] = tile;
+        }
+    }
+}
+
+// entity indices differ between the two boards, so they are compared tile by tile
+static bool IsSameBoard(EntityManager& a, EntityManager& b)
+{
+    if (a.numEntities != b.numEntities)
+        return false;
+
+    for (int i = 0; i < a.numEntities; i++) {
+        if (a.slotToEntityIndex[a.ids[i].slot] != i || a.tileToEntityMapping[a.getTileIndexFromEntityIndex(i)] != i)
+            return false;
+    }
+
+    for (int tileIndex = 0; tileIndex < a.board.TileCount(); tileIndex++) {
+        int p = a.tileToEntityMapping[tileIndex];
+        int q = b.tileToEntityMapping[tileIndex];
+        if ((p >= 0) != (q >= 0) || a.tileLinks[tileIndex] != b.tileLinks[tileIndex])
+            return false;
+
+        if (p >= 0 && (a.types[p] != b.types[q] || a.orientations[p] != b.orientations[q] ||
+                       a.isMovable.Test(p) != b.isMovable.Test(q) ||
+                       a.assemblies[0].members.Test(p) != b.assemblies[0].members.Test(q)))
+            return false;
+    }
+
+    const FlowStatus& statusA = a.EvaluateFlow();
+    const FlowStatus& statusB = b.EvaluateFlow();
+    return statusA.connectedPaths == statusB.connectedPaths && statusA.closedLoops == statusB.closedLoops;
+}
+
+static int CountDisagreements(int& operations)
+{
+    const BoardGeometry boards[] = {{20, 16}, {7, 5}, {64, 12}, {40, 40, TileLayout::TILED}};
+    std::vector<PackedTile> tiles;
+    std::vector<PackedTile> packedA;
+    std::vector<PackedTile> packedB;
+    int disagreements = 0;
+
+    for (BoardGeometry board : boards) {
+        for (int game = 0; game < 50; game++) {
+            EntityManager a(board);
+            EntityManager b(board);
+            a.LoadBoard(board);
+            b.LoadBoard(board);
+
+            for (int step = 0; step < 60; step++) {
+                BoardRegion region = BoardRegion{pos{static_cast<int>(Random() % (board.columns + 4)) - 2,
+                                                     static_cast<int>(Random() % (board.rows + 4)) - 2},
+                                                 1 + static_cast<int>(Random() % 12), 1 + static_cast<int>(Random() % 12)};
+                unsigned int operation = Random() % 4;
+                operations++;
+
+                if (operation < 2) {
+                    tiles.resize(region.TileCount());
+                    int density = Random() % 100;
+                    for (PackedTile& tile : tiles) {
+                        tile = RandomTile(density);
+                    }
+                    a.InsertRegion(region, tiles.data());
+                    InsertOneByOne(b, region, tiles.data());
+                } else if (operation == 2) {
+                    packedA.resize(region.TileCount());
+                    packedB.resize(region.TileCount());
+                    a.RemoveRegion(region, packedA.data());
+                    RemoveOneByOne(b, region, packedB.data());
+                    if (packedA != packedB) {
+                        printf("packed tiles differ on %dx%d, game %d, step %d\n", board.columns, board.rows, game, step);
+                        disagreements++;
+                        break;
+                    }
+                } else {
+                    Direction direction = static_cast<Direction>(Random() % 4);
+                    a.MoveAllToAdjacent(direction);
+                    b.MoveAllToAdjacent(direction);
+                }
+
+                if (!IsSameBoard(a, b)) {
+                    printf("disagreement on %dx%d, game %d, step %d\n", board.columns, board.rows, game, step);
+                    disagreements++;
+                    break;
+                }
+            }
+        }
+    }
+
+    return disagreements;
+}
+
+struct PagingCost {
+    double bulk;
+    double oneByOne;
+};
+
+// pages a side x side region out and back in across a populated board
+static PagingCost MeasurePaging(BoardGeometry board, int side, int rounds)
+{
+    EntityManager bulk(board);
+    EntityManager oneByOne(board);
+    bulk.LoadBoard(board);
+    oneByOne.LoadBoard(board);
+
+    std::vector<PackedTile> tiles(board.TileCount());
+    for (PackedTile& tile : tiles) {
+        tile = RandomTile(40);
+    }
+    BoardRegion whole = BoardRegion{pos{0, 0}, board.columns, board.rows};
+    bulk.InsertRegion(whole, tiles.data());
+    oneByOne.InsertRegion(whole, tiles.data());
+
+    std::vector<PackedTile> page(side * side);
+    double bulkTime = 0;
+    double oneByOneTime = 0;
+
+    for (int round = 0; round < rounds; round++) {
+        BoardRegion region = BoardRegion{pos{static_cast<int>(Random() % (board.columns - side)),
+                                             static_cast<int>(Random() % (board.rows - side))}, side, side};
+
+        auto start = std::chrono::steady_clock::now();
+        bulk.RemoveRegion(region, page.data());
+        bulk.InsertRegion(region, page.data());
+        auto paged = std::chrono::steady_clock::now();
+        RemoveOneByOne(oneByOne, region, page.data());
+        InsertOneByOne(oneByOne, region, page.data());
+        auto end = std::chrono::steady_clock::now();
+
+        bulkTime += std::chrono::duration<double, std::micro>(paged - start).count();
+        oneByOneTime += std::chrono::duration<double, std::micro>(end - paged).count();
+    }
+
+    return PagingCost{bulkTime / rounds, oneByOneTime / rounds};
+}
+
+int main()
+{
+    int operations = 0;
+    int disagreements = CountDisagreements(operations);
+    printf("differential check: %s over %d operations\n\n",
+           disagreements == 0 ? "regions match one by one" : "DISAGREEMENT", operations);
+
+    printf("%-12s %-8s %16s %16s\n", "board", "region", "bulk us", "one by one us");
+
+    const int sides[] = {16, 64};
+    for (BoardGeometry board : {BoardGeometry{256, 256}, BoardGeometry{1024, 1024}}) {
+        for (int side : sides) {
+            PagingCost cost = MeasurePaging(board, side, 40);
+
+            char name[32];
+            snprintf(name, sizeof(name), "%dx%d", board.columns, board.rows);
+            printf("%-12s %-8d %16.1f %16.1f\n", name, side, cost.bulk, cost.oneByOne);
+        }
+    }
+
+    return disagreements == 0 ? 0 : 1;
+}
@@ -0,0 +1,167 @@
+// Checks that a board restored from a snapshot plays on exactly as the board it was taken
+// from, and that a snapshot hashes as the engine does, then compares the cost of keeping
+// a board as a snapshot against copying the engine.
+//
+// Build and run natively:
+//     make bench
+//     ./build/bench/SnapshotBenchmark
+//
+// or with the Emscripten toolchain:
+//     emcc -O2 ./benchmarks/SnapshotBenchmark.cpp ./source/EntityManager.cpp ./source/TrajectoryCache.cpp ./source/Bitboard.cpp ./source/BitboardTranslator.cpp -I./source -s USE_SDL=2 -s ALLOW_MEMORY_GROWTH=1 -o snapshot_benchmark.js
+//     node snapshot_benchmark.js
+
+#include "EntityManager.h"
+#include "BoardSnapshot.h"
+
+#include <chrono>
+#include <cstdio>
+#include <stdint.h>
+#include <vector>
+
+static uint64_t randomState = 88172645463325252ull;
+
+static unsigned int Random()
+{
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 7;
+    randomState ^= randomState << 17;
+    return static_cast<unsigned int>(randomState);
+}
+
+static void Populate(EntityManager& em, BoardGeometry board, int density)
+{
+    em.LoadBoard(board);
+    pos center = pos{board.columns / 2, board.rows / 2};
+    em.AddEntity(EntityType::BENT_PIPE, center, true, UP);
+
+    for (int y = -1; y <= 1; y++) {
+        for (int x = -1; x <= 1; x++) {
+            if (Random() % 100 < 40)
+                em.AddEntity(EntityType::STRAIGHT_PIPE, pos{center.x + x, center.y + y}, true, static_cast<Direction>(Random() % 4));
+        }
+    }
+
+    int count = board.columns * board.rows * density / 100;
+    for (int i = 0; i < count; i++) {
+        pos position = pos{static_cast<int>(Random() % board.columns), static_cast<int>(Random() % board.rows)};
+        unsigned int roll = Random() % 20;
+        EntityType type = roll == 0 ? EntityType::SOURCE : roll == 1 ? EntityType::SINK :
+                          roll == 2 ? EntityType::TEE_PIPE : roll == 3 ? EntityType::CROSS_PIPE :
+                          roll == 4 ? EntityType::BOX : roll == 5 ? EntityType::PLAYER :
+                          roll % 2 ? EntityType::BENT_PIPE : EntityType::STRAIGHT_PIPE;
+        em.AddEntity(type, position, Random() % 30 == 0, static_cast<Direction>(Random() % 4));
+    }
+}
+
+static void PlayRandomMove(EntityManager& a, EntityManager& b)
+{
+    unsigned int move = Random() % 6;
+    Direction direction = move < 4 ? static_cast<Direction>(move) : move == 4 ? LEFT : RIGHT;
+    a.RunTurn(direction, move >= 4);
+    b.RunTurn(direction, move >= 4);
+}
+
+// the restored board is played alongside the original, both must stay the same board
+template<int Columns, int Rows>
+static int CountDisagreements(int& snapshots)
+{
+    typedef BoardSnapshot<Columns, Rows> Snapshot;
+    int disagreements = 0;
+
+    for (int game = 0; game < 100; game++) {
+        EntityManager em(Snapshot::Geometry());
+        Populate(em, Snapshot::Geometry(), 10 + Random() % 50);
+        // another size, so the first restore loads the board
+        EntityManager restored(BoardGeometry{12, 10});
+
+        for (int turn = 0; turn < 60; turn++) {
+            Snapshot snapshot;
+            snapshot.Capture(em);
+            snapshot.Restore(restored);
+            snapshots++;
+
+            Snapshot again;
+            again.Capture(restored);
+            if (again != snapshot || snapshot.Hash() != em.hash || restored.hash != em.hash) {
+                printf("round trip differs on %dx%d, game %d, turn %d\n", Columns, Rows, game, turn);
+                disagreements++;
+                break;
+            }
+
+            for (int k = 0; k < 4; k++) {
+                PlayRandomMove(em, restored);
+            }
+
+            const FlowStatus& flow = em.EvaluateFlow();
+            const FlowStatus& restoredFlow = restored.EvaluateFlow();
+            if (em.hash != restored.hash || flow.connectedPaths != restoredFlow.connectedPaths ||
+                flow.closedLoops != restoredFlow.closedLoops) {
+                printf("restored board plays differently on %dx%d, game %d, turn %d\n", Columns, Rows, game, turn);
+                disagreements++;
+                break;
+            }
+        }
+    }
+
+    return disagreements;
+}
+
+template<typename Operation>
+static double Nanoseconds(int rounds, Operation operation)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; round++) {
+        operation(round);
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / rounds;
+}
+
+template<int Columns, int Rows>
+static void Measure(int rounds)
+{
+    typedef BoardSnapshot<Columns, Rows> Snapshot;
+    EntityManager em(Snapshot::Geometry());
+    randomState = 12345;
+    Populate(em, Snapshot::Geometry(), 20);
+    EntityManager restored(Snapshot::Geometry());
+
+    Snapshot snapshot;
+    snapshot.Capture(em);
+    std::vector<Snapshot> snapshots(64, snapshot);
+    std::vector<EntityManager> copies(4, em);
+    uint64_t hashes = 0;
+
+    double capture = Nanoseconds(rounds, [&](int round) { snapshots[round % 64].Capture(em); });
+    double copy = Nanoseconds(rounds, [&](int round) { snapshots[(round + 1) % 64] = snapshots[round % 64]; });
+    double hash = Nanoseconds(rounds, [&](int round) { hashes += snapshots[round % 64].Hash(); });
+
+    // a search evaluates every board it restores, which also takes in the tiles marked for the flow
+    double restore = Nanoseconds(rounds, [&](int round) {
+        snapshots[round % 64].Restore(restored);
+        restored.EvaluateFlow();
+    });
+    double engineCopy = Nanoseconds(rounds / 10 + 1, [&](int round) { copies[round % 4] = em; });
+
+    char name[32];
+    snprintf(name, sizeof(name), "%dx%d", Columns, Rows);
+    printf("%-10s %8zu %18llx %12.0f %10.0f %10.0f %15.0f %16.0f\n", name, sizeof(Snapshot),
+           static_cast<unsigned long long>(hashes), capture, copy, hash, restore, engineCopy);
+}
+
+int main()
+{
+    int snapshots = 0;
+    int disagreements = CountDisagreements<TILES_COLUMNS, TILES_ROWS>(snapshots) +
+                        CountDisagreements<7, 5>(snapshots) +
+                        CountDisagreements<64, 12>(snapshots);
+    printf("differential check: %s over %d snapshots\n\n",
+           disagreements == 0 ? "restored boards play as the originals" : "DISAGREEMENT", snapshots);
+
+    printf("%-10s %8s %18s %12s %10s %10s %15s %16s\n", "board", "bytes", "hashes", "capture ns", "copy ns", "hash ns",
+           "restore+flow ns", "engine copy ns");
+    Measure<TILES_COLUMNS, TILES_ROWS>(20000);
+    Measure<64, 64>(2000);
+
+    return disagreements == 0 ? 0 : 1;
+}
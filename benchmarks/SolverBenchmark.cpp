@@ -0,0 +1,198 @@
+// Checks that UndoTurn restores the board a turn started from, which the solver relies on
+// to try every move from a state, and that the solver finds equally short solutions on
+// any number of threads and with its levels and visited states spilled to disk, and that
+// it stops at its state limit. Then measures the search on the game's starting board.
+//
+// Build and run natively, the solver needs threads:
+//     make bench
+//     ./build/bench/SolverBenchmark
+
+#include "EntityManager.h"
+#include "Solver.h"
+
+#include <cstdio>
+#include <stdint.h>
+#include <string>
+
+static uint64_t randomState = 88172645463325252ull;
+
+static unsigned int Random()
+{
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 7;
+    randomState ^= randomState << 17;
+    return static_cast<unsigned int>(randomState);
+}
+
+// a movable blob about the pivot among scattered pieces, a few sources and sinks
+static void Populate(EntityManager& em, BoardGeometry board, int density)
+{
+    em.LoadBoard(board);
+    pos center = pos{board.columns / 2, board.rows / 2};
+    em.AddEntity(EntityType::BENT_PIPE, center, true, UP);
+
+    for (int y = -1; y <= 1; y++) {
+        for (int x = -1; x <= 1; x++) {
+            if (Random() % 100 < 40)
+                em.AddEntity(EntityType::STRAIGHT_PIPE, pos{center.x + x, center.y + y}, true, static_cast<Direction>(Random() % 4));
+        }
+    }
+
+    int count = board.columns * board.rows * density / 100;
+    for (int i = 0; i < count; i++) {
+        pos position = pos{static_cast<int>(Random() % board.columns), static_cast<int>(Random() % board.rows)};
+        unsigned int roll = Random() % 20;
+        EntityType type = roll == 0 ? EntityType::SOURCE : roll == 1 ? EntityType::SINK :
+                          roll == 2 ? EntityType::TEE_PIPE : roll == 3 ? EntityType::BOX :
+                          roll % 2 ? EntityType::BENT_PIPE : EntityType::STRAIGHT_PIPE;
+        em.AddEntity(type, position, false, static_cast<Direction>(Random() % 4));
+    }
+}
+
+// turns keep entity indices, so the boards are compared index by index, along with the
+// rotations the renderer has yet to animate
+static bool IsSameBoard(EntityManager& a, EntityManager& b)
+{
+    if (a.numEntities != b.numEntities || a.hash != b.hash || a.tileToEntityMapping != b.tileToEntityMapping ||
+        a.tileLinks != b.tileLinks)
+        return false;
+
+    const RotationCounts& countsA = a.assemblies[0].rotationCounts;
+    const RotationCounts& countsB = b.assemblies[0].rotationCounts;
+    if (countsA.leftRotations != countsB.leftRotations || countsA.rightRotations != countsB.rightRotations)
+        return false;
+
+    for (int i = 0; i < a.numEntities; i++) {
+        if (a.positions[i].x != b.positions[i].x || a.positions[i].y != b.positions[i].y ||
+            a.orientations[i] != b.orientations[i] || a.ports[i] != b.ports[i] ||
+            a.isMovable.Test(i) != b.isMovable.Test(i) ||
+            a.assemblies[0].members.Test(i) != b.assemblies[0].members.Test(i))
+            return false;
+    }
+
+    const FlowStatus& statusA = a.EvaluateFlow();
+    const FlowStatus& statusB = b.EvaluateFlow();
+    return statusA.connectedPaths == statusB.connectedPaths && statusA.closedLoops == statusB.closedLoops;
+}
+
+static int CountUndoDisagreements(int& undoneTurns)
+{
+    const BoardGeometry boards[] = {{20, 16}, {7, 5}, {64, 12}, {40, 40, TileLayout::TILED}};
+    int disagreements = 0;
+
+    for (BoardGeometry board : boards) {
+        for (int game = 0; game < 100; game++) {
+            EntityManager em(board);
+            Populate(em, board, 10 + Random() % 50);
+            em.translationBackend = game % 2 ? TranslationBackend::BITBOARD : TranslationBackend::PUSH_CHAINS;
+
+            for (int turn = 0; turn < 60; turn++) {
+                unsigned int move = Random() % 6;
+                Direction direction = move < 4 ? static_cast<Direction>(move) : move == 4 ? LEFT : RIGHT;
+                EntityManager before = em;
+
+                em.RunTurn(direction, move >= 4);
+                if (!em.isTurnOk)
+                    continue;
+
+                // undo, then play the move again to go on from where it leads
+                EntityManager after = em;
+                em.UndoTurn();
+                undoneTurns++;
+                if (!IsSameBoard(em, before)) {
+                    printf("undo disagreement on %dx%d, game %d, turn %d\n", board.columns, board.rows, game, turn);
+                    disagreements++;
+                    break;
+                }
+
+                em.RunTurn(direction, move >= 4);
+                if (!IsSameBoard(em, after)) {
+                    printf("replay disagreement on %dx%d, game %d, turn %d\n", board.columns, board.rows, game, turn);
+                    disagreements++;
+                    break;
+                }
+            }
+        }
+    }
+
+    return disagreements;
+}
+
+// solves small boards on one and on four threads, the second time with levels and visited
+// states on disk, both must find verified solutions of the same length and visit no more
+// states than the limit and one per other thread
+static int CountSolverDisagreements(int& solvedBoards, int& boards)
+{
+    int disagreements = 0;
+    SolverOptions options;
+    options.maxDepth = 8;
+    options.maxStates = 5000;
+
+    for (int game = 0; game < 30; game++) {
+        EntityManager em(BoardGeometry{9, 7});
+        Populate(em, BoardGeometry{9, 7}, 30);
+        boards++;
+
+        options.threadCount = 1;
+        options.frontierMemory = size_t(64) << 20;
+        SolverResult serial = SolvePuzzle(em, options);
+
+        options.threadCount = 4;
+        options.frontierMemory = 1;
+        options.visitedMemory = 1;
+        SolverResult parallel = SolvePuzzle(em, options);
+        options.visitedMemory = SolverOptions().visitedMemory;
+
+        if (serial.isSolved != parallel.isSolved || serial.moves.size() != parallel.moves.size() ||
+            (serial.isSolved && (!serial.isVerified || !parallel.isVerified)) ||
+            serial.statesVisited > options.maxStates || parallel.statesVisited > options.maxStates + 3) {
+            printf("solver disagreement on game %d: %s against %s\n", game, serial.moves.c_str(), parallel.moves.c_str());
+            disagreements++;
+        }
+        solvedBoards += serial.isSolved;
+    }
+
+    return disagreements;
+}
+
+int main()
+{
+    int undoneTurns = 0;
+    int undoDisagreements = CountUndoDisagreements(undoneTurns);
+    printf("undo check: %s over %d turns\n", undoDisagreements == 0 ? "undo restores the board" : "DISAGREEMENT", undoneTurns);
+
+    int solvedBoards = 0;
+    int boards = 0;
+    int solverDisagreements = CountSolverDisagreements(solvedBoards, boards);
+    printf("solver check: %s, %d of %d boards solved within 8 moves\n\n",
+           solverDisagreements == 0 ? "one and four threads agree" : "DISAGREEMENT", solvedBoards, boards);
+
+    // a closed loop on the game's starting board, limited to keep the run short
+    EntityManager start;
+    SolverOptions options;
+    options.goal = SolverGoal{0, 1};
+    options.maxDepth = 14;
+
+    printf("%-8s %8s %12s %12s %10s %20s\n", "threads", "depth", "explored", "visited", "seconds", "states/s per core");
+    int64_t visitedInMemory = 0;
+    for (int threadCount : {1, 2, 4}) {
+        options.threadCount = threadCount;
+        SolverResult result = SolvePuzzle(start, options);
+        visitedInMemory = result.statesVisited;
+        printf("%-8d %8d %12lld %12lld %10.2f %20.0f\n", threadCount, result.depth,
+               static_cast<long long>(result.statesExplored), static_cast<long long>(result.statesVisited),
+               result.seconds, result.StatesPerSecondPerCore());
+    }
+
+    // the same search with visited states past a megabyte on disk must visit as many
+    options.threadCount = 1;
+    options.visitedMemory = size_t(1) << 20;
+    SolverResult spilled = SolvePuzzle(start, options);
+    bool isSpillSame = spilled.statesVisited == visitedInMemory;
+    printf("%-8s %8d %12lld %12lld %10.2f %20.0f  %.1f MB on disk, %s\n", "1 disk", spilled.depth,
+           static_cast<long long>(spilled.statesExplored), static_cast<long long>(spilled.statesVisited),
+           spilled.seconds, spilled.StatesPerSecondPerCore(), spilled.spilledBytes / 1048576.,
+           isSpillSame ? "same states as in memory" : "DISAGREEMENT");
+
+    return undoDisagreements == 0 && solverDisagreements == 0 && isSpillSame ? 0 : 1;
+}
@@ -0,0 +1,258 @@
+// Fixed seed scenarios across board sizes, piece densities and assembly sizes, timing the
+// parts of a turn and the frame built from it, with the heap allocations and memory each
+// costs. Run it before and after a change to MoveAllToAdjacent, RotateAll,
+// UpdateAllConnections or the frame data to see which way it went.
+//
+// Build and run natively, the frame data needs no GL context:
+//     make bench
+//     ./build/bench/SuiteBenchmark [filter]
+//
+// or with the Emscripten toolchain, where bytes touched are not available:
+//     emcc -O2 ./benchmarks/SuiteBenchmark.cpp ./source/EntityManager.cpp ./source/TrajectoryCache.cpp ./source/Bitboard.cpp ./source/BitboardTranslator.cpp ./source/FrameBuilder.cpp -I./source -s USE_SDL=2 -s ALLOW_MEMORY_GROWTH=1 -o suite_benchmark.js
+//     node suite_benchmark.js [filter]
+//
+// Only rows whose name contains the filter are run, e.g. "512x512" or "frame".
+
+#include "EntityManager.h"
+#include "FrameBuilder.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+static std::atomic<uint64_t> allocationCount(0);
+static std::atomic<uint64_t> allocatedBytes(0);
+
+void* operator new(size_t size)
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    if (void* memory = malloc(size ? size : 1))
+        return memory;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept
+{
+    free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+    free(memory);
+}
+
+// Pages referenced since the last reset, from the kernel's page table accessed bits, so
+// bytes touched are counted in whole pages and include the stack and the code. Linux only,
+// -1 elsewhere.
+static void ResetReferencedPages()
+{
+    if (FILE* file = fopen("/proc/self/clear_refs", "w")) {
+        fputs("1", file);
+        fclose(file);
+    }
+}
+
+static long ReferencedKilobytes()
+{
+    FILE* file = fopen("/proc/self/smaps_rollup", "r");
+    if (!file)
+        return -1;
+
+    char line[256];
+    long kilobytes = -1;
+    while (fgets(line, sizeof(line), file)) {
+        if (strncmp(line, "Referenced:", 11) == 0) {
+            kilobytes = strtol(line + 11, nullptr, 10);
+            break;
+        }
+    }
+    fclose(file);
+    return kilobytes;
+}
+
+static uint64_t randomState = 88172645463325252ull;
+
+static unsigned int Random()
+{
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 7;
+    randomState ^= randomState << 17;
+    return static_cast<unsigned int>(randomState);
+}
+
+struct Scenario {
+    BoardGeometry board;
+    int density;
+    int radius;
+    // percent of the blob's tiles that hold a piece of the assembly
+    int fill = 40;
+};
+
+// the pivot in the middle of a blob of movable pieces, among scattered pieces of every
+// type, inserted as one region
+static void Populate(EntityManager& em, const Scenario& scenario)
+{
+    BoardGeometry board = scenario.board;
+    em.LoadBoard(board);
+    pos center = pos{board.columns / 2, board.rows / 2};
+    em.AddEntity(EntityType::BENT_PIPE, center, true, UP);
+
+    std::vector<PackedTile> tiles(board.TileCount());
+    for (int y = 0; y < board.rows; y++) {
+        for (int x = 0; x < board.columns; x++) {
+            PackedTile& tile = tiles[x + y * board.columns];
+            Direction orientation = static_cast<Direction>(Random() % 4);
+            bool isInBlob = abs(x - center.x) <= scenario.radius && abs(y - center.y) <= scenario.radius;
+
+            if (isInBlob) {
+                tile = static_cast<int>(Random() % 100) < scenario.fill ? PackTile(EntityType::STRAIGHT_PIPE, orientation, true)
+                                                                         : PackTile(EntityType::BACKGROUND, UP, false);
+            } else if (static_cast<int>(Random() % 100) < scenario.density) {
+                unsigned int roll = Random() % 20;
+                EntityType type = roll == 0 ? EntityType::SOURCE : roll == 1 ? EntityType::SINK :
+                                  roll == 2 ? EntityType::TEE_PIPE : roll == 3 ? EntityType::CROSS_PIPE :
+                                  roll == 4 ? EntityType::BOX :
+                                  roll % 2 ? EntityType::BENT_PIPE : EntityType::STRAIGHT_PIPE;
+                tile = PackTile(type, orientation, false);
+            } else {
+                tile = PackTile(EntityType::BACKGROUND, UP, false);
+            }
+        }
+    }
+
+    em.InsertRegion(BoardRegion{pos{0, 0}, board.columns, board.rows}, tiles.data());
+}
+
+struct Measurement {
+    double nanoseconds;
+    double allocations;
+    double bytesAllocated;
+    double kilobytesTouched;
+};
+
+// a quarter of the operations warm up caches and buffers, the rest are measured
+template<typename Operation>
+static Measurement Measure(int operations, Operation operation)
+{
+    int warmup = operations / 4 + 1;
+    for (int n = 0; n < warmup; n++) {
+        operation(n);
+    }
+
+    ResetReferencedPages();
+    uint64_t allocationsBefore = allocationCount;
+    uint64_t bytesBefore = allocatedBytes;
+    auto start = std::chrono::steady_clock::now();
+
+    for (int n = 0; n < operations; n++) {
+        operation(warmup + n);
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    long touched = ReferencedKilobytes();
+
+    Measurement measurement;
+    measurement.nanoseconds = std::chrono::duration<double, std::nano>(end - start).count() / operations;
+    measurement.allocations = static_cast<double>(allocationCount - allocationsBefore) / operations;
+    measurement.bytesAllocated = static_cast<double>(allocatedBytes - bytesBefore) / operations;
+    measurement.kilobytesTouched = touched < 0 ? -1 : static_cast<double>(touched) / operations;
+    return measurement;
+}
+
+static void Report(const char* name, const char* phase, const Measurement& measurement)
+{
+    char touched[32];
+    if (measurement.kilobytesTouched < 0)
+        snprintf(touched, sizeof(touched), "-");
+    else
+        snprintf(touched, sizeof(touched), "%.1f", measurement.kilobytesTouched);
+
+    printf("%-22s %-12s %14.0f %10.2f %14.0f %14s\n", name, phase, measurement.nanoseconds,
+           measurement.allocations, measurement.bytesAllocated, touched);
+    fflush(stdout);
+}
+
+static bool IsSelected(const std::string& filter, const char* name, const char* phase)
+{
+    return filter.empty() || (std::string(name) + " " + phase).find(filter) != std::string::npos;
+}
+
+static void RunScenario(const Scenario& scenario, const std::string& filter)
+{
+    char name[48];
+    int length = snprintf(name, sizeof(name), "%dx%d/d%d/r%d", scenario.board.columns, scenario.board.rows,
+                          scenario.density, scenario.radius);
+    if (scenario.fill != 40)
+        snprintf(name + length, sizeof(name) - length, "/f%d", scenario.fill);
+
+    const char* phases[] = {"move", "rotate", "connections", "frame"};
+    bool isAnySelected = false;
+    for (const char* phase : phases) {
+        isAnySelected = isAnySelected || IsSelected(filter, name, phase);
+    }
+    if (!isAnySelected)
+        return;
+
+    // the same pieces for every run of a scenario, whatever ran before it
+    randomState = 88172645463325252ull ^ (scenario.board.TileCount() * 31 + scenario.density * 7 + scenario.radius);
+    EntityManager em(scenario.board);
+    Populate(em, scenario);
+
+    // about two million tiles walked per phase, at least a full cycle of moves
+    int operations = std::max(8, 2000000 / scenario.board.TileCount());
+
+    // right, down, left, up brings an unblocked assembly back where it started
+    if (IsSelected(filter, name, "move")) {
+        const Direction cycle[] = {RIGHT, DOWN, LEFT, UP};
+        Report(name, "move", Measure(operations, [&](int n) { em.MoveAllToAdjacent(cycle[n % 4]); }));
+    }
+
+    if (IsSelected(filter, name, "rotate")) {
+        Report(name, "rotate", Measure(operations, [&](int n) { em.RotateAll(n % 2 ? RIGHT : LEFT); }));
+    }
+
+    if (IsSelected(filter, name, "connections")) {
+        Report(name, "connections", Measure(operations, [&](int) { em.UpdateAllConnections(em.assemblies[0]); }));
+    }
+
+    // frames follow a move, the first few still animate it
+    if (IsSelected(filter, name, "frame")) {
+        float tileWidth = 2.0f / static_cast<float>(scenario.board.columns);
+        float tileHeight = 2.0f / static_cast<float>(scenario.board.rows);
+        FrameBuilder frame(scenario.board, tileWidth, tileHeight);
+        em.MoveAllToAdjacent(RIGHT);
+        Report(name, "frame", Measure(operations, [&](int) { frame.Build(em); }));
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string filter = argc > 1 ? argv[1] : "";
+
+    const BoardGeometry boards[] = {{20, 16}, {128, 128}, {512, 512}, {2048, 2048}};
+    const int densities[] = {10, 40};
+
+    printf("%-22s %-12s %14s %10s %14s %14s\n", "scenario", "phase", "ns/op", "allocs/op", "bytes alloc/op", "KiB touched/op");
+
+    for (BoardGeometry board : boards) {
+        for (int density : densities) {
+            // a handful of pieces, and a blob as large as the board allows up to 17x17
+            int largest = std::min(8, std::min(board.columns, board.rows) / 2 - 1);
+            for (int radius : {1, largest}) {
+                RunScenario(Scenario{board, density, radius}, filter);
+            }
+        }
+    }
+
+    // a solid 23x23 assembly of 529 pieces turning on an empty board
+    RunScenario(Scenario{{128, 128}, 0, 11, 100}, filter);
+
+    return 0;
+}
@@ -0,0 +1,225 @@
+// Checks that both translation backends agree with the recursive MoveToAdjacentTile
+// reference on random boards, then measures raw bitboard translation throughput
+// and whole MoveAllToAdjacent turns per backend.
+//
+// Build and run natively:
+//     make bench
+//     ./build/bench/TranslationBenchmark
+//
+// or with the Emscripten toolchain:
+//     emcc -O2 -msimd128 ./benchmarks/TranslationBenchmark.cpp ./source/EntityManager.cpp ./source/TrajectoryCache.cpp ./source/Bitboard.cpp ./source/BitboardTranslator.cpp -I./source -s USE_SDL=2 -s ALLOW_MEMORY_GROWTH=1 -o translation_benchmark.js
+//     node translation_benchmark.js
+
+#include "EntityManager.h"
+
+#include <chrono>
+#include <cstdio>
+#include <stdint.h>
+
+static uint64_t randomState = 88172645463325252ull;
+
+static unsigned int Random()
+{
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 7;
+    randomState ^= randomState << 17;
+    return static_cast<unsigned int>(randomState);
+}
+
+static void Populate(EntityManager& em, BoardGeometry board, int density, int movableShare)
+{
+    em.LoadBoard(board);
+    em.AddEntity(EntityType::BENT_PIPE, pos{board.columns / 2, board.rows / 2}, true, UP);
+
+    int count = board.TileCount() * density / 100;
+    for (int i = 0; i < count; i++) {
+        pos position = pos{static_cast<int>(Random() % board.columns), static_cast<int>(Random() % board.rows)};
+        EntityType type = Random() % 2 ? EntityType::BENT_PIPE : EntityType::STRAIGHT_PIPE;
+        em.AddEntity(type, position, static_cast<int>(Random() % 100) < movableShare, static_cast<Direction>(Random() % 4));
+    }
+}
+
+// a movable blob around the middle of the board among sparse obstacles, so that
+// translations keep completing while pushing pieces along
+static void PopulateAssembly(EntityManager& em, BoardGeometry board, int obstacleDensity)
+{
+    em.LoadBoard(board);
+
+    pos center = pos{board.columns / 2, board.rows / 2};
+    em.AddEntity(EntityType::BENT_PIPE, center, true, UP);
+
+    int radius = std::max(2, std::min(board.columns, board.rows) / 10);
+    for (int y = -radius; y <= radius; y++) {
+        for (int x = -radius; x <= radius; x++) {
+            if (Random() % 100 < 60)
+                em.AddEntity(EntityType::STRAIGHT_PIPE, pos{center.x + x, center.y + y}, true, UP);
+        }
+    }
+
+    int count = board.TileCount() * obstacleDensity / 100;
+    for (int i = 0; i < count; i++) {
+        pos position = pos{static_cast<int>(Random() % board.columns), static_cast<int>(Random() % board.rows)};
+        em.AddEntity(EntityType::BOX, position, false, UP);
+    }
+}
+
+// the translation as MoveAllToAdjacent did it before push chains were resolved iteratively
+static void ReferenceMove(EntityManager& em, Direction direction)
+{
+    Assembly& assembly = em.assemblies.front();
+    em.InitializeTurn(assembly);
+    for (int i = 0; i < em.numEntities; i++) {
+        if (em.isMovable.Test(i))
+            em.MoveToAdjacentTile(assembly, i, direction);
+    }
+    em.FinalizeTurn(assembly);
+    em.isTurnOk = assembly.isTurnOk;
+}
+
+static bool SameState(EntityManager& a, EntityManager& b)
+{
+    if (a.numEntities != b.numEntities || a.isTurnOk != b.isTurnOk)
+        return false;
+
+    for (int i = 0; i < a.numEntities; i++) {
+        if (a.positions[i].x != b.positions[i].x || a.positions[i].y != b.positions[i].y ||
+            a.isMovable.Test(i) != b.isMovable.Test(i))
+            return false;
+    }
+
+    for (int y = 0; y < a.board.rows; y++) {
+        for (int x = 0; x < a.board.columns; x++) {
+            if (a.getEntityIndexFromPosition(pos{x, y}) != b.getEntityIndexFromPosition(pos{x, y}) ||
+                a.occupancy.Test(pos{x, y}) != b.occupancy.Test(pos{x, y}))
+                return false;
+        }
+    }
+
+    return true;
+}
+
+static int CountDisagreements(int& completedTurns, int& turns)
+{
+    const BoardGeometry boards[] = {{20, 16}, {7, 5}, {64, 12}, {65, 9}, {130, 40}};
+    int disagreements = 0;
+
+    for (BoardGeometry board : boards) {
+        for (int game = 0; game < 200; game++) {
+            EntityManager reference(board);
+            EntityManager chains(board);
+            EntityManager bitboards(board);
+            bitboards.translationBackend = TranslationBackend::BITBOARD;
+
+            uint64_t seed = randomState;
+            bool isAssembly = game % 2 == 0;
+            int density = isAssembly ? 2 + Random() % 10 : 10 + Random() % 60;
+            int movableShare = 5 + Random() % 30;
+            for (EntityManager* em : {&reference, &chains, &bitboards}) {
+                randomState = seed;
+                if (isAssembly)
+                    PopulateAssembly(*em, board, density);
+                else
+                    Populate(*em, board, density, movableShare);
+            }
+
+            for (int turn = 0; turn < 60; turn++) {
+                Direction direction = static_cast<Direction>(Random() % 4);
+                ReferenceMove(reference, direction);
+                chains.MoveAllToAdjacent(direction);
+                bitboards.MoveAllToAdjacent(direction);
+                completedTurns += reference.isTurnOk;
+                turns++;
+
+                if (!SameState(reference, chains) || !SameState(reference, bitboards)) {
+                    printf("disagreement on %dx%d, game %d, turn %d\n", board.columns, board.rows, game, turn);
+                    disagreements++;
+                    break;
+                }
+            }
+        }
+    }
+
+    return disagreements;
+}
+
+static double MillionStepsPerSecond(BoardGeometry board, int steps)
+{
+    EntityManager em(board);
+    randomState = 12345;
+    PopulateAssembly(em, board, 5);
+
+    Bitboard occupancy;
+    Bitboard movable;
+    occupancy.CopyFrom(em.occupancy);
+    movable.Resize(board.columns, board.rows);
+    for (int i = 0; i < em.numEntities; i++) {
+        if (em.isMovable.Test(i))
+            movable.Set(em.positions[i]);
+    }
+
+    BitboardTranslator translator;
+    static const Direction cycle[] = {RIGHT, DOWN, LEFT, UP};
+    int completed = 0;
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < steps; i++) {
+        Direction direction = cycle[i % 4];
+        if (translator.Resolve(occupancy, movable, direction)) {
+            translator.Apply(occupancy, movable, direction);
+            completed++;
+        }
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(end - start).count();
+
+    if (completed < steps / 2)
+        printf("  (only %d of %d steps completed on %dx%d)\n", completed, steps, board.columns, board.rows);
+
+    return steps / seconds / 1e6;
+}
+
+static double NanosecondsPerTurn(BoardGeometry board, TranslationBackend backend, int turns)
+{
+    EntityManager em(board);
+    randomState = 12345;
+    PopulateAssembly(em, board, 5);
+    em.translationBackend = backend;
+
+    static const Direction cycle[] = {RIGHT, DOWN, LEFT, UP};
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < turns; i++) {
+        em.MoveAllToAdjacent(cycle[i % 4]);
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / turns;
+}
+
+int main()
+{
+    int completedTurns = 0;
+    int turns = 0;
+    int disagreements = CountDisagreements(completedTurns, turns);
+    printf("differential check: %s over %d turns, %d completed\n\n",
+           disagreements == 0 ? "all backends agree" : "DISAGREEMENT", turns, completedTurns);
+
+    const BoardGeometry boards[] = {{20, 16}, {64, 64}, {256, 256}};
+
+    printf("%-12s %18s %20s %18s\n", "board", "bitboard Msteps/s", "push chains ns/turn", "bitboard ns/turn");
+
+    for (BoardGeometry board : boards) {
+        double steps = MillionStepsPerSecond(board, 2000000 / (board.columns / 16));
+        double chains = NanosecondsPerTurn(board, TranslationBackend::PUSH_CHAINS, 20000);
+        double bitboards = NanosecondsPerTurn(board, TranslationBackend::BITBOARD, 20000);
+
+        char name[32];
+        snprintf(name, sizeof(name), "%dx%d", board.columns, board.rows);
+        printf("%-12s %18.2f %20.1f %18.1f\n", name, steps, chains, bitboards);
+    }
+
+    return disagreements == 0 ? 0 : 1;
+}
@@ -0,0 +1,101 @@
+// Measures the cost of a single turn as the board grows, and counts the heap
+// allocations a turn makes once its buffers have warmed up. Built with -DPIPE_STATS
+// it also prints the engine's own per turn counters for every board.
+//
+// Build and run natively:
+//     make bench
+//     ./build/bench/TurnBenchmark
+//
+// or with the Emscripten toolchain:
+//     emcc -O2 ./benchmarks/TurnBenchmark.cpp ./source/EntityManager.cpp ./source/TrajectoryCache.cpp ./source/Bitboard.cpp ./source/BitboardTranslator.cpp -I./source -s USE_SDL=2 -s ALLOW_MEMORY_GROWTH=1 -o turn_benchmark.js
+//     node turn_benchmark.js
+
+#include "EntityManager.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+static unsigned long long allocationCount = 0;
+
+void* operator new(size_t size)
+{
+    allocationCount++;
+    if (void* memory = malloc(size ? size : 1))
+        return memory;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept
+{
+    free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+    free(memory);
+}
+
+static const Direction moveCycle[] = {RIGHT, DOWN, LEFT, UP};
+
+struct TurnCost {
+    double nanoseconds;
+    double allocations;
+};
+
+static TurnCost MeasureTurns(EntityManager& em, int turns, bool isRotation)
+{
+    unsigned long long allocationsBefore = allocationCount;
+    auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < turns; i++) {
+        if (isRotation)
+            em.RotateAll(i % 2 == 0 ? LEFT : RIGHT);
+        else
+            em.MoveAllToAdjacent(moveCycle[i % 4]);
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    return TurnCost{std::chrono::duration<double, std::nano>(end - start).count() / turns,
+                    static_cast<double>(allocationCount - allocationsBefore) / turns};
+}
+
+int main()
+{
+    const BoardGeometry boards[] = {
+        {20, 16}, {64, 64}, {256, 256}, {1024, 1024}, {2048, 2048}
+    };
+    const int turns = 20000;
+
+    printf("%-12s %10s %14s %14s %14s %14s\n", "board", "entities", 
+           "move ns/turn", "move allocs", "rotate ns/turn", "rotate allocs");
+
+    for (BoardGeometry board : boards) {
+        EntityManager em(board);
+
+        // warm up so journals and scratch buffers reach their steady state capacity
+        MeasureTurns(em, turns / 10, false);
+        MeasureTurns(em, turns / 10, true);
+        TurnCost move = MeasureTurns(em, turns, false);
+        TurnCost rotate = MeasureTurns(em, turns, true);
+
+        char name[32];
+        snprintf(name, sizeof(name), "%dx%d", board.columns, board.rows);
+        printf("%-12s %10u %14.1f %14.2f %14.1f %14.2f\n", name, em.numEntities, 
+               move.nanoseconds, move.allocations, rotate.nanoseconds, rotate.allocations);
+
+#ifdef PIPE_STATS
+        const PipeStats& stats = em.stats;
+        double turns = stats.turns;
+        printf("  %d turns, %d blocked, p50 under %.0f us, p99 under %.0f us of the last %d\n", stats.turns, stats.blockedTurns,
+               stats.turnMicros.Percentile(0.5), stats.turnMicros.Percentile(0.99), stats.turnMicros.SampleCount());
+        printf("  per turn: %.1f rotation events, %.1f swept, %.1f moved, %.2f link refreshes, %.2f us connecting\n",
+               stats.totals.rotationEvents / turns, stats.totals.sweptEvents / turns, stats.totals.movedPieces / turns,
+               stats.totals.linkRefreshes / turns, stats.totals.connectionMicros / turns);
+        printf("  longest push chain %d\n", stats.totals.longestPushChain);
+#endif
+    }
+
+    return 0;
+}
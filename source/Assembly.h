@@ -0,0 +1,73 @@
+#pragma once
+
+#include "SimulationTypes.h"
+#include "EntityHandle.h"
+#include "BitSet.h"
+#include "Bitboard.h"
+#include "BitboardTranslator.h"
+#include "TurnJournal.h"
+#include "TrajectoryMerge.h"
+#include "CollisionSweep.h"
+#include "TurnStats.h"
+
+#include <vector>
+
+// a group of movable pieces that translates together and rotates about its own pivot,
+// it owns everything a turn writes while resolving so assemblies do not share scratch
+struct Assembly {
+    EntityHandle pivot = EntityHandle{0, 0};
+    BitSet members;
+
+    // turn bookkeeping
+    TurnJournal journal;
+    std::vector<EntityRecord> pushedEntities;
+    std::vector<int> chainEntities;
+    BitSet claimed;
+    BitSet rotatingEntities;
+
+    // tiles read by a resolution against the board as it was at the start of the turn
+    std::vector<int> footprint;
+    bool isResolved = false;
+    pos regionLow = pos{0,0};
+    pos regionHigh = pos{0,0};
+
+    RotationCounts rotationCounts = RotationCounts{0,0};
+    RotationCounts pendingRotation = RotationCounts{0,0};
+    // what the last committed turn added to rotationCounts, taken back by UndoTurn
+    RotationCounts turnRotation = RotationCounts{0,0};
+    float partialRotationAngle = 0.0f;
+    int partialRotationSign = 0;
+
+    bool isTurnOk = true;
+    bool isRotationOk = true;
+
+    // bitboard translation backend
+    Bitboard movableMask;
+    BitboardTranslator translator;
+
+    // whole assembly placement check
+    Bitboard assemblyMask;
+    Bitboard rotatedAssemblyMask;
+    std::vector<uint64_t> occupiedRow;
+    std::vector<uint64_t> assemblyRow;
+
+    TrajectoryMerge rotationEvents;
+    CollisionResult collision;
+    SweepScratch sweep;
+
+#ifdef PIPE_STATS
+    TurnStats stats = {};
+#endif
+
+    void Resize(int entityCount, int tileCount) {
+        pivot = EntityHandle{0, 0};
+        members.Resize(entityCount);
+        claimed.Resize(entityCount);
+        rotatingEntities.Resize(entityCount);
+        sweep.Resize(tileCount, entityCount);
+        journal.Clear();
+        pushedEntities.clear();
+        chainEntities.clear();
+        footprint.clear();
+    }
+};
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+
+// angles as fractions of a full turn in 32 bits, so differences wrap around the circle.
+// Only integer arithmetic is used, native and web builds produce the same bits
+
+typedef uint32_t BinaryAngle;
+
+#define BINARY_QUARTER_TURN 0x40000000u
+#define BINARY_HALF_TURN 0x80000000u
+
+// atan(2^-i) as a fraction of a full turn
+static const uint32_t cordicAngles[31] = {
+    0x20000000, 0x12e4051e, 0x09fb385b, 0x051111d4,
+    0x028b0d43, 0x0145d7e1, 0x00a2f61e, 0x00517c55,
+    0x0028be53, 0x00145f2f, 0x000a2f98, 0x000517cc,
+    0x00028be6, 0x000145f3, 0x0000a2fa, 0x0000517d,
+    0x000028be, 0x0000145f, 0x00000a30, 0x00000518,
+    0x0000028c, 0x00000146, 0x000000a3, 0x00000051,
+    0x00000029, 0x00000014, 0x0000000a, 0x00000005,
+    0x00000003, 0x00000001, 0x00000001,
+};
+
+inline float BinaryAngleToRadians(BinaryAngle angle)
+{
+    return static_cast<float>(angle) * (6.2831853f / 4294967296.f);
+}
+
+// the double estimate is corrected in integers, so the result is exact on every platform
+inline uint64_t SquareRootFloor(uint64_t value)
+{
+    uint64_t root = static_cast<uint64_t>(sqrt(static_cast<double>(value)));
+    root = root > 0xffffffffull ? 0xffffffffull : root;
+    while (root * root > value)
+        root--;
+    while (root < 0xffffffffull && (root + 1) * (root + 1) <= value)
+        root++;
+    return root;
+}
+
+// atan(tangent / 2^32) for a tangent in [0, 2^32] by CORDIC vectoring
+inline BinaryAngle ArcTangent(uint64_t tangent)
+{
+    int64_t x = 1ll << 32;
+    int64_t y = static_cast<int64_t>(tangent);
+    uint32_t angle = 0;
+
+    // rotate towards the x axis, negate is all ones when y is below it
+    for (int i = 0; i < 31; i++) {
+        int64_t negate = y >> 63;
+        int64_t shiftedX = ((x >> i) ^ negate) - negate;
+        int64_t shiftedY = ((y >> i) ^ negate) - negate;
+        x += shiftedY;
+        y -= shiftedX;
+        angle += (cordicAngles[i] ^ static_cast<uint32_t>(negate)) - static_cast<uint32_t>(negate);
+    }
+    return angle;
+}
+
+// direction of the point (xSign * sqrt(xSquared), ySign * sqrt(ySquared)), counter clockwise from
+// the x axis. Points on the same ray give the same ratio of squares and so the same angle
+inline BinaryAngle BinaryAngleOf(uint64_t xSquared, uint64_t ySquared, int xSign, int ySign)
+{
+    uint64_t small = xSquared < ySquared ? xSquared : ySquared;
+    uint64_t large = xSquared < ySquared ? ySquared : xSquared;
+    while (large >= 1ull << 32) {
+        small >>= 1;
+        large >>= 1;
+    }
+
+    // angle of the point folded into the first octant
+    uint64_t ratio = large == 0 ? 0 : (small << 32) / large;
+    uint64_t tangent = ratio >> 32 ? 1ull << 32 : SquareRootFloor(ratio << 32);
+    BinaryAngle octant = ArcTangent(tangent);
+    BinaryAngle quadrant = xSquared >= ySquared ? octant : BINARY_QUARTER_TURN - octant;
+
+    if (xSign >= 0)
+        return ySign >= 0 ? quadrant : 0u - quadrant;
+    return ySign >= 0 ? BINARY_HALF_TURN - quadrant : BINARY_HALF_TURN + quadrant;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "SimulationTypes.h"
+#include "WordOps.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+// one bit per entity index, bulk operations work a word (or a vector register) at a time
+// through WordOps and only cover the bits below end, so a sparse board does not pay for its capacity
+class BitSet {
+    std::vector<uint64_t> words;
+    int bitCount = 0;
+
+    size_t WordsBelow(int end) const {
+        size_t count = (static_cast<size_t>(end) + 63) / 64;
+        return count < words.size() ? count : words.size();
+    }
+
+    public:
+        void Resize(int size) {
+            bitCount = size;
+            words.assign((size + 63) / 64, 0);
+        }
+
+        int Size() const { return bitCount; }
+
+        bool Test(int index) const {
+            return (words[index >> 6] >> (index & 63)) & 1;
+        }
+
+        void Set(int index) {
+            words[index >> 6] |= uint64_t(1) << (index & 63);
+        }
+
+        void Reset(int index) {
+            words[index >> 6] &= ~(uint64_t(1) << (index & 63));
+        }
+
+        void Assign(int index, bool value) {
+            if (value)
+                Set(index);
+            else
+                Reset(index);
+        }
+
+        void ClearAll(int end) {
+            memset(words.data(), 0, WordsBelow(end) * sizeof(uint64_t));
+        }
+
+        // both sets must have the same size
+        void CopyFrom(const BitSet& other, int end) {
+            memcpy(words.data(), other.words.data(), WordsBelow(end) * sizeof(uint64_t));
+        }
+
+        void OrWith(const BitSet& other, int end) {
+            OrWords(words.data(), other.words.data(), WordsBelow(end));
+        }
+
+        void AndNotWith(const BitSet& other, int end) {
+            AndNotWords(words.data(), other.words.data(), WordsBelow(end));
+        }
+
+        // popcount is a single instruction on x86 and wasm, so it stays per word
+        int Count(int end) const {
+            int count = 0;
+            for (size_t w = 0; w < WordsBelow(end); w++) {
+                count += __builtin_popcountll(words[w]);
+            }
+            return count;
+        }
+
+        bool Any(int end) const {
+            for (size_t w = 0; w < WordsBelow(end); w++) {
+                if (words[w])
+                    return true;
+            }
+            return false;
+        }
+
+        // visits set bits in increasing order until the visitor returns false
+        template <typename Visitor>
+        bool ForEachSetBit(int end, Visitor visit) const {
+            size_t count = WordsBelow(end);
+            for (size_t w = 0; w < count; w++) {
+                uint64_t word = words[w];
+                while (word) {
+                    int index = static_cast<int>(w * 64) + __builtin_ctzll(word);
+                    word &= word - 1;
+                    if (!visit(index))
+                        return false;
+                }
+            }
+            return true;
+        }
+};
@@ -0,0 +1,183 @@
+#include "Bitboard.h"
+
+void Bitboard::Resize(int columnCount, int rowCount)
+{
+    columns = columnCount;
+    rows = rowCount;
+    wordsPerRow = (columnCount + 63) / 64;
+    words.assign(static_cast<size_t>(wordsPerRow) * rowCount, 0);
+}
+
+void Bitboard::ExtractRow(int y, int x, int width, uint64_t* out) const
+{
+    int count = (width + 63) / 64;
+
+    for (int k = 0; k < count; k++) {
+        int start = x + 64 * k;
+        uint64_t value;
+
+        if (start >= 0) {
+            int word = start >> 6;
+            int offset = start & 63;
+            value = WordAt(y, word) >> offset;
+            if (offset)
+                value |= WordAt(y, word + 1) << (64 - offset);
+        } else {
+            value = start > -64 ? WordAt(y, 0) << -start : 0;
+        }
+
+        out[k] = value;
+    }
+
+    if (width & 63)
+        out[count - 1] &= (uint64_t(1) << (width & 63)) - 1;
+}
+
+void Bitboard::RotateQuarterFrom(const Bitboard& source, int sign)
+{
+    // transpose 64x64 blocks so source column u becomes row u
+    Resize(source.rows, source.columns);
+
+    uint64_t block[64];
+    for (int blockRow = 0; blockRow < source.rows; blockRow += 64) {
+        for (int blockColumn = 0; blockColumn < source.wordsPerRow; blockColumn++) {
+            for (int i = 0; i < 64; i++) {
+                block[i] = blockRow + i < source.rows ? source.WordAt(blockRow + i, blockColumn) : 0;
+            }
+
+            Transpose64(block);
+
+            for (int i = 0; i < 64 && blockColumn * 64 + i < rows; i++) {
+                words[(blockColumn * 64 + i) * wordsPerRow + blockRow / 64] = block[i];
+            }
+        }
+    }
+
+    if (sign < 0) {
+        // rows come out in reverse order
+        for (int top = 0, bottom = rows - 1; top < bottom; top++, bottom--) {
+            std::swap_ranges(words.begin() + top * wordsPerRow,
+                             words.begin() + (top + 1) * wordsPerRow,
+                             words.begin() + bottom * wordsPerRow);
+        }
+        return;
+    }
+
+    // columns come out in reverse order, reverse every row and drop the padding it shifted in
+    int padding = wordsPerRow * 64 - columns;
+    for (int y = 0; y < rows; y++) {
+        uint64_t* row = words.data() + y * wordsPerRow;
+        std::reverse(row, row + wordsPerRow);
+        for (int k = 0; k < wordsPerRow; k++) {
+            row[k] = ReverseBits(row[k]);
+        }
+
+        if (padding) {
+            for (int k = 0; k < wordsPerRow; k++) {
+                uint64_t next = k + 1 < wordsPerRow ? row[k + 1] : 0;
+                row[k] = (row[k] >> padding) | (next << (64 - padding));
+            }
+        }
+    }
+}
+
+void Bitboard::ShiftInto(Bitboard& out, Direction direction, int distance) const
+{
+    out.columns = columns;
+    out.rows = rows;
+    out.wordsPerRow = wordsPerRow;
+    out.words.resize(words.size());
+
+    if (direction == UP || direction == DOWN) {
+        int movedRows = std::max(rows - distance, 0);
+        size_t offset = static_cast<size_t>(std::min(distance, rows)) * wordsPerRow;
+        size_t count = static_cast<size_t>(movedRows) * wordsPerRow;
+
+        if (direction == UP) {
+            std::copy(words.begin() + offset, words.begin() + offset + count, out.words.begin());
+            std::fill(out.words.begin() + count, out.words.end(), 0);
+        } else {
+            std::fill(out.words.begin(), out.words.begin() + offset, 0);
+            std::copy(words.begin(), words.begin() + count, out.words.begin() + offset);
+        }
+        return;
+    }
+
+    // rows that fit in one word shift as a flat array, wider rows carry between words
+    if (wordsPerRow == 1 && distance < 64) {
+        if (direction == RIGHT)
+            ShiftLeftMaskWords(out.words.data(), words.data(), words.size(), distance, LastWordMask());
+        else
+            ShiftRightWords(out.words.data(), words.data(), words.size(), distance);
+        return;
+    }
+
+    int wordShift = distance >> 6;
+    int bitShift = distance & 63;
+
+    for (int y = 0; y < rows; y++) {
+        const uint64_t* in = words.data() + y * wordsPerRow;
+        uint64_t* row = out.words.data() + y * wordsPerRow;
+
+        for (int k = 0; k < wordsPerRow; k++) {
+            uint64_t value;
+            if (direction == RIGHT) {
+                int from = k - wordShift;
+                value = from >= 0 ? in[from] << bitShift : 0;
+                if (bitShift && from - 1 >= 0)
+                    value |= in[from - 1] >> (64 - bitShift);
+            } else {
+                int from = k + wordShift;
+                value = from < wordsPerRow ? in[from] >> bitShift : 0;
+                if (bitShift && from + 1 < wordsPerRow)
+                    value |= in[from + 1] << (64 - bitShift);
+            }
+            row[k] = value;
+        }
+
+        row[wordsPerRow - 1] &= LastWordMask();
+    }
+}
+
+bool Bitboard::AnyOnEdge(Direction direction) const
+{
+    switch (direction) {
+        case UP:
+            return AnyWords(words.data(), wordsPerRow);
+        case DOWN:
+            return AnyWords(words.data() + (rows - 1) * wordsPerRow, wordsPerRow);
+        default:
+            break;
+    }
+
+    int column = direction == LEFT ? 0 : columns - 1;
+    uint64_t bit = uint64_t(1) << (column & 63);
+    uint64_t any = 0;
+    for (int y = 0; y < rows; y++) {
+        any |= words[y * wordsPerRow + (column >> 6)] & bit;
+    }
+    return any != 0;
+}
+
+void Bitboard::Transpose64(uint64_t block[64])
+{
+    // swap ever smaller off diagonal sub blocks, bit c of row r ends up as bit r of row c
+    uint64_t mask = 0x00000000FFFFFFFFull;
+    for (int width = 32; width > 0; width >>= 1, mask ^= mask << width) {
+        for (int k = 0; k < 64; k = ((k | width) + 1) & ~width) {
+            uint64_t swapped = ((block[k] >> width) ^ block[k | width]) & mask;
+            block[k] ^= swapped << width;
+            block[k | width] ^= swapped;
+        }
+    }
+}
+
+uint64_t Bitboard::ReverseBits(uint64_t word)
+{
+    word = ((word >> 1) & 0x5555555555555555ull) | ((word & 0x5555555555555555ull) << 1);
+    word = ((word >> 2) & 0x3333333333333333ull) | ((word & 0x3333333333333333ull) << 2);
+    word = ((word >> 4) & 0x0F0F0F0F0F0F0F0Full) | ((word & 0x0F0F0F0F0F0F0F0Full) << 4);
+    word = ((word >> 8) & 0x00FF00FF00FF00FFull) | ((word & 0x00FF00FF00FF00FFull) << 8);
+    word = ((word >> 16) & 0x0000FFFF0000FFFFull) | ((word & 0x0000FFFF0000FFFFull) << 16);
+    return (word >> 32) | (word << 32);
+}
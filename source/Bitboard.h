@@ -0,0 +1,92 @@
+#pragma once
+
+#include "SimulationTypes.h"
+#include "WordOps.h"
+
+#include <stdint.h>
+#include <vector>
+
+// one bit per tile in reading order, every row starts on a fresh word,
+// bit i of word k in a row is column 64k+i
+class Bitboard {
+    int columns = 0;
+    int rows = 0;
+    int wordsPerRow = 0;
+    std::vector<uint64_t> words;
+
+    uint64_t WordAt(int y, int word) const {
+        return word >= 0 && word < wordsPerRow ? words[y * wordsPerRow + word] : 0;
+    }
+
+    // valid columns of the last word in a row
+    uint64_t LastWordMask() const {
+        return (columns & 63) ? (uint64_t(1) << (columns & 63)) - 1 : ~uint64_t(0);
+    }
+
+    static void Transpose64(uint64_t block[64]);
+    static uint64_t ReverseBits(uint64_t word);
+
+    public:
+        // clears every bit, keeps the capacity of earlier sizes
+        void Resize(int columnCount, int rowCount);
+
+        int Columns() const { return columns; }
+        int Rows() const { return rows; }
+        int WordsPerRow() const { return wordsPerRow; }
+
+        const uint64_t* Row(int y) const { return words.data() + y * wordsPerRow; }
+        uint64_t* Data() { return words.data(); }
+        const uint64_t* Data() const { return words.data(); }
+        size_t WordCount() const { return words.size(); }
+
+        void CopyFrom(const Bitboard& other) {
+            columns = other.columns;
+            rows = other.rows;
+            wordsPerRow = other.wordsPerRow;
+            words = other.words;
+        }
+
+        bool Test(pos position) const {
+            return (words[position.y * wordsPerRow + (position.x >> 6)] >> (position.x & 63)) & 1;
+        }
+
+        void Set(pos position) {
+            words[position.y * wordsPerRow + (position.x >> 6)] |= uint64_t(1) << (position.x & 63);
+        }
+
+        void Reset(pos position) {
+            words[position.y * wordsPerRow + (position.x >> 6)] &= ~(uint64_t(1) << (position.x & 63));
+        }
+
+        void Assign(pos position, bool value) {
+            if (value)
+                Set(position);
+            else
+                Reset(position);
+        }
+
+        // copies width bits of row y starting at column x, columns off the board read as clear
+        void ExtractRow(int y, int x, int width, uint64_t* out) const;
+
+        // this becomes source turned a quarter turn, sign follows GetProjectedPosition
+        void RotateQuarterFrom(const Bitboard& source, int sign);
+
+        // out becomes this moved distance tiles towards direction, bits leaving the board are dropped
+        void ShiftInto(Bitboard& out, Direction direction, int distance) const;
+
+        // whether any bit lies on the board edge that faces direction
+        bool AnyOnEdge(Direction direction) const;
+
+        template <typename Visitor>
+        void ForEachSetBit(Visitor visit) const {
+            for (int y = 0; y < rows; y++) {
+                for (int k = 0; k < wordsPerRow; k++) {
+                    uint64_t word = words[y * wordsPerRow + k];
+                    while (word) {
+                        visit(pos{.x=k * 64 + __builtin_ctzll(word), .y=y});
+                        word &= word - 1;
+                    }
+                }
+            }
+        }
+};
@@ -0,0 +1,27 @@
+#include "BitboardTranslator.h"
+
+bool BitboardTranslator::Resolve(const Bitboard& occupancy, const Bitboard& movable, Direction direction)
+{
+    // grow the movable mask forward through occupied tiles, every round extends
+    // each pushed run by one tile and runs are short, so this settles quickly
+    moved.CopyFrom(movable);
+
+    while (true) {
+        moved.ShiftInto(shifted, direction, 1);
+        if (!OrAndWords(moved.Data(), shifted.Data(), occupancy.Data(), moved.WordCount()))
+            break;
+    }
+
+    // a run that reaches the edge has no free tile to move into
+    return !moved.AnyOnEdge(direction);
+}
+
+void BitboardTranslator::Apply(Bitboard& occupancy, Bitboard& movable, Direction direction)
+{
+    moved.ShiftInto(shifted, direction, 1);
+    AndNotWords(occupancy.Data(), moved.Data(), occupancy.WordCount());
+    OrWords(occupancy.Data(), shifted.Data(), occupancy.WordCount());
+
+    movable.ShiftInto(shifted, direction, 1);
+    movable.CopyFrom(shifted);
+}
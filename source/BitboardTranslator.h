@@ -0,0 +1,24 @@
+#pragma once
+
+#include "SimulationTypes.h"
+#include "Bitboard.h"
+
+// resolves a one tile translation of every movable piece with word operations on bitboards,
+// it works on masks alone so a level search can step states without an EntityManager.
+// That mask stepping is where it pays off. As TranslationBackend::BITBOARD an engine turn
+// costs about what push chains do, as moving the entities and refreshing their links
+// dominates the turn once the moved tiles are known.
+class BitboardTranslator {
+    Bitboard moved;
+    Bitboard shifted;
+
+    public:
+        // false when a pushed run would leave the board, Moved() then holds every tile whose
+        // occupant moves: the movable tiles and the occupied runs in front of them
+        bool Resolve(const Bitboard& occupancy, const Bitboard& movable, Direction direction);
+
+        const Bitboard& Moved() const { return moved; }
+
+        // moves occupancy and the movable mask along with the last successful Resolve
+        void Apply(Bitboard& occupancy, Bitboard& movable, Direction direction);
+};
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "SimulationTypes.h"
+
+// order of tiles in per tile arrays, chosen when a board is created
+enum class TileLayout {
+    ROW_MAJOR,
+    // 8x8 blocks stored row by row, Z-order inside a block, so a rotation
+    // that maps rows onto columns stays within a few cache lines per block
+    TILED
+};
+
+#define TILE_BLOCK_SHIFT 3
+#define TILE_BLOCK_SIDE (1 << TILE_BLOCK_SHIFT)
+#define TILE_BLOCK_MASK (TILE_BLOCK_SIDE - 1)
+
+// runtime sized board, chosen when a level is loaded
+struct BoardGeometry {
+    int columns;
+    int rows;
+    TileLayout layout = TileLayout::ROW_MAJOR;
+
+    // capacity of per tile arrays, a tiled board is padded to whole blocks and
+    // to a power of two blocks per row so tile indices convert without division
+    int TileCount() const {
+        if (layout == TileLayout::TILED)
+            return ((rows + TILE_BLOCK_MASK) >> TILE_BLOCK_SHIFT) << (BlockRowShift() + 2 * TILE_BLOCK_SHIFT);
+
+        return columns * rows;
+    }
+
+    bool CheckBounds(pos position) const {
+        return (position.x >= 0) &&
+            (position.y >= 0) &&
+            (position.x <= columns - 1) &&
+            (position.y <= rows - 1);
+    }
+
+    int TileIndex(pos position) const {
+        if (layout == TileLayout::TILED) {
+            int block = (position.x >> TILE_BLOCK_SHIFT) | ((position.y >> TILE_BLOCK_SHIFT) << BlockRowShift());
+            return (block << (2 * TILE_BLOCK_SHIFT)) | 
+                SpreadBits(position.x & TILE_BLOCK_MASK) | 
+                (SpreadBits(position.y & TILE_BLOCK_MASK) << 1);
+        }
+
+        return position.x + position.y * columns;
+    }
+
+    pos PositionFromTileIndex(int tileIndex) const {
+        if (layout == TileLayout::TILED) {
+            int block = tileIndex >> (2 * TILE_BLOCK_SHIFT);
+            int inner = tileIndex & (TILE_BLOCK_SIDE * TILE_BLOCK_SIDE - 1);
+            int shift = BlockRowShift();
+            return pos{.x=((block & ((1 << shift) - 1)) << TILE_BLOCK_SHIFT) | CompactBits(inner),
+                       .y=((block >> shift) << TILE_BLOCK_SHIFT) | CompactBits(inner >> 1)};
+        }
+
+        return pos{.x=tileIndex % columns, .y=tileIndex / columns};
+    }
+
+    // position of a tile in reading order, independent of the layout
+    int RowMajorIndex(int tileIndex) const {
+        if (layout == TileLayout::TILED) {
+            pos position = PositionFromTileIndex(tileIndex);
+            return position.x + position.y * columns;
+        }
+
+        return tileIndex;
+    }
+
+    bool operator==(const BoardGeometry& other) const {
+        return columns == other.columns && rows == other.rows && layout == other.layout;
+    }
+
+    private:
+        // log2 of the blocks per row, rounded up
+        int BlockRowShift() const {
+            int blocks = (columns + TILE_BLOCK_MASK) >> TILE_BLOCK_SHIFT;
+            return blocks > 1 ? 32 - __builtin_clz(blocks - 1) : 0;
+        }
+
+        // abc -> a0b0c
+        static int SpreadBits(int value) {
+            static const unsigned char spread[TILE_BLOCK_SIDE] = {0, 1, 4, 5, 16, 17, 20, 21};
+            return spread[value];
+        }
+
+        // a0b0c -> abc
+        static int CompactBits(int value) {
+            return (value & 1) | ((value >> 1) & 2) | ((value >> 2) & 4);
+        }
+};
+
+// compile time sized board, index math folds to constants, the engine indexes through
+// ShippedBoard alone when built with PIPE_SHIPPED_BOARD
+template <int Columns, int Rows>
+struct Board {
+    static constexpr int columns = Columns;
+    static constexpr int rows = Rows;
+    static constexpr int tileCount = Columns * Rows;
+
+    static constexpr bool CheckBounds(pos position) {
+        return (position.x >= 0) &&
+            (position.y >= 0) &&
+            (position.x <= Columns - 1) &&
+            (position.y <= Rows - 1);
+    }
+
+    static constexpr int TileIndex(pos position) {
+        return position.x + position.y * Columns;
+    }
+
+    static constexpr pos PositionFromTileIndex(int tileIndex) {
+        return pos{.x=tileIndex % Columns, .y=tileIndex / Columns};
+    }
+
+    static constexpr BoardGeometry Geometry() {
+        return BoardGeometry{Columns, Rows};
+    }
+};
+
+using ShippedBoard = Board<TILES_COLUMNS, TILES_ROWS>;
+
+// largest supported side length of a runtime sized board
+#define MAX_BOARD_SIDE 4096
@@ -0,0 +1,530 @@
+#include "BoardBatch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <string.h>
+
+#ifdef PARALLEL_ASSEMBLIES
+#include <thread>
+#endif
+
+// the pivot's tile carries a bit no packed piece uses, as the solver marks it
+static const PackedTile PIVOT_MARK = 0x80;
+
+static pos adjacentPosition(pos position, Direction direction)
+{
+    static const int stepX[4] = {0, -1, 0, 1};
+    static const int stepY[4] = {-1, 0, 1, 0};
+    return pos{position.x + stepX[direction], position.y + stepY[direction]};
+}
+
+// The sweep overlay of a lane, as the engine's sweep helpers keep it. A piece is known
+// by the tile it started the turn on.
+static int laneOccupant(LaneRotation& rotation, int tileIndex)
+{
+    int occupant = rotation.sweep.tileOccupants[tileIndex];
+    if (occupant != SWEEP_UNTOUCHED)
+        return occupant;
+
+    return rotation.tiles[tileIndex] ? tileIndex : -1;
+}
+
+static int laneEntityTile(const LaneRotation& rotation, int index)
+{
+    int tileIndex = rotation.sweep.entityTiles[index];
+    return tileIndex < 0 ? index : tileIndex;
+}
+
+static void laneTouchTile(LaneRotation& rotation, int tileIndex)
+{
+    SweepScratch& sweep = rotation.sweep;
+    if (sweep.tileOccupants[tileIndex] == SWEEP_UNTOUCHED && !sweep.isTileSwept[tileIndex])
+        sweep.touchedTiles.push_back(tileIndex);
+}
+
+static void laneMove(LaneRotation& rotation, int index, int tileIndex)
+{
+    SweepScratch& sweep = rotation.sweep;
+    int fromTile = laneEntityTile(rotation, index);
+    laneTouchTile(rotation, fromTile);
+    sweep.tileOccupants[fromTile] = -1;
+
+    if (sweep.entityTiles[index] < 0 && !sweep.isEntityTemporarilyMovable[index])
+        sweep.touchedEntities.push_back(index);
+
+    laneTouchTile(rotation, tileIndex);
+    sweep.tileOccupants[tileIndex] = index;
+    sweep.entityTiles[index] = tileIndex;
+}
+
+BoardBatch::BoardBatch(BoardGeometry geometry, int laneCount) :
+    board(BoardGeometry{geometry.columns, geometry.rows}), laneCount(laneCount)
+{
+    blockCount = (laneCount + BATCH_BLOCK_LANES - 1) / BATCH_BLOCK_LANES;
+    planes.assign(static_cast<size_t>(blockCount) * board.TileCount() * BATCH_PLANE_COUNT, LaneBits::None());
+    activeLanes.assign(blockCount, LaneBits::None());
+    turnOkLanes.assign(blockCount, LaneBits::None());
+}
+
+bool BoardBatch::Load(int lane, const EntityManager& em)
+{
+    if (lane < 0 || lane >= laneCount || em.board.columns != board.columns || em.board.rows != board.rows)
+        return false;
+
+    for (int tileIndex = 0; tileIndex < board.TileCount(); tileIndex++) {
+        setTile(lane, tileIndex, 0);
+    }
+
+    for (int i = 0; i < static_cast<int>(em.numEntities); i++) {
+        pos position = em.positions[i];
+        setTile(lane, position.x + position.y * board.columns, PackTile(em.types[i], em.orientations[i], em.isMovable.Test(i)));
+    }
+
+    pos pivot;
+    if (em.getPivotPosition(em.assemblies[0], pivot)) {
+        int tileIndex = pivot.x + pivot.y * board.columns;
+        setTile(lane, tileIndex, Tile(lane, tileIndex) | PIVOT_MARK);
+    }
+
+    SetActive(lane, true);
+    return true;
+}
+
+void BoardBatch::Store(int lane, EntityManager& em) const
+{
+    if (em.board.columns != board.columns || em.board.rows != board.rows)
+        em.LoadBoard(board);
+    else
+        em.RemoveAllEntities();
+
+    Assembly& assembly = em.assemblies[0];
+    for (int tileIndex = 0; tileIndex < board.TileCount(); tileIndex++) {
+        PackedTile packed = Tile(lane, tileIndex);
+        if (!packed)
+            continue;
+
+        pos position = pos{tileIndex % board.columns, tileIndex / board.columns};
+        em.placeEntity(em.getTileIndexFromPosition(position), position, PackedType(packed),
+                       PackedOrientation(packed), IsPackedMovable(packed), assembly);
+    }
+    em.refreshEntityLinks();
+
+    int pivot = PivotTile(lane);
+    if (pivot >= 0)
+        em.assemblies[0].pivot = em.ids[em.getEntityIndexFromPosition(pos{pivot % board.columns, pivot / board.columns})];
+}
+
+PackedTile BoardBatch::Tile(int lane, int tileIndex) const
+{
+    const LaneBits* tile = tilePlanes(lane / BATCH_BLOCK_LANES, tileIndex);
+    int bit = lane % BATCH_BLOCK_LANES;
+
+    PackedTile packed = 0;
+    for (int plane = TYPE_PLANE; plane < PIVOT_PLANE; plane++) {
+        packed |= tile[plane].Test(bit) << plane;
+    }
+    return packed;
+}
+
+int BoardBatch::PivotTile(int lane) const
+{
+    for (int tileIndex = 0; tileIndex < board.TileCount(); tileIndex++) {
+        if (tilePlanes(lane / BATCH_BLOCK_LANES, tileIndex)[PIVOT_PLANE].Test(lane % BATCH_BLOCK_LANES))
+            return tileIndex;
+    }
+    return -1;
+}
+
+uint64_t BoardBatch::Hash(int lane) const
+{
+    uint64_t hash = ZobristBoardKey(board);
+    for (int tileIndex = 0; tileIndex < board.TileCount(); tileIndex++) {
+        PackedTile packed = Tile(lane, tileIndex);
+        if (packed)
+            hash ^= ZobristPieceKey(pos{tileIndex % board.columns, tileIndex / board.columns}, packed);
+    }
+    return hash;
+}
+
+void BoardBatch::SetActive(int lane, bool isActive)
+{
+    activeLanes[lane / BATCH_BLOCK_LANES].Assign(lane % BATCH_BLOCK_LANES, isActive);
+}
+
+bool BoardBatch::IsActive(int lane) const
+{
+    return activeLanes[lane / BATCH_BLOCK_LANES].Test(lane % BATCH_BLOCK_LANES);
+}
+
+bool BoardBatch::IsTurnOk(int lane) const
+{
+    return turnOkLanes[lane / BATCH_BLOCK_LANES].Test(lane % BATCH_BLOCK_LANES);
+}
+
+void BoardBatch::MoveAllToAdjacent(Direction direction)
+{
+    forEachBlock([&](int block, int) { translateBlock(block, direction); });
+}
+
+void BoardBatch::RotateAll(Direction direction)
+{
+    rotations.resize(std::max(workerCount, 1));
+    forEachBlock([&](int block, int worker) { rotateBlock(block, rotations[worker], direction); });
+}
+
+void BoardBatch::setTile(int lane, int tileIndex, PackedTile packed)
+{
+    LaneBits* tile = tilePlanes(lane / BATCH_BLOCK_LANES, tileIndex);
+    int bit = lane % BATCH_BLOCK_LANES;
+    PortMask ports = PackedType(packed) == EntityType::BACKGROUND ? 0 : PortsOf(PackedType(packed), PackedOrientation(packed));
+
+    for (int plane = TYPE_PLANE; plane <= PIVOT_PLANE; plane++) {
+        tile[plane].Assign(bit, (packed >> plane) & 1);
+    }
+    for (int d = 0; d < 4; d++) {
+        tile[PORT_PLANE + d].Assign(bit, (ports >> d) & 1);
+    }
+}
+
+template<typename Work>
+void BoardBatch::forEachBlock(Work work)
+{
+    std::atomic<int> next(0);
+    auto run = [&](int worker) {
+        for (int block = next++; block < blockCount; block = next++) {
+            work(block, worker);
+        }
+    };
+
+#ifdef PARALLEL_ASSEMBLIES
+    int threadCount = laneCount >= parallelMinimumLanes ? std::min(workerCount, blockCount) : 1;
+    std::vector<std::thread> threads;
+    for (int worker = 1; worker < threadCount; worker++) {
+        threads.emplace_back(run, worker);
+    }
+
+    run(0);
+
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+#else
+    run(0);
+#endif
+}
+
+void BoardBatch::translateBlock(int block, Direction direction)
+{
+    // ResolvePushChains line by line: a run of pieces moves from its rearmost movable
+    // piece on, and a lane is blocked when such a run reaches the edge. Lines are walked
+    // from the back, the first walk finds the blocked lanes, the second shifts the rest.
+    int columns = board.columns;
+    int rows = board.rows;
+    bool isAlongRows = direction == LEFT || direction == RIGHT;
+    int lineCount = isAlongRows ? rows : columns;
+    int lineLength = isAlongRows ? columns : rows;
+    int lineStride = isAlongRows ? columns : 1;
+    int step = direction == RIGHT ? 1 : direction == LEFT ? -1 : direction == DOWN ? columns : -columns;
+    int first = direction == LEFT ? columns - 1 : direction == UP ? (rows - 1) * columns : 0;
+
+    LaneBits blocked = LaneBits::None();
+    for (int line = 0; line < lineCount; line++) {
+        LaneBits moving = LaneBits::None();
+        for (int k = 0; k < lineLength; k++) {
+            const LaneBits* tile = tilePlanes(block, first + line * lineStride + k * step);
+            LaneBits occupied = tile[TYPE_PLANE] | tile[TYPE_PLANE + 1] | tile[TYPE_PLANE + 2] | tile[TYPE_PLANE + 3];
+            moving = occupied & (moving | tile[MOVABLE_PLANE]);
+        }
+        blocked = blocked | moving;
+    }
+
+    LaneBits lanes = activeLanes[block] & ~blocked;
+    turnOkLanes[block] = lanes;
+    if (!lanes.Any())
+        return;
+
+    // a tile takes the piece behind it when that one moves, and empties when its own moves
+    LaneBits behind[BATCH_PLANE_COUNT];
+    std::fill(behind, behind + BATCH_PLANE_COUNT, LaneBits::None());
+    for (int line = 0; line < lineCount; line++) {
+        LaneBits movingBehind = LaneBits::None();
+        for (int k = 0; k < lineLength; k++) {
+            LaneBits* tile = tilePlanes(block, first + line * lineStride + k * step);
+            LaneBits occupied = tile[TYPE_PLANE] | tile[TYPE_PLANE + 1] | tile[TYPE_PLANE + 2] | tile[TYPE_PLANE + 3];
+            LaneBits moving = occupied & (movingBehind | (tile[MOVABLE_PLANE] & lanes));
+            LaneBits stays = ~(movingBehind | moving);
+
+            for (int plane = 0; plane < BATCH_PLANE_COUNT; plane++) {
+                LaneBits current = tile[plane];
+                tile[plane] = (movingBehind & behind[plane]) | (stays & current);
+                behind[plane] = current;
+            }
+            movingBehind = moving;
+        }
+    }
+
+    attachConnected(block, lanes);
+}
+
+// The word's 64 lanes as boards side by side, a byte per lane and tile. Each plane is
+// spread eight lanes at a time, bytes laid out in memory order whatever the endianness.
+void BoardBatch::transposeWord(int block, int word, LaneRotation& rotation) const
+{
+    static const std::vector<uint64_t> byteSpreads = [] {
+        std::vector<uint64_t> spreads(256);
+        for (int bits = 0; bits < 256; bits++) {
+            uint8_t bytes[8];
+            for (int k = 0; k < 8; k++) {
+                bytes[k] = (bits >> k) & 1;
+            }
+            memcpy(&spreads[bits], bytes, sizeof(bytes));
+        }
+        return spreads;
+    }();
+
+    int tileCount = board.TileCount();
+    rotation.wordTiles.resize(tileCount * 64);
+    for (int tileIndex = 0; tileIndex < tileCount; tileIndex++) {
+        const LaneBits* tile = tilePlanes(block, tileIndex);
+        uint64_t spread[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+        for (int plane = TYPE_PLANE; plane <= PIVOT_PLANE; plane++) {
+            uint64_t bits = tile[plane].words[word];
+            if (bits == 0)
+                continue;
+
+            for (int group = 0; group < 8; group++) {
+                spread[group] |= byteSpreads[(bits >> (group * 8)) & 0xFF] << plane;
+            }
+        }
+        memcpy(&rotation.wordTiles[tileIndex * 64], spread, sizeof(spread));
+    }
+}
+
+void BoardBatch::rotateBlock(int block, LaneRotation& rotation, Direction direction)
+{
+    int tileCount = board.TileCount();
+    rotation.tiles.resize(tileCount);
+    if (rotation.sweep.tileOccupants.size() != static_cast<size_t>(tileCount))
+        rotation.sweep.Resize(tileCount, tileCount);
+
+    LaneBits active = activeLanes[block];
+    LaneBits lanes = LaneBits::None();
+
+    for (int word = 0; word < BATCH_BLOCK_WORDS; word++) {
+        if (active.words[word] == 0)
+            continue;
+
+        transposeWord(block, word, rotation);
+        for (int shift = 0; shift < 64; shift++) {
+            if (!((active.words[word] >> shift) & 1))
+                continue;
+
+            // the lane's board without its pivot mark
+            int pivotTile = -1;
+            for (int tileIndex = 0; tileIndex < tileCount; tileIndex++) {
+                PackedTile packed = rotation.wordTiles[tileIndex * 64 + shift];
+                if (packed & PIVOT_MARK)
+                    pivotTile = tileIndex;
+                rotation.tiles[tileIndex] = packed & ~PIVOT_MARK;
+            }
+
+            if (pivotTile >= 0 && !resolveRotation(rotation, pivotTile, direction))
+                continue;
+
+            int bit = word * 64 + shift;
+            lanes.Assign(bit, true);
+            if (pivotTile < 0)
+                continue;
+
+            // the pivot turns in place and keeps its mark
+            for (int tileIndex : rotation.writtenTiles) {
+                setTile(block * BATCH_BLOCK_LANES + bit, tileIndex,
+                        rotation.turned[tileIndex] | (tileIndex == pivotTile ? PIVOT_MARK : 0));
+            }
+        }
+    }
+
+    turnOkLanes[block] = lanes;
+    attachConnected(block, lanes);
+}
+
+bool BoardBatch::resolveRotation(LaneRotation& rotation, int pivotTile, Direction direction) const
+{
+    // SweepRotation, ApplySweptPushes and RotateMovables on one lane's tiles. Members
+    // stream their trajectories in reading order, which breaks ties between equal angles.
+    const std::vector<PackedTile>& tiles = rotation.tiles;
+    SweepScratch& sweep = rotation.sweep;
+    int columns = board.columns;
+    pos pivot = pos{pivotTile % columns, pivotTile / columns};
+
+    rotation.events.Clear();
+    for (int tileIndex = 0; tileIndex < board.TileCount(); tileIndex++) {
+        if (!IsPackedMovable(tiles[tileIndex]) || tileIndex == pivotTile)
+            continue;
+
+        pos offset = pos{tileIndex % columns - pivot.x, tileIndex / columns - pivot.y};
+        TrajectorySpan span;
+        if (!rotation.trajectories.Find(offset, direction, span))
+            span = rotation.trajectories.Insert(offset, direction, EntityManager::ComputeRelativeTrajectory(offset, direction));
+        rotation.events.AddStream(span);
+    }
+    rotation.events.Start(rotation.trajectories.Data(), pivot);
+
+    sweep.Reset();
+    Push push;
+    while (rotation.events.Next(push)) {
+        pos position = adjacentPosition(pos{static_cast<int>(push.fromPosition.x), static_cast<int>(push.fromPosition.y)},
+                                        push.direction);
+        if (!board.CheckBounds(position))
+            return false;
+
+        int tileIndex = position.x + position.y * columns;
+        if (!sweep.isTileSwept[tileIndex]) {
+            laneTouchTile(rotation, tileIndex);
+            sweep.isTileSwept[tileIndex] = true;
+        }
+
+        int occupant = laneOccupant(rotation, tileIndex);
+        if (occupant >= 0 && !IsPackedMovable(tiles[occupant]) && !pushChain(rotation, occupant, push.direction))
+            return false;
+
+        occupant = laneOccupant(rotation, tileIndex);
+        if (occupant >= 0 && !IsPackedMovable(tiles[occupant]) && !sweep.isEntityTemporarilyMovable[occupant])
+            return false;
+    }
+
+    // pushed pieces land first, then every turning piece is lifted and put down a quarter
+    // turn on, a destination that is not free then holds a piece that stays
+    std::vector<PackedTile>& turned = rotation.turned;
+    std::vector<int>& rotating = rotation.rotating;
+    turned = tiles;
+    rotation.writtenTiles.clear();
+    rotating.clear();
+
+    for (int index : sweep.touchedEntities) {
+        turned[index] = 0;
+        rotation.writtenTiles.push_back(index);
+    }
+
+    for (int index : sweep.touchedEntities) {
+        int tileIndex = laneEntityTile(rotation, index);
+        turned[tileIndex] = tiles[index];
+        rotation.writtenTiles.push_back(tileIndex);
+        if (sweep.isEntityTemporarilyMovable[index])
+            rotating.push_back(tileIndex);
+    }
+
+    for (int tileIndex = 0; tileIndex < board.TileCount(); tileIndex++) {
+        if (IsPackedMovable(tiles[tileIndex]))
+            rotating.push_back(tileIndex);
+    }
+
+    rotation.pieces.clear();
+    for (int tileIndex : rotating) {
+        rotation.pieces.push_back(turned[tileIndex]);
+        turned[tileIndex] = 0;
+        rotation.writtenTiles.push_back(tileIndex);
+    }
+
+    int sign = direction - 2;
+    for (size_t k = 0; k < rotating.size(); k++) {
+        int deltaX = rotating[k] % columns - pivot.x;
+        int deltaY = rotating[k] / columns - pivot.y;
+        pos position = pos{pivot.x - sign * deltaY, pivot.y + sign * deltaX};
+        if (!board.CheckBounds(position))
+            return false;
+
+        int tileIndex = position.x + position.y * columns;
+        if (turned[tileIndex])
+            return false;
+
+        PackedTile piece = rotation.pieces[k];
+        turned[tileIndex] = PackTile(PackedType(piece), static_cast<Direction>((PackedOrientation(piece) + direction) % 4),
+                                     IsPackedMovable(piece));
+        rotation.writtenTiles.push_back(tileIndex);
+    }
+
+    return true;
+}
+
+bool BoardBatch::pushChain(LaneRotation& rotation, int index, Direction direction) const
+{
+    // sweepPushChain on the lane's overlay
+    SweepScratch& sweep = rotation.sweep;
+    sweep.chain.clear();
+    int current = index;
+
+    while (true) {
+        sweep.chain.push_back(current);
+
+        int tileIndex = laneEntityTile(rotation, current);
+        pos position = adjacentPosition(pos{tileIndex % board.columns, tileIndex / board.columns}, direction);
+        if (!board.CheckBounds(position))
+            return false;
+
+        int next = laneOccupant(rotation, position.x + position.y * board.columns);
+        if (next < 0)
+            break;
+
+        if (IsPackedMovable(rotation.tiles[next])) {
+            if (sweep.entityTiles[current] < 0 && !sweep.isEntityTemporarilyMovable[current])
+                sweep.touchedEntities.push_back(current);
+            sweep.isEntityTemporarilyMovable[current] = true;
+            return true;
+        }
+
+        current = next;
+    }
+
+    for (auto it = sweep.chain.rbegin(); it != sweep.chain.rend(); ++it) {
+        int tileIndex = laneEntityTile(rotation, *it);
+        pos position = adjacentPosition(pos{tileIndex % board.columns, tileIndex / board.columns}, direction);
+        laneMove(rotation, *it, position.x + position.y * board.columns);
+    }
+
+    return true;
+}
+
+void BoardBatch::attachConnected(int block, const LaneBits& lanes)
+{
+    // AttachConnected in every lane at once: a piece linked to a movable one becomes
+    // movable. Sweeps forward and back over the board until a pair of them adds nothing.
+    if (!lanes.Any())
+        return;
+
+    int columns = board.columns;
+    int rows = board.rows;
+    LaneBits gained;
+
+    auto visit = [&](int x, int y) {
+        LaneBits* tile = tilePlanes(block, x + y * columns);
+        LaneBits linked = LaneBits::None();
+
+        for (int d = 0; d < 4; d++) {
+            pos neighbor = adjacentPosition(pos{x, y}, static_cast<Direction>(d));
+            if (!board.CheckBounds(neighbor))
+                continue;
+
+            const LaneBits* adjacent = tilePlanes(block, neighbor.x + neighbor.y * columns);
+            linked = linked | (tile[PORT_PLANE + d] & adjacent[PORT_PLANE + (d + 2) % 4] & adjacent[MOVABLE_PLANE]);
+        }
+
+        LaneBits gain = linked & lanes & ~tile[MOVABLE_PLANE];
+        tile[MOVABLE_PLANE] = tile[MOVABLE_PLANE] | gain;
+        gained = gained | gain;
+    };
+
+    do {
+        gained = LaneBits::None();
+        for (int y = 0; y < rows; y++) {
+            for (int x = 0; x < columns; x++) {
+                visit(x, y);
+            }
+        }
+        for (int y = rows - 1; y >= 0; y--) {
+            for (int x = columns - 1; x >= 0; x--) {
+                visit(x, y);
+            }
+        }
+    } while (gained.Any());
+}
@@ -0,0 +1,161 @@
+#pragma once
+
+#include "SimulationTypes.h"
+#include "EntityManager.h"
+#include "TrajectoryCache.h"
+#include "TrajectoryMerge.h"
+#include "CollisionSweep.h"
+
+#include <stdint.h>
+#include <vector>
+
+// Lanes are worked on a block at a time, the words of a block as one vector, which is
+// one AVX2 register, two SSE or SIMD128 ones. A plain array of words left the compiler
+// to pick a width per loop, and AVX2 builds moved at a third of the speed.
+static const int BATCH_BLOCK_WORDS = 4;
+static const int BATCH_BLOCK_LANES = 64 * BATCH_BLOCK_WORDS;
+
+typedef uint64_t LaneWords __attribute__((vector_size(8 * BATCH_BLOCK_WORDS)));
+
+// one bit per lane of a block
+struct LaneBits {
+    LaneWords words;
+
+    static LaneBits None() {
+        LaneBits bits;
+        bits.words = LaneWords{};
+        return bits;
+    }
+
+    bool Test(int lane) const {
+        return (words[lane >> 6] >> (lane & 63)) & 1;
+    }
+
+    void Assign(int lane, bool value) {
+        uint64_t bit = uint64_t(1) << (lane & 63);
+        words[lane >> 6] = value ? words[lane >> 6] | bit : words[lane >> 6] & ~bit;
+    }
+
+    bool Any() const {
+        uint64_t any = 0;
+        for (int k = 0; k < BATCH_BLOCK_WORDS; k++) {
+            any |= words[k];
+        }
+        return any != 0;
+    }
+};
+
+inline LaneBits operator&(LaneBits a, const LaneBits& b)
+{
+    a.words &= b.words;
+    return a;
+}
+
+inline LaneBits operator|(LaneBits a, const LaneBits& b)
+{
+    a.words |= b.words;
+    return a;
+}
+
+inline LaneBits operator~(LaneBits a)
+{
+    a.words = ~a.words;
+    return a;
+}
+
+// What a tile holds in a lane, one word of lane bits each. The first eight are the bits of
+// the packed piece and the pivot mark, the last four the piece's openings.
+enum BatchPlane {
+    TYPE_PLANE = 0,
+    ORIENTATION_PLANE = 4,
+    MOVABLE_PLANE = 6,
+    PIVOT_PLANE = 7,
+    PORT_PLANE = 8,
+    BATCH_PLANE_COUNT = 12
+};
+
+// a lane's board while a rotation is resolved, one per worker
+struct LaneRotation {
+    std::vector<PackedTile> wordTiles;
+    std::vector<PackedTile> tiles;
+    std::vector<PackedTile> turned;
+    std::vector<int> rotating;
+    std::vector<PackedTile> pieces;
+    std::vector<int> writtenTiles;
+    TrajectoryMerge events;
+    SweepScratch sweep;
+    // filled on a miss with the offsets this worker's lanes meet, as the engine fills its own
+    TrajectoryCache trajectories;
+};
+
+// Many boards of one size played in lockstep, for level search and playtesting that make
+// the same move on every board. Boards are bit sliced, a lane is one bit of every word, so
+// a translation and the pieces it attaches are worked out with word operations for a
+// block of lanes at once. A rotation sweeps in angle order about each lane's own pivot,
+// so it is resolved lane by lane and written back, the attaching after it is again done
+// for the block. A lane whose turn is blocked keeps its board, as AbortTurn does. Only the
+// player's assembly is kept, as in BoardSnapshot, and pieces tie in reading order where
+// the engine ties them in entity order.
+class BoardBatch {
+    BoardGeometry board;
+    int laneCount;
+    int blockCount;
+
+    // block by block, then tile by tile in reading order, then plane by plane
+    std::vector<LaneBits> planes;
+    std::vector<LaneBits> activeLanes;
+    std::vector<LaneBits> turnOkLanes;
+
+    std::vector<LaneRotation> rotations;
+
+    LaneBits* tilePlanes(int block, int tileIndex) {
+        return &planes[(static_cast<size_t>(block) * board.TileCount() + tileIndex) * BATCH_PLANE_COUNT];
+    }
+    const LaneBits* tilePlanes(int block, int tileIndex) const {
+        return &planes[(static_cast<size_t>(block) * board.TileCount() + tileIndex) * BATCH_PLANE_COUNT];
+    }
+
+    void setTile(int lane, int tileIndex, PackedTile packed);
+    template<typename Work> void forEachBlock(Work work);
+    void translateBlock(int block, Direction direction);
+    void transposeWord(int block, int word, LaneRotation& rotation) const;
+    void rotateBlock(int block, LaneRotation& rotation, Direction direction);
+    bool resolveRotation(LaneRotation& rotation, int pivotTile, Direction direction) const;
+    bool pushChain(LaneRotation& rotation, int index, Direction direction) const;
+    void attachConnected(int block, const LaneBits& lanes);
+
+    public:
+        // lanes are inactive and empty until loaded
+        BoardBatch(BoardGeometry geometry, int laneCount);
+
+        // turns are resolved a block at a time on up to workerCount threads, once there
+        // are at least parallelMinimumLanes lanes, one by default as in the engine
+        int workerCount = 1;
+        int parallelMinimumLanes = 1024;
+
+        BoardGeometry Geometry() const { return board; }
+        int LaneCount() const { return laneCount; }
+
+        // the engine's board into a lane, which becomes active, false when its size differs
+        bool Load(int lane, const EntityManager& em);
+        // replaces the engine's pieces with the lane's, entity indices follow reading order
+        void Store(int lane, EntityManager& em) const;
+
+        PackedTile Tile(int lane, int tileIndex) const;
+        // tile in reading order, -1 without one
+        int PivotTile(int lane) const;
+        // EntityManager::hash of the lane's board
+        uint64_t Hash(int lane) const;
+
+        // inactive lanes sit out turns
+        void SetActive(int lane, bool isActive);
+        bool IsActive(int lane) const;
+        // the lane was active and its part of the last turn went through
+        bool IsTurnOk(int lane) const;
+
+        void MoveAllToAdjacent(Direction direction);
+        // Not vectorized: every active lane is unpacked from its block, resolved on its
+        // own by the engine's sweep and written back, so its cost grows with the lanes
+        // rather than the blocks. Only the attaching after it works on whole blocks.
+        void RotateAll(Direction direction);
+};
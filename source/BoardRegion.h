@@ -0,0 +1,39 @@
+#pragma once
+
+#include "SimulationTypes.h"
+
+// one tile of a paged region in a byte: type in the low four bits, then the orientation
+// and whether the piece is movable, an empty tile packs to BACKGROUND
+typedef unsigned char PackedTile;
+
+static_assert(ENTITY_TYPE_COUNT <= 16, "piece types are packed into four bits");
+
+constexpr PackedTile PackTile(EntityType type, Direction orientation, bool isMovable)
+{
+    return static_cast<PackedTile>(static_cast<int>(type) | (orientation << 4) | (isMovable << 6));
+}
+
+inline EntityType PackedType(PackedTile tile)
+{
+    return static_cast<EntityType>(tile & 0xF);
+}
+
+inline Direction PackedOrientation(PackedTile tile)
+{
+    return static_cast<Direction>((tile >> 4) & 3);
+}
+
+inline bool IsPackedMovable(PackedTile tile)
+{
+    return (tile >> 6) & 1;
+}
+
+// a rectangle of tiles, its packed span holds columns * rows tiles in reading order
+// whatever the board's tile layout, tiles off the board are skipped
+struct BoardRegion {
+    pos low;
+    int columns;
+    int rows;
+
+    int TileCount() const { return columns * rows; }
+};
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "SimulationTypes.h"
+#include "BoardRegion.h"
+#include "EntityManager.h"
+#include "Zobrist.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <type_traits>
+
+// A board of a fixed size as a plain value: every tile's packed piece in seven bits, nine
+// tiles to a word in reading order, and the pivot of the player's assembly. Copies are
+// memory copies and its hash is the board hash the engine keeps, so a search or an undo
+// buffer can hold a board in a few hundred bytes. Only the player's assembly is kept,
+// other assemblies come back as part of it.
+template<int Columns, int Rows>
+struct BoardSnapshot {
+    static constexpr int TILE_COUNT = Columns * Rows;
+    static constexpr int TILE_BITS = 7;
+    static constexpr int TILES_PER_WORD = 64 / TILE_BITS;
+    static constexpr int WORD_COUNT = (TILE_COUNT + TILES_PER_WORD - 1) / TILES_PER_WORD;
+
+    uint64_t words[WORD_COUNT];
+    int32_t pivot;   // tile in reading order, -1 without one
+
+    static BoardGeometry Geometry() { return BoardGeometry{Columns, Rows}; }
+
+    PackedTile Tile(int tile) const {
+        return (words[tile / TILES_PER_WORD] >> (tile % TILES_PER_WORD * TILE_BITS)) & 0x7F;
+    }
+
+    void SetTile(int tile, PackedTile packed) {
+        int shift = tile % TILES_PER_WORD * TILE_BITS;
+        uint64_t& word = words[tile / TILES_PER_WORD];
+        word = (word & ~(uint64_t(0x7F) << shift)) | (uint64_t(packed & 0x7F) << shift);
+    }
+
+    void Clear() {
+        memset(words, 0, sizeof(words));
+        pivot = -1;
+    }
+
+    // false when the engine's board is of another size, the snapshot is then empty
+    bool Capture(const EntityManager& em) {
+        Clear();
+        if (em.board.columns != Columns || em.board.rows != Rows)
+            return false;
+
+        for (int i = 0; i < static_cast<int>(em.numEntities); i++) {
+            pos position = em.positions[i];
+            SetTile(position.x + position.y * Columns, PackTile(em.types[i], em.orientations[i], em.isMovable.Test(i)));
+        }
+
+        pos pivotPosition;
+        if (em.getPivotPosition(em.assemblies[0], pivotPosition))
+            pivot = pivotPosition.x + pivotPosition.y * Columns;
+        return true;
+    }
+
+    // replaces the engine's pieces with the snapshot's, entity indices follow reading
+    // order. Pieces go straight into the engine's arrays and only their tiles are linked
+    // and marked for the flow, so a restore costs time in the pieces, not the tiles.
+    void Restore(EntityManager& em) const {
+        if (em.board.columns != Columns || em.board.rows != Rows)
+            em.LoadBoard(Geometry());
+        else
+            em.RemoveAllEntities();
+
+        Assembly& assembly = em.assemblies[0];
+        for (int w = 0; w < WORD_COUNT; w++) {
+            // empty tiles are skipped by the lowest set bit of what is left of the word
+            for (uint64_t word = words[w]; word; ) {
+                int slot = __builtin_ctzll(word) / TILE_BITS;
+                PackedTile packed = (word >> (slot * TILE_BITS)) & 0x7F;
+                word &= ~(uint64_t(0x7F) << (slot * TILE_BITS));
+
+                int tile = w * TILES_PER_WORD + slot;
+                pos position = pos{tile % Columns, tile / Columns};
+                em.placeEntity(em.getTileIndexFromPosition(position), position, PackedType(packed),
+                               PackedOrientation(packed), IsPackedMovable(packed), assembly);
+            }
+        }
+        em.refreshEntityLinks();
+
+        if (pivot >= 0)
+            assembly.pivot = em.ids[em.getEntityIndexFromPosition(pos{pivot % Columns, pivot / Columns})];
+    }
+
+    // EntityManager::hash of the board the snapshot was taken from
+    uint64_t Hash() const {
+        uint64_t hash = ZobristBoardKey(Geometry());
+        for (int w = 0; w < WORD_COUNT; w++) {
+            for (uint64_t word = words[w], tile = w * TILES_PER_WORD; word; word >>= TILE_BITS, tile++) {
+                PackedTile packed = word & 0x7F;
+                if (packed)
+                    hash ^= ZobristPieceKey(pos{static_cast<int>(tile % Columns), static_cast<int>(tile / Columns)}, packed);
+            }
+        }
+        return hash;
+    }
+
+    bool operator==(const BoardSnapshot& other) const {
+        return pivot == other.pivot && memcmp(words, other.words, sizeof(words)) == 0;
+    }
+
+    bool operator!=(const BoardSnapshot& other) const { return !(*this == other); }
+};
+
+// for unordered containers of snapshots
+template<int Columns, int Rows>
+struct BoardSnapshotHash {
+    size_t operator()(const BoardSnapshot<Columns, Rows>& snapshot) const { return snapshot.Hash(); }
+};
+
+static_assert(PackTile(EntityType::BACKGROUND, UP, false) == 0, "an empty tile packs to zero");
+static_assert(std::is_trivially_copyable<BoardSnapshot<TILES_COLUMNS, TILES_ROWS>>::value, "snapshots copy as memory");
@@ -0,0 +1,97 @@
+#include "BoardText.h"
+
+#include <ctype.h>
+#include <string.h>
+#include <vector>
+
+static const char pieceLetters[ENTITY_TYPE_COUNT + 1] = "?pbsxoktc";
+static const char facingLetters[5] = "^<v>";
+
+bool ParseBoardText(const std::string& text, EntityManager& em, std::string& error)
+{
+    std::vector<std::string> lines;
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t end = text.find('\n', start);
+        if (end == std::string::npos)
+            end = text.size();
+
+        std::string line = text.substr(start, end - start);
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        if (!line.empty() && line[0] != '#')
+            lines.push_back(line);
+        start = end + 1;
+    }
+
+    if (lines.empty()) {
+        error = "the board has no rows";
+        return false;
+    }
+
+    if (lines[0].size() < 2 || lines[0].size() % 2) {
+        error = "every tile takes two characters";
+        return false;
+    }
+
+    int columns = lines[0].size() / 2;
+    int rows = lines.size();
+    for (int y = 0; y < rows; y++) {
+        if (lines[y].size() != lines[0].size()) {
+            error = "row " + std::to_string(y + 1) + " is not as long as the first";
+            return false;
+        }
+    }
+
+    if (columns > MAX_BOARD_SIDE || rows > MAX_BOARD_SIDE) {
+        error = "a board side is longer than " + std::to_string(MAX_BOARD_SIDE);
+        return false;
+    }
+
+    em.LoadBoard(BoardGeometry{columns, rows});
+
+    for (int y = 0; y < rows; y++) {
+        for (int x = 0; x < columns; x++) {
+            char piece = lines[y][2 * x];
+            char facing = lines[y][2 * x + 1];
+            if (piece == '.' && facing == '.')
+                continue;
+
+            const char* type = piece ? strchr(pieceLetters + 1, tolower(piece)) : nullptr;
+            const char* orientation = facing ? strchr(facingLetters, facing) : nullptr;
+            if (!type || !orientation) {
+                error = "unknown tile '" + std::string(1, piece) + std::string(1, facing) + "' in row " +
+                        std::to_string(y + 1) + ", column " + std::to_string(x + 1);
+                return false;
+            }
+
+            em.AddEntity(static_cast<EntityType>(type - pieceLetters), pos{x, y}, isupper(piece),
+                         static_cast<Direction>(orientation - facingLetters));
+        }
+    }
+
+    return true;
+}
+
+std::string FormatBoardText(const EntityManager& em)
+{
+    std::string text;
+    text.reserve((2 * em.board.columns + 1) * em.board.rows);
+
+    for (int y = 0; y < em.board.rows; y++) {
+        for (int x = 0; x < em.board.columns; x++) {
+            int index = em.getEntityIndexFromPosition(pos{x, y});
+            if (!em.doesEntityExist(index)) {
+                text += "..";
+                continue;
+            }
+
+            char piece = pieceLetters[static_cast<int>(em.types[index])];
+            text += em.isMovable.Test(index) ? static_cast<char>(toupper(piece)) : piece;
+            text += facingLetters[em.orientations[index]];
+        }
+        text += '\n';
+    }
+
+    return text;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "SimulationTypes.h"
+#include "EntityManager.h"
+
+#include <string>
+
+// Boards as plain text for native tools. A line is a row and every tile two characters,
+// the piece and the way it faces, lines starting with # are skipped:
+//     ..               empty
+//     p b s x o k t c  player, bent pipe, straight pipe, box, source, sink, tee and cross pipe,
+//                      upper case when the piece is movable
+//     ^ < v >          facing up, left, down or right
+// Movable pieces join the player's assembly, the first one in reading order is its pivot.
+bool ParseBoardText(const std::string& text, EntityManager& em, std::string& error);
+std::string FormatBoardText(const EntityManager& em);
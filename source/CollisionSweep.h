@@ -0,0 +1,68 @@
+#pragma once
+
+#include "SimulationTypes.h"
+
+#include <vector>
+
+#define SWEEP_UNTOUCHED -2
+#define SWEEP_NEVER 0xFFFFFFFFu
+
+struct SweptTile {
+    int tileIndex;
+    BinaryAngle angle;
+};
+
+struct SweptEntity {
+    int entityIndex;
+    int tileIndex;
+    bool isTemporarilyMovable;
+};
+
+// outcome of sweeping a rotation over the board, the board itself is left untouched
+struct CollisionResult {
+    bool canComplete;
+    BinaryAngle maximumAngle;
+    // the earliest angle each tile is swept at, in no particular order
+    std::vector<SweptTile> sweptTiles;
+    std::vector<SweptEntity> pushedEntities;
+};
+
+// scratch overlay of the board used while sweeping, reset in O(touched)
+struct SweepScratch {
+    std::vector<int> tileOccupants;
+    std::vector<char> isTileSwept;
+    std::vector<int> entityTiles;
+    std::vector<char> isEntityTemporarilyMovable;
+    std::vector<int> touchedTiles;
+    std::vector<int> touchedEntities;
+    std::vector<int> chain;
+    // tiles whose occupant was read from the board rather than the overlay
+    std::vector<int> boardReads;
+    // earliest angle of every tile while the swept tiles are gathered, SWEEP_NEVER elsewhere
+    std::vector<BinaryAngle> sweptAngles;
+
+    void Resize(int tileCount, int entityCount) {
+        tileOccupants.assign(tileCount, SWEEP_UNTOUCHED);
+        isTileSwept.assign(tileCount, false);
+        sweptAngles.assign(tileCount, SWEEP_NEVER);
+        entityTiles.assign(entityCount, -1);
+        isEntityTemporarilyMovable.assign(entityCount, false);
+        touchedTiles.clear();
+        touchedEntities.clear();
+        boardReads.clear();
+    }
+
+    void Reset() {
+        for (int tileIndex : touchedTiles) {
+            tileOccupants[tileIndex] = SWEEP_UNTOUCHED;
+            isTileSwept[tileIndex] = false;
+        }
+        for (int entityIndex : touchedEntities) {
+            entityTiles[entityIndex] = -1;
+            isEntityTemporarilyMovable[entityIndex] = false;
+        }
+        touchedTiles.clear();
+        touchedEntities.clear();
+        boardReads.clear();
+    }
+};
@@ -0,0 +1,11 @@
+#pragma once
+
+// slot into the sparse id table, generation guards against reuse after delete
+struct EntityHandle {
+    unsigned int slot;
+    unsigned int generation;
+
+    bool operator==(const EntityHandle& other) const {
+        return slot == other.slot && generation == other.generation;
+    }
+};
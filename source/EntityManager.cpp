@@ -1,75 +1,169 @@
 #include "EntityManager.h"
 
-EntityManager::EntityManager() {
-    numEntities = 0;
-    maxNumEntities = NUMBER_OF_TILES;
+#include <algorithm>
+#include <functional>
+
+#ifdef PIPE_VERIFY_HASH
+#include <cstdio>
+#include <cstdlib>
+#endif
+
+#ifdef PARALLEL_ASSEMBLIES
+#include <atomic>
+#include <thread>
+#endif
+
+EntityManager::EntityManager() : EntityManager(ShippedBoard::Geometry()) {}
+
+EntityManager::EntityManager(BoardGeometry geometry) {
+    LoadBoard(geometry);
     Initialize();
 }
 
-void EntityManager::Initialize() 
+void EntityManager::LoadBoard(BoardGeometry geometry) 
 {
-    std::fill(tileToEntityMapping, tileToEntityMapping+NUMBER_OF_TILES, -1);
+#ifdef PIPE_SHIPPED_BOARD
+    // other sizes need a build without PIPE_SHIPPED_BOARD
+    geometry = ShippedBoard::Geometry();
+#else
+    isShippedBoard = geometry == ShippedBoard::Geometry();
+#endif
+    board = geometry;
+    numEntities = 0;
+    maxNumEntities = geometry.TileCount();
+    hash = ZobristBoardKey(geometry);
+
+    ids.assign(maxNumEntities, EntityHandle{0, 0});
+    slotToEntityIndex.assign(maxNumEntities, -1);
+    slotGenerations.assign(maxNumEntities, 1);
 
-    for (int i = 0; i < NUMBER_OF_TILES; i++) {
-        ids[i] = i;
+    // hand out low slots first
+    freeSlots.resize(maxNumEntities);
+    for (int i = 0; i < maxNumEntities; i++) {
+        freeSlots[i] = maxNumEntities - 1 - i;
     }
+    types.assign(maxNumEntities, EntityType::BACKGROUND);
+    isMovable.Resize(maxNumEntities);
+    isTemporarilyMovable.Resize(maxNumEntities);
+    gotPushed.Resize(maxNumEntities);
+    hasMoved.Resize(maxNumEntities);
+
+    positions.assign(maxNumEntities, pos{0,0});
+    orientations.assign(maxNumEntities, UP);
+    tileToEntityMapping.assign(maxNumEntities, -1);
+    deltaPositions.assign(maxNumEntities, posf{0,0});
+    ports.assign(maxNumEntities, 0);
+    tileLinks.assign(maxNumEntities, 0);
+    flow.Resize(maxNumEntities);
+    occupancy.Resize(geometry.columns, geometry.rows);
+
+    trajectoryCache.Clear();
+    writtenTiles.Resize(maxNumEntities);
+    refreshedTiles.Resize(maxNumEntities);
+
+    // the player's assembly
+    assemblies.clear();
+    AddAssembly();
+}
+
+void EntityManager::Initialize() 
+{
+    int columns = board.columns;
+    int rows = board.rows;
+
+    // steps diagonally to the next free tile, giving up after as many steps as there are
+    // tiles, as a small board fills up before all pieces are placed
+    auto findFreeTile = [&](pos& position) {
+        for (int step = 0; step < board.TileCount(); step++) {
+            if (!doesEntityExistAtPosition(position))
+                return true;
+
+            position.x = (position.x + 1) % columns;
+            position.y = (position.y + 1) % rows;
+        }
+        return false;
+    };
 
     AddEntity(EntityType::BENT_PIPE, pos{.x=1,.y=1}, true, UP);
 
     int amount = 16;
     for (int i = 1; i < amount; i++)
     {
-        pos A = pos{.x=(i*5) % TILES_COLUMNS,
-                    .y=(i*7) % TILES_ROWS};
-        while (doesEntityExistAtPosition(A)) {
-            A.x = (A.x + 1) % TILES_COLUMNS;
-            A.y = (A.y + 1) % TILES_ROWS;
-        }
-        pos B = pos{.x=(i*11) % TILES_COLUMNS,
-                    .y=(i*13) % TILES_ROWS};
-        while (doesEntityExistAtPosition(B)) {
-            B.x = (B.x + 1) % TILES_COLUMNS;
-            B.y = (B.y + 1) % TILES_ROWS;
-        }
-
-        AddEntity(EntityType::BENT_PIPE, 
-                  A,
-                  false, static_cast<Direction>(i % 4));
-        AddEntity(EntityType::STRAIGHT_PIPE, 
-                  B,
-                  false,static_cast<Direction>(i % 4));
+        pos A = pos{.x=(i*5) % columns,
+                    .y=(i*7) % rows};
+        bool isAFree = findFreeTile(A);
+        pos B = pos{.x=(i*11) % columns,
+                    .y=(i*13) % rows};
+        bool isBFree = findFreeTile(B);
+
+        if (isAFree)
+            AddEntity(EntityType::BENT_PIPE, 
+                      A,
+                      false, static_cast<Direction>(i % 4));
+        if (isBFree)
+            AddEntity(EntityType::STRAIGHT_PIPE, 
+                      B,
+                      false,static_cast<Direction>(i % 4));
     }
 }
 
-void EntityManager::AddEntity(EntityType type, pos position, bool isCurrentMovable, Direction orientation) 
+int EntityManager::AddAssembly()
 {
-    if (numEntities >= maxNumEntities)
-        return;
+    assemblies.emplace_back();
+    assemblies.back().Resize(maxNumEntities, maxNumEntities);
+    return assemblies.size() - 1;
+}
 
-    int i = numEntities;
-    
-    int id = getSmallestAvailableID();
-    if (-1 == id)
-        return;
+EntityHandle EntityManager::AddEntity(EntityType type, pos position, bool isCurrentMovable, Direction orientation, int assemblyIndex) 
+{
+    if (numEntities >= maxNumEntities || freeSlots.empty())
+        return EntityHandle{0, 0};
 
-    if (!checkBounds(position)) 
+    if (assemblyIndex < 0 || assemblyIndex >= assemblies.size())
+        return EntityHandle{0, 0};
+
+    if (!checkBounds(position) || doesEntityExistAtPosition(position)) 
     {
-        return;
+        return EntityHandle{0, 0};
     }
-        
-    ids[i] = id;
+
+    int tileIndex = getTileIndexFromPosition(position);
+    int i = placeEntity(tileIndex, position, type, orientation, isCurrentMovable, assemblies[assemblyIndex]);
+
+    RefreshLinksAround(tileIndex);
+
+    return ids[i];
+}
+
+// writes a piece to the next index without working out links, the tile must be empty
+int EntityManager::placeEntity(int tileIndex, pos position, EntityType type, Direction orientation,
+                               bool isCurrentMovable, Assembly& assembly)
+{
+    int i = numEntities++;
+    ids[i] = allocateHandle(i);
     types[i] = type;
     positions[i] = position;
-    int tileIndex = getTileIndexFromPosition(position);
     tileToEntityMapping[tileIndex] = i;
+    occupancy.Set(position);
     orientations[i] = orientation;
-    isMovable[i] = isCurrentMovable;
-    hasMoved[i] = false;
+    ports[i] = PortsOf(type, orientation);
+    isMovable.Assign(i, isCurrentMovable);
+    isTemporarilyMovable.Reset(i);
+    gotPushed.Reset(i);
+    hasMoved.Reset(i);
+    deltaPositions[i] = posf{0,0};
+    hash ^= pieceKey(i);
+
+    if (isCurrentMovable) {
+        assembly.members.Set(i);
+        if (!isHandleValid(assembly.pivot))
+            assembly.pivot = ids[i];
+    }
 
-    numEntities++;
+    return i;
 }
 
-void EntityManager::DeleteEntity(int id) 
+void EntityManager::DeleteEntity(EntityHandle id) 
 {
     if (numEntities <= 0)
         return;
@@ -79,630 +173,1818 @@ void EntityManager::DeleteEntity(int id)
     if (-1 == i)
         return;
 
-    // move last entity to index of deleted
-    ids[i] = ids[numEntities];
-    types[i] = types[numEntities];
-    positions[i] = positions[numEntities];
-    orientations[i] = orientations[numEntities];
+    int tileIndex = getTileIndexFromEntityIndex(i);
 
-    tileToEntityMapping[numEntities] = -1;
+    tileToEntityMapping[tileIndex] = -1;
+    occupancy.Reset(positions[i]);
+    releaseHandle(id);
+    removeEntityIndex(i);
 
-    // decrement number of entities
-    numEntities--;
-}
+    // an assembly that lost its pivot turns about its first remaining piece
+    for (Assembly& assembly : assemblies) {
+        if (!(assembly.pivot == id))
+            continue;
 
-pos EntityManager::GetAdjacentPosition(pos position, Direction direction) 
-{
-    switch (direction) {
-        case UP:
-            return pos{.x=position.x, .y=position.y-1};
-        case RIGHT:
-            return pos{.x=position.x+1, .y=position.y};
-        case DOWN:
-            return pos{.x=position.x, .y=position.y+1};
-        case LEFT:
-            return pos{.x=position.x-1, .y=position.y};
-        default:
-            return position;
+        assembly.pivot = EntityHandle{0, 0};
+        assembly.members.ForEachSetBit(numEntities, [&](int index) {
+            assembly.pivot = ids[index];
+            return false;
+        });
     }
-}
 
-void EntityManager::InitializeTurn() {
-    std::fill(hasMoved, hasMoved+NUMBER_OF_TILES, false);
-    std::fill(deltaPositions, deltaPositions+NUMBER_OF_TILES, posf{0,0});
-    std::copy(positions, positions+NUMBER_OF_TILES, positionsBackup);
-    std::copy(orientations, orientations+NUMBER_OF_TILES, orientationsBackup);
-    std::copy(tileToEntityMapping, tileToEntityMapping+NUMBER_OF_TILES, tileToEntityMappingBackup);
-    isTurnOk = true;
+    RefreshLinksAround(tileIndex);
 }
 
-void EntityManager::InitializeRotation() { 
-    std::fill(isTemporarilyMovable, isTemporarilyMovable+NUMBER_OF_TILES, false);
-    std::fill(gotPushed, gotPushed+NUMBER_OF_TILES, false);
-}
+void EntityManager::DeleteEntity(pos position) 
+{
+    if (!doesEntityExistAtPosition(position))
+        return;
 
-void EntityManager::AbortTurn() {
-    std::fill(hasMoved, hasMoved+NUMBER_OF_TILES, false);
-    std::copy(positionsBackup, positionsBackup+NUMBER_OF_TILES, positions);
-    std::copy(orientationsBackup, orientationsBackup+NUMBER_OF_TILES, orientations);
-    std::copy(tileToEntityMappingBackup, tileToEntityMappingBackup+NUMBER_OF_TILES, tileToEntityMapping);
+    DeleteEntity(ids[getEntityIndexFromPosition(position)]);
 }
 
-void EntityManager::FinalizeTurn() {
-    if (isTurnOk) {
-        UpdateAllConnections();
-        UpdateRotations(rotationCounts);
-    }
-
-    else {
-        AbortTurn();
+int EntityManager::InsertRegion(BoardRegion region, const PackedTile* tiles, int assemblyIndex)
+{
+    // AddEntity for every piece of the span, with links worked out once for the
+    // whole region instead of around every piece
+    if (assemblyIndex < 0 || assemblyIndex >= assemblies.size())
+        return 0;
+
+    Assembly& assembly = assemblies[assemblyIndex];
+    int inserted = 0;
+
+    for (int y = 0; y < region.rows; y++) {
+        for (int x = 0; x < region.columns; x++) {
+            PackedTile tile = tiles[x + y * region.columns];
+            pos position = pos{region.low.x + x, region.low.y + y};
+            if (PackedType(tile) == EntityType::BACKGROUND || !checkBounds(position) || freeSlots.empty())
+                continue;
+
+            int tileIndex = getTileIndexFromPosition(position);
+            if (tileToEntityMapping[tileIndex] >= 0)
+                continue;
+
+            placeEntity(tileIndex, position, PackedType(tile), PackedOrientation(tile), IsPackedMovable(tile), assembly);
+            inserted++;
+        }
     }
 
-    pendingRotation = RotationCounts{0,0};
+    refreshRegionLinks(region);
+    return inserted;
 }
 
-void EntityManager::MoveAllToAdjacent(Direction direction) {
+int EntityManager::RemoveRegion(BoardRegion region, PackedTile* tiles)
+{
+    // Pieces are taken out from the highest index down, so the last piece, which
+    // moves into the freed index, is never one still to be removed. The removed
+    // pieces are packed into tiles when it is given, to be inserted again later.
+    std::vector<int>& removed = regionEntities;
+    removed.clear();
+
+    for (int y = 0; y < region.rows; y++) {
+        for (int x = 0; x < region.columns; x++) {
+            pos position = pos{region.low.x + x, region.low.y + y};
+            int index = checkBounds(position) ? getEntityIndexFromPosition(position) : -1;
+
+            if (tiles) {
+                tiles[x + y * region.columns] = index < 0 ? PackTile(EntityType::BACKGROUND, UP, false) :
+                                                PackTile(types[index], orientations[index], isMovable.Test(index));
+            }
 
-    InitializeTurn();
+            if (index < 0)
+                continue;
 
-    for (int i = 0; i < numEntities; i++)
-    {
-        if (!isMovable[i])
+            removed.push_back(index);
+            tileToEntityMapping[getTileIndexFromPosition(position)] = -1;
+            occupancy.Reset(position);
+            releaseHandle(ids[index]);
+        }
+    }
+
+    std::sort(removed.begin(), removed.end(), std::greater<int>());
+    for (int index : removed) {
+        removeEntityIndex(index);
+    }
+
+    // an assembly that lost its pivot turns about its first remaining piece
+    for (Assembly& assembly : assemblies) {
+        if (isHandleValid(assembly.pivot))
             continue;
 
-        MoveToAdjacentTile(i, direction);
+        assembly.pivot = EntityHandle{0, 0};
+        assembly.members.ForEachSetBit(numEntities, [&](int index) {
+            assembly.pivot = ids[index];
+            return false;
+        });
     }
 
-    FinalizeTurn();
+    refreshRegionLinks(region);
+    return removed.size();
 }
 
-void EntityManager::PushInDirection(Push push)
-{    
-    // Move "phantom object" to adjacent position
+int EntityManager::RemoveAllEntities()
+{
+    // an empty tile has no links, so only the tiles that held a piece change, and an
+    // empty board has no components, so the flow forgets them instead of relabelling
+    for (int i = 0; i < numEntities; i++) {
+        int tileIndex = getTileIndexFromEntityIndex(i);
+        tileToEntityMapping[tileIndex] = -1;
+        tileLinks[tileIndex] = 0;
+        flow.componentOfTile[tileIndex] = -1;
+        occupancy.Reset(positions[i]);
+        releaseHandle(ids[i]);
+    }
+    flow.Forget();
+
+    isMovable.ClearAll(numEntities);
+    isTemporarilyMovable.ClearAll(numEntities);
+    gotPushed.ClearAll(numEntities);
+    hasMoved.ClearAll(numEntities);
+    for (Assembly& assembly : assemblies) {
+        assembly.members.ClearAll(numEntities);
+        assembly.pivot = EntityHandle{0, 0};
+    }
 
-    pos fromPosition = pos{static_cast<int>(push.fromPosition.x), 
-                           static_cast<int>(push.fromPosition.y)};
+    int removed = numEntities;
+    numEntities = 0;
+    hash = ZobristBoardKey(board);
+    return removed;
+}
 
-    pos adjacentPosition = GetAdjacentPosition(fromPosition, push.direction);
+void EntityManager::InitializeTurn(Assembly& assembly) {
+    for (int index : assembly.journal.movedEntities) {
+        hasMoved.Reset(index);
+        deltaPositions[index] = posf{0,0};
+    }
+    assembly.journal.Clear();
+    assembly.turnRotation = RotationCounts{0,0};
+    assembly.isTurnOk = true;
+    STATS_RESET(assembly.stats);
+}
 
-    if (!checkBounds(adjacentPosition)) {
-        isTurnOk = false;
-        return;
+void EntityManager::InitializeRotation(Assembly& assembly) { 
+    for (const EntityRecord& record : assembly.pushedEntities) {
+        isTemporarilyMovable.Reset(record.entityIndex);
+        gotPushed.Reset(record.entityIndex);
     }
+    assembly.pushedEntities.clear();
+}
 
-    int adjacentIndex = getEntityIndexFromPosition(adjacentPosition);
+void EntityManager::AbortTurn(Assembly& assembly) {
+    TurnJournal& journal = assembly.journal;
 
-    if(doesEntityExist(adjacentIndex) && !(hasMoved[adjacentIndex]) && !isMovable[adjacentIndex]) {
-        int id = ids[adjacentIndex];
-        MoveToAdjacentTile(id, push.direction, true);
+    for (int index : journal.movedEntities) {
+        hasMoved.Reset(index);
     }
 
-    if(doesEntityExistAtPosition(adjacentPosition) && !(isMovable[adjacentIndex] || isTemporarilyMovable[adjacentIndex])) {
-        isTurnOk = false;
-        return;
+    for (auto record = journal.entities.rbegin(); record != journal.entities.rend(); ++record) {
+        hash ^= pieceKey(record->entityIndex);
+        positions[record->entityIndex] = record->position;
+        orientations[record->entityIndex] = record->orientation;
+        ports[record->entityIndex] = PortsOf(types[record->entityIndex], record->orientation);
+        hash ^= pieceKey(record->entityIndex);
+    }
+
+    for (auto record = journal.tiles.rbegin(); record != journal.tiles.rend(); ++record) {
+        tileToEntityMapping[record->tileIndex] = record->entityIndex;
+        occupancy.Assign(getPositionFromTileIndex(record->tileIndex), record->entityIndex >= 0);
     }
+
+    journal.Clear();
 }
 
-void EntityManager::MoveToAdjacentTile(int index, Direction direction, bool isRotation)
-{
-    if (!doesEntityExist(index)) {
-        return;
+void EntityManager::FinalizeTurn(Assembly& assembly) {
+    if (assembly.isTurnOk) {
+        UpdateAllConnections(assembly);
+        UpdateRotations(assembly);
+        assembly.turnRotation = assembly.pendingRotation;
     }
 
-    if (hasMoved[index])
-        return;
+    else {
+        AbortTurn(assembly);
+    }
 
-    pos position = positions[index];
+    assembly.pendingRotation = RotationCounts{0,0};
+}
 
-    pos adjacentPosition = GetAdjacentPosition(position, direction);
+void EntityManager::MoveAllToAdjacent(Direction direction) {
+    RunTurn(direction, false);
+}
 
-    if (!checkBounds(adjacentPosition)) {
-        isTurnOk = false;
-        return;
+void EntityManager::RunTurn(Direction direction, bool isRotation)
+{
+    // Assemblies take their turns one after another, each against the board the ones
+    // before it left. Assemblies whose swept regions are clear of all others are resolved
+    // up front side by side against the board as it is now. Such a result stands unless
+    // an earlier assembly wrote a tile it read, then it is resolved again in order.
+    STATS_START_TIMER(turnStart);
+    attachments.clear();
+
+    for (Assembly& assembly : assemblies) {
+        if (isRotation)
+            InitializeRotation(assembly);
+        InitializeTurn(assembly);
+        assembly.isResolved = false;
     }
 
-    int adjacentIndex = getEntityIndexFromPosition(adjacentPosition);
+    bool isShared = assemblies.size() > 1;
+    if (isShared)
+        ResolveIndependentAssemblies(direction, isRotation);
 
-    if(doesEntityExist(adjacentIndex) && !(hasMoved[adjacentIndex])) {
+    isTurnOk = true;
+    for (Assembly& assembly : assemblies) {
+        if (!assembly.isResolved || readsWrittenTiles(assembly))
+            ResolveAssembly(assembly, direction, isRotation);
 
-        if (isRotation) {
-            if (isMovable[adjacentIndex]) {
-                isTemporarilyMovable[index] = true;
-                gotPushed[index] = true;
-                return;
+        ApplyAssembly(assembly, direction, isRotation);
+        isTurnOk &= assembly.isTurnOk;
+
+        if (isShared) {
+            for (const TileRecord& record : assembly.journal.tiles) {
+                writtenTiles.Set(record.tileIndex);
             }
         }
+    }
 
-        int id = ids[adjacentIndex];
-        MoveToAdjacentTile(id, direction, isRotation);
+    if (isShared) {
+        for (Assembly& assembly : assemblies) {
+            for (const TileRecord& record : assembly.journal.tiles) {
+                writtenTiles.Reset(record.tileIndex);
+            }
+        }
     }
 
-    if(doesEntityExistAtPosition(adjacentPosition)) {
-        return;
+#ifdef PIPE_STATS
+    recordTurnStats(turnStart);
+#endif
+
+#ifdef PIPE_VERIFY_HASH
+    uint64_t recomputed = ComputeHash();
+    if (hash != recomputed) {
+        fprintf(stderr, "board hash %016llx differs from the recomputed %016llx\n",
+                static_cast<unsigned long long>(hash), static_cast<unsigned long long>(recomputed));
+        abort();
     }
+#endif
+}
+
+void EntityManager::UndoTurn()
+{
+    // AbortTurn for every assembly the last turn moved, the last one first, then the
+    // pieces it made movable, the links around every tile it wrote and its rotations
+    changedTiles.clear();
 
-    positions[index] = adjacentPosition;
-    int oldTileIndex = getTileIndexFromPosition(position);
-    int newTileIndex = getTileIndexFromPosition(adjacentPosition);
+    for (auto assembly = assemblies.rbegin(); assembly != assemblies.rend(); ++assembly) {
+        for (const TileRecord& record : assembly->journal.tiles) {
+            markChangedTile(record.tileIndex);
+        }
+        for (const EntityRecord& record : assembly->journal.entities) {
+            markChangedTile(getTileIndexFromPosition(record.position));
+        }
+        AbortTurn(*assembly);
 
-    tileToEntityMapping[oldTileIndex] = -1;
-    tileToEntityMapping[newTileIndex] = index;
+        // the renderer may already have played some of them back
+        RotationCounts& counts = assembly->rotationCounts;
+        counts.leftRotations -= std::min(counts.leftRotations, assembly->turnRotation.leftRotations);
+        counts.rightRotations -= std::min(counts.rightRotations, assembly->turnRotation.rightRotations);
+        assembly->turnRotation = RotationCounts{0,0};
+    }
 
-    hasMoved[index] = true;
-    if (isRotation) {
-        gotPushed[index] = true;
+    for (const AttachRecord& record : attachments) {
+        hash ^= pieceKey(record.entityIndex);
+        isMovable.Reset(record.entityIndex);
+        hash ^= pieceKey(record.entityIndex);
+        assemblies[record.assemblyIndex].members.Reset(record.entityIndex);
     }
-    deltaPositions[index] = posf{static_cast<float>(adjacentPosition.x - position.x), 
-                                 static_cast<float>(adjacentPosition.y - position.y)};
+    attachments.clear();
 
+    refreshChangedLinks();
 }
 
-bool EntityManager::doesEntityExistAtPosition(pos position) 
+void EntityManager::ResolveIndependentAssemblies(Direction direction, bool isRotation)
 {
-    if (!checkBounds(position))
-        return false;
+    independentAssemblies.clear();
 
-    int index = getEntityIndexFromPosition(position);
+#ifdef PARALLEL_ASSEMBLIES
+    if (workerCount < 2)
+        return;
 
-    return index >= 0 && index < numEntities;
-}
+    int memberCount = 0;
+    for (Assembly& assembly : assemblies) {
+        computeSweptRegion(assembly, isRotation);
+    }
 
+    for (int k = 0; k < assemblies.size(); k++) {
+        const Assembly& assembly = assemblies[k];
+        if (assembly.regionHigh.x < assembly.regionLow.x)
+            continue;
 
-bool EntityManager::doesEntityExist(int index) 
-{
-    return index >= 0 && index < numEntities;
-}
+        bool isClear = true;
+        for (int other = 0; other < assemblies.size() && isClear; other++) {
+            const Assembly& otherAssembly = assemblies[other];
+            isClear = other == k ||
+                      otherAssembly.regionHigh.x < assembly.regionLow.x || assembly.regionHigh.x < otherAssembly.regionLow.x ||
+                      otherAssembly.regionHigh.y < assembly.regionLow.y || assembly.regionHigh.y < otherAssembly.regionLow.y;
+        }
 
-void DisplayHelperGrid( std::vector<Push> pushes) {
-    for (int y = 0; y < TILES_ROWS; y++) {
-        char row[TILES_COLUMNS*2+1]; 
-        for (int x = 0; x < TILES_COLUMNS; x++) {
-            bool isPositionFound = false;
-
-            char dir = '#';
-
-            for(auto push : pushes)
-            {
-                posf p = push.fromPosition;
-                isPositionFound |= (static_cast<int>(p.x) == x && static_cast<int>(p.y == y));
-                if (isPositionFound) {
-                    switch (push.direction) {
-                        case (UP):
-                            dir = 'A';
-                            break;
-                        case (DOWN):
-                            dir = 'v';
-                            break;
-                        case (LEFT):
-                            dir = '<';
-                            break;
-                        case (RIGHT):
-                            dir = '>';
-                            break;
-                    }
-                }
-            }
-            row[2*x] = '|';
+        if (isClear) {
+            independentAssemblies.push_back(k);
+            memberCount += assembly.members.Count(numEntities);
+        }
+    }
 
-            row[2*x+1] = isPositionFound ? dir : '_';
+    // threads only pay for themselves on large assemblies
+    if (independentAssemblies.size() < 2 || memberCount < parallelMinimumMembers)
+        return;
+
+    // trajectories are looked up here so the cache does not grow while threads read it
+    if (isRotation) {
+        for (int k : independentAssemblies) {
+            pos pivotPosition;
+            getPivotPosition(assemblies[k], pivotPosition);
+            CollectRotationStreams(assemblies[k], pivotPosition, direction);
         }
     }
-}
 
-void EntityManager::RotateAll(Direction direction) {
-    pos pivotPosition = positions[0];
+    std::atomic<int> next(0);
+    int count = independentAssemblies.size();
 
-    std::vector<Push> pushes = CalculateAllRotationPushes(pivotPosition, direction);
+    auto work = [&]() {
+        for (int n = next++; n < count; n = next++) {
+            Assembly& assembly = assemblies[independentAssemblies[n]];
 
-    //DisplayHelperGrid(pushes);
+            if (isRotation) {
+                pos pivotPosition;
+                getPivotPosition(assembly, pivotPosition);
+                SweepRotation(assembly, trajectoryCache.Data(), trajectoryCache.Steps(), pivotPosition);
+            } else {
+                ResolveAssembly(assembly, direction, false);
+            }
 
-    InitializeRotation();
+            recordFootprint(assembly, direction, isRotation);
+            assembly.isResolved = true;
+        }
+    };
 
-    pos TempPositions[NUMBER_OF_TILES];
-    std::copy(positions, positions+NUMBER_OF_TILES, TempPositions);
+    std::vector<std::thread> workers;
+    for (int t = 1; t < std::min(workerCount, count); t++) {
+        workers.emplace_back(work);
+    }
 
-    bool canRotationComplete = true;
-    float maximumAngle = 7.f;
+    work();
 
-    std::vector<Push> okPushes;
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+#endif
+}
 
-    for(auto push : pushes)
-    {
-        InitializeTurn();
-        PushInDirection(push);
-        FinalizeTurn();
+void EntityManager::ResolveAssembly(Assembly& assembly, Direction direction, bool isRotation)
+{
+    // reads the board and writes only the assembly's own scratch
+    STATS_START_TIMER(resolveStart);
+    STATS_ADD(assembly.stats, resolutions, 1);
 
-        if (!isTurnOk) {
-            maximumAngle = push.priority < maximumAngle ? push.priority : maximumAngle;
-            partialRotationSign = 1;
-            partialRotationAngle = -push.priority * (direction - 2);
-            return;
-        }
+    if (isRotation) {
+        pos pivotPosition;
+        if (getPivotPosition(assembly, pivotPosition))
+            ComputeCollisionAngle(assembly, pivotPosition, direction);
+        STATS_ADD_TIME(assembly.stats, resolveMicros, resolveStart);
+        return;
     }
 
-    InitializeTurn();
+    if (translationBackend == TranslationBackend::BITBOARD)
+        ResolveTranslationOnBitboards(assembly, direction);
+    else
+        ResolvePushChains(assembly, direction);
+    STATS_ADD_TIME(assembly.stats, resolveMicros, resolveStart);
+}
+
+void EntityManager::ApplyAssembly(Assembly& assembly, Direction direction, bool isRotation)
+{
+    if (!isRotation) {
+        if (assembly.isTurnOk)
+            ShiftChainEntities(assembly, direction);
 
-    std::copy(gotPushed, gotPushed+NUMBER_OF_TILES, hasMoved);
-    for (int i = 0; i < NUMBER_OF_TILES; i++) {
-        deltaPositions[i] = gotPushed[i] ? posf{static_cast<float>(positions[i].x - TempPositions[i].x), 
-                                                static_cast<float>(positions[i].y - TempPositions[i].y)} : posf{0,0};
+        FinalizeTurn(assembly);
+        return;
     }
-    
-    for (int i = 0; i < numEntities; i++)
-    {
-        if (!isMovable[i] && !isTemporarilyMovable[i])
-            continue;
-        
-        RotateMovable(i, direction, pivotPosition);
+
+    pos pivotPosition;
+    if (!getPivotPosition(assembly, pivotPosition))
+        return;
+
+    const CollisionResult& result = assembly.collision;
+
+    if (!result.canComplete) {
+        assembly.isTurnOk = false;
+        assembly.partialRotationSign = 1;
+        assembly.partialRotationAngle = -BinaryAngleToRadians(result.maximumAngle) * (direction - 2);
+        return;
     }
 
+    ApplySweptPushes(assembly, result);
+    RotateMovables(assembly, direction, pivotPosition);
+
     switch (direction) {
         case RIGHT:
-            pendingRotation.rightRotations++;
+            assembly.pendingRotation.rightRotations++;
             break;
         case LEFT:
-            pendingRotation.leftRotations++;
+            assembly.pendingRotation.leftRotations++;
             break;
         default:
             break;
     }
 
-    FinalizeTurn();
+    FinalizeTurn(assembly);
 }
 
-void EntityManager::RotateMovable(int index, Direction direction, pos pivotPosition)
+void EntityManager::ResolvePushChains(Assembly& assembly, Direction direction) const
 {
-    pos currentPosition = positions[index];
-    pos projectedPosition = GetProjectedPosition(currentPosition, pivotPosition, direction);
+    // Walk forward from every movable entity through the occupied tiles ahead of it.
+    // A walk stops at an empty tile or at an entity an earlier walk already claimed,
+    // so every occupied tile is visited at most once.
+    assembly.chainEntities.clear();
+
+    assembly.isTurnOk = assembly.members.ForEachSetBit(numEntities, [&](int i) {
+        if (assembly.claimed.Test(i))
+            return true;
+
+        int current = i;
+        size_t walkStart = assembly.chainEntities.size();
+        while (true) {
+            assembly.chainEntities.push_back(current);
+            assembly.claimed.Set(current);
+            STATS_MAX(assembly.stats, longestPushChain, assembly.chainEntities.size() - walkStart);
 
-    if (doesEntityExistAtPosition(projectedPosition)) {
-        int toBeRotatedTileIndex = getTileIndexFromEntityIndex(index);
-        int projectedPositionTileIndex = getTileIndexFromPosition(projectedPosition);
-        bool willCurrentEntityMove = toBeRotatedTileIndex != projectedPositionTileIndex;
-        int projectedIndex = getEntityIndexFromPosition(projectedPosition);
-        bool isCurrentMovable = (isMovable[projectedIndex] || isTemporarilyMovable[projectedIndex]);
-        if ((willCurrentEntityMove && !isCurrentMovable)) {
-            isTurnOk = false;
-            return;
+            pos adjacentPosition = GetAdjacentPosition(positions[current], direction);
+            if (!checkBounds(adjacentPosition))
+                return false;
+
+            int adjacentIndex = getEntityIndexFromPosition(adjacentPosition);
+            if (!doesEntityExist(adjacentIndex) || assembly.claimed.Test(adjacentIndex))
+                return true;
+
+            current = adjacentIndex;
         }
-    }
+    });
 
-    if (!checkBounds(projectedPosition)) {
-        isTurnOk = false;
-        return;    
+    for (int index : assembly.chainEntities) {
+        assembly.claimed.Reset(index);
     }
-
-    int oldTileIndex = getTileIndexFromPosition(positions[index]);
-    int newTileIndex = getTileIndexFromPosition(projectedPosition);
-    positions[index] = projectedPosition;
-    tileToEntityMapping[oldTileIndex] = -1;
-    tileToEntityMapping[newTileIndex] = index;
-    
-    int id = ids[index];
-    Rotate(id, direction);
 }
 
-pos EntityManager::GetProjectedPosition(pos currentPosition, pos pivotPosition, Direction direction) {
-    int deltaX = currentPosition.x-pivotPosition.x;
-    int deltaY = currentPosition.y-pivotPosition.y;
-    int sign = direction - 2;
-    int deltaRotX = -sign * deltaY;
-    int deltaRotY = sign * deltaX;
-    int x = pivotPosition.x + deltaRotX;
-    int y = pivotPosition.y + deltaRotY;
-    return pos{.x=x, .y=y};
+void EntityManager::ResolveTranslationOnBitboards(Assembly& assembly, Direction direction) const
+{
+    assembly.movableMask.Resize(board.columns, board.rows);
+    assembly.members.ForEachSetBit(numEntities, [&](int i) {
+        assembly.movableMask.Set(positions[i]);
+        return true;
+    });
+
+    assembly.isTurnOk = assembly.translator.Resolve(occupancy, assembly.movableMask, direction);
+
+    assembly.chainEntities.clear();
+    assembly.translator.Moved().ForEachSetBit([&](pos position) {
+        assembly.chainEntities.push_back(getEntityIndexFromPosition(position));
+    });
 }
 
-void EntityManager::Rotate(int id, Direction direction) 
+void EntityManager::ShiftChainEntities(Assembly& assembly, Direction direction)
 {
-    int index = getEntityIndexFromId(id);
+    pos step = GetAdjacentPosition(pos{0,0}, direction);
+    posf deltaPosition = posf{static_cast<float>(step.x), static_cast<float>(step.y)};
 
-    Direction d = static_cast<Direction>((orientations[index] + direction) % 4);
+    // vacate every tile first so runs can shift into each other's old tiles
+    for (int index : assembly.chainEntities) {
+        markMoved(assembly, index, deltaPosition);
+        setTileMapping(assembly, positions[index], -1);
+    }
 
-    orientations[index] = d;
+    for (int index : assembly.chainEntities) {
+        pos adjacentPosition = GetAdjacentPosition(positions[index], direction);
+        setEntityPosition(assembly, index, adjacentPosition);
+        setTileMapping(assembly, adjacentPosition, index);
+    }
 }
 
-std::vector<Push> EntityManager::CalculateAllRotationPushes(pos pivotPosition, Direction direction)
+void EntityManager::MoveToAdjacentTile(Assembly& assembly, int index, Direction direction, bool isRotation)
 {
-    std::vector<Push> pushes;
-
-    for (int i = 0; i < numEntities; i++)
-    {
-        if (!isMovable[i] || (positions[i].x == pivotPosition.x && positions[i].y == pivotPosition.y))
-            continue;
-        
-        std::vector<Push> p = GetQuantizedRotationTrajectory(positions[i], pivotPosition, direction);
-
-        //DisplayHelperGrid(p);
-
-        pushes.insert(pushes.end(), p.begin(), p.end());
+    if (!doesEntityExist(index)) {
+        return;
     }
 
-    std::sort(pushes.begin(), pushes.end(), [](Push a, Push b) { return a.priority < b.priority; });
+    if (hasMoved.Test(index))
+        return;
 
-    return pushes;
-}
+    pos position = positions[index];
 
+    pos adjacentPosition = GetAdjacentPosition(position, direction);
 
+    if (!checkBounds(adjacentPosition)) {
+        assembly.isTurnOk = false;
+        return;
+    }
 
-std::vector<Push> EntityManager::GetQuantizedRotationTrajectory(pos currentPosition, pos pivotPosition, Direction rotationDirection) 
-{
-    posf currentPoint = posf{static_cast<float>(currentPosition.x-pivotPosition.x), 
-                             static_cast<float>(currentPosition.y-pivotPosition.y)};
+    int adjacentIndex = getEntityIndexFromPosition(adjacentPosition);
 
-    int sign = rotationDirection - 2;
-    posf endPoint = posf{-currentPoint.y*sign, currentPoint.x*sign};
-    float radius = sqrt(currentPoint.x*currentPoint.x + currentPoint.y*currentPoint.y);
-    float currentAngle = 0.;
-    
-    std::vector<posf> outPositions;
-    std::vector<float> angles;
+    if(doesEntityExist(adjacentIndex) && !(hasMoved.Test(adjacentIndex))) {
 
-    outPositions.push_back(posf{currentPoint.x+pivotPosition.x, currentPoint.y+pivotPosition.y});
-    angles.push_back(currentAngle);
-    
-    for (int i = 0; i < 100; i++) {
-        posf outPosition = getNextRotationStep(currentPoint, currentAngle, sign, radius);
-        
-        outPositions.push_back(posf{outPosition.x+pivotPosition.x, outPosition.y+pivotPosition.y});
-        angles.push_back(currentAngle);
+        if (isRotation) {
+            if (assembly.members.Test(adjacentIndex)) {
+                markPushed(assembly, index);
+                isTemporarilyMovable.Set(index);
+                return;
+            }
+        }
 
-        if (outPosition.x == endPoint.x && outPosition.y == endPoint.y)
-            break;
+        MoveToAdjacentTile(assembly, adjacentIndex, direction, isRotation);
     }
 
-    std::vector<Push> pushes;
+    if(doesEntityExistAtPosition(adjacentPosition)) {
+        return;
+    }
 
-    for (int i = 0; i < outPositions.size()-1; i++) {
-         
-        float diffX = outPositions[i+1].x - outPositions[i].x;
-        float diffY = outPositions[i+1].y - outPositions[i].y;
-        if (abs(diffX) > 1 || abs(diffY) > 1)
-            continue;
-        Direction d = static_cast<Direction>(diffY*(diffY+1.) + abs(diffX)*(diffX+2.));
-        char dir = '_';
-        switch (d) {
-            case (UP):
-                dir = 'A';
-                break;
-            case (DOWN):
-                dir = 'v';
-                break;
-            case (LEFT):
-                dir = '<';
-                break;
-            case (RIGHT):
-                dir = '>';
-                break;
-        }
-        Push push = Push{.priority=angles[i],.fromPosition = outPositions[i],.direction = d};
-        pushes.push_back(push);
+    if (isRotation) {
+        markPushed(assembly, index);
     }
-    
-    return pushes;
-}
 
-posf EntityManager::getNextRotationStep(posf& pos, float& angle, int sign, float radius) 
-{
-    if (pos.x > 0.5 && pos.y > 0.5) {
-        posf outPosition = idealizedStep(pos, angle, sign, radius);
-        return outPosition;
-    } else if (pos.x < -0.5 && pos.y > 0.5) {
-        posf inPosition = posf{pos.y, -pos.x};
-        posf outPosition = idealizedStep(inPosition, angle, sign, radius);
-        pos = posf{-inPosition.y, inPosition.x};
-        posf transformedOut = posf{-outPosition.y, outPosition.x};
-        return transformedOut;
-    } else if (pos.x < -0.5 && pos.y < -0.5) {
-        posf inPosition = posf{-pos.x, -pos.y};
-        posf outPosition = idealizedStep(inPosition, angle, sign, radius);
-        pos = posf{-inPosition.x, -inPosition.y};
-        posf transformedOut = posf{-outPosition.x, -outPosition.y};
-        return transformedOut;
-    } else if (pos.x > 0.5 && pos.y < -0.5) {
-        posf inPosition = posf{-pos.y, pos.x};
-        posf outPosition = idealizedStep(inPosition, angle, sign, radius);
-        pos = posf{inPosition.y, -inPosition.x};
-        posf transformedOut = posf{outPosition.y, -outPosition.x};
-        return transformedOut;
-    } else if (abs(pos.x) <= 0.5) {
-        float ySign = (pos.y >= 0) - (pos.y < 0);
-    
-        // SMALL BUG HERE
+    setEntityPosition(assembly, index, adjacentPosition);
+    setTileMapping(assembly, position, -1);
+    setTileMapping(assembly, adjacentPosition, index);
 
-        float angleDiff = 3.141592 - abs(atan(pos.y/pos.x))*2.;
-        angle += angleDiff;
+    markMoved(assembly, index, posf{static_cast<float>(adjacentPosition.x - position.x), 
+                          static_cast<float>(adjacentPosition.y - position.y)});
 
-        float nextX = -ySign * sign * 0.5001;
-        pos = posf{nextX, pos.y};
+}
 
-        posf outPosition = posf{-ySign * sign, round(pos.y)};
-        return outPosition;
-    } else if (abs(pos.y) <= 0.5) {
-        float xSign = (pos.x >= 0) - (pos.x < 0);
+bool EntityManager::doesEntityExistAtPosition(pos position) const
+{
+    if (!checkBounds(position))
+        return false;
 
-        // SMALL BUG HERE 
+    int index = getEntityIndexFromPosition(position);
 
-        float angleDiff = abs(atan(pos.y/pos.x))*2.;
-        angle += angleDiff;
+    return index >= 0 && index < numEntities;
+}
 
-        float nextY = xSign * sign * 0.5001;
-        pos = posf{pos.x, nextY};
 
-        posf outPosition = posf{round(pos.x), xSign * sign};
-        return outPosition;
-    }
-    return posf{0.,0.};
+bool EntityManager::doesEntityExist(int index) const
+{
+    return index >= 0 && index < numEntities;
 }
 
-posf EntityManager::idealizedStep(posf& pos, float& angle, int sign, float radius) 
-{
-    float currentAngle = atan(pos.y/pos.x);
-    posf next = idealizedCoords(pos, sign, radius);
-    float angleFromX = acos(next.x/radius);
-    float angleFromY = asin(next.y/radius);
-    float angleDiffX = abs(angleFromX - currentAngle);
-    float angleDiffY = abs(angleFromY - currentAngle);
-    if (angleDiffX < angleDiffY) {
-        float yFromX = sin(angleFromX)*radius;
-        pos.x = next.x;
-        pos.y = yFromX;
-        angle += angleDiffX;
-        posf out = posf{round(pos.x-sign*0.0001f), 
-                        round(pos.y+sign*0.0001f)};
-        return out;
-    } else {
-        float xFromY = cos(angleFromY)*radius;
-        pos.y = next.y;
-        pos.x = xFromY;
-        angle += angleDiffY;
-        posf out = posf{round(pos.x-sign*0.0001f), 
-                        round(pos.y+sign*0.0001f)};
-        return out;
-    }
+void EntityManager::RotateAll(Direction direction) {
+    RunTurn(direction, true);
 }
 
-posf EntityManager::idealizedCoords(posf& currentPosition, int sign, float radius) 
+const CollisionResult& EntityManager::ComputeCollisionAngle(Assembly& assembly, pos pivotPosition, Direction direction)
 {
-    posf nc = currentPosition;
-    if (sign == -1) {
-        nc.x = round(nc.x + 0.0001) + 0.5;
-        nc.y = round(nc.y - 0.0001) - 0.5;
-        nc.x = nc.x < radius ? nc.x : radius;
-    } else if (sign == 1) {
-        nc.x = round(nc.x - 0.0001) - 0.5;
-        nc.y = round(nc.y + 0.0001) + 0.5;
-        nc.y = nc.y < radius ? nc.y : radius;
-    }
-    return nc;
+    CollectRotationStreams(assembly, pivotPosition, direction);
+    return SweepRotation(assembly, trajectoryCache.Data(), trajectoryCache.Steps(), pivotPosition);
 }
 
-std::vector<Direction> EntityManager::GetConnectableDirectionsFromId(int id) 
+const CollisionResult& EntityManager::SweepRotation(Assembly& assembly, const Push* trajectories,
+                                                    const TrajectoryStep* steps, pos pivotPosition) const
 {
+    // Every trajectory step is an event where the moving piece enters the adjacent tile.
+    // One pass over the events in stream order finds the earliest angle each tile is swept
+    // at. Nothing happens before the first contact, an event that leaves the board or meets
+    // a piece outside the assembly, so only the events from that angle on are ordered and
+    // replayed against a scratch overlay of the board: obstacles in the way are pushed
+    // along, and the first event that cannot be resolved bounds the rotation. Pieces of
+    // other assemblies are obstacles like any other.
+    SweepScratch& sweep = assembly.sweep;
+    CollisionResult& collision = assembly.collision;
+    std::vector<SweptTile>& sweptTiles = collision.sweptTiles;
+
+    sweep.Reset();
+    collision.canComplete = true;
+    collision.maximumAngle = BINARY_QUARTER_TURN;
+    sweptTiles.clear();
+    collision.pushedEntities.clear();
+
+    bool isContact = false;
+    BinaryAngle contactAngle = BINARY_QUARTER_TURN;
+
+    auto sweepTile = [&](int tileIndex, BinaryAngle angle) {
+        BinaryAngle& earliest = sweep.sweptAngles[tileIndex];
+        if (earliest == SWEEP_NEVER)
+            sweptTiles.push_back(SweptTile{tileIndex, 0});
+        earliest = std::min(earliest, angle);
+    };
+
+    // when no event can leave the board a row major tile index is the pivot's plus an offset
+    int reach = assembly.rotationEvents.Reach();
+    bool isInside = checkBounds(pos{pivotPosition.x - reach, pivotPosition.y - reach}) &&
+                    checkBounds(pos{pivotPosition.x + reach, pivotPosition.y + reach});
+
+    if (isInside && board.layout == TileLayout::ROW_MAJOR) {
+        int pivotTile = getTileIndexFromPosition(pivotPosition);
+        int columns = board.columns;
+        assembly.rotationEvents.ForEach(steps, [&](const TrajectoryStep& step) {
+            sweepTile(pivotTile + step.x + step.y * columns, step.angle);
+        });
+    } else {
+        assembly.rotationEvents.ForEach(steps, [&](const TrajectoryStep& step) {
+            pos position = pos{pivotPosition.x + step.x, pivotPosition.y + step.y};
+            if (checkBounds(position)) {
+                sweepTile(getTileIndexFromPosition(position), step.angle);
+                return;
+            }
 
-    int index = getEntityIndexFromId(id);
-    EntityType type = types[index];
-    Direction orientation = orientations[index];
+            isContact = true;
+            contactAngle = std::min(contactAngle, step.angle);
+        });
+    }
+
+    for (SweptTile& swept : sweptTiles) {
+        swept.angle = sweep.sweptAngles[swept.tileIndex];
+        sweep.sweptAngles[swept.tileIndex] = SWEEP_NEVER;
+        sweep.boardReads.push_back(swept.tileIndex);
+
+        int occupant = tileToEntityMapping[swept.tileIndex];
+        if (occupant >= 0 && !assembly.members.Test(occupant)) {
+            isContact = true;
+            contactAngle = std::min(contactAngle, swept.angle);
+        }
+    }
+
+    if (!isContact)
+        return collision;
+
+    // tiles swept before the contact stay listed, the replay lists the others as it meets them
+    size_t keptCount = 0;
+    for (const SweptTile& swept : sweptTiles) {
+        if (swept.angle >= contactAngle)
+            continue;
+
+        sweepTouchTile(sweep, swept.tileIndex);
+        sweep.isTileSwept[swept.tileIndex] = true;
+        sweptTiles[keptCount++] = swept;
+    }
+    sweptTiles.resize(keptCount);
 
-    std::vector<Direction> directions;
+    assembly.rotationEvents.Start(trajectories, pivotPosition, contactAngle);
 
-    switch (type)
+    Push push;
+    while (assembly.rotationEvents.Next(push))
     {
-        case EntityType::BENT_PIPE:
-            directions.push_back(static_cast<Direction>(orientation));
-            directions.push_back(static_cast<Direction>((1 + orientation) % 4));
-            break;
-        case EntityType::STRAIGHT_PIPE:
-            directions.push_back(static_cast<Direction>(orientation));
-            directions.push_back(static_cast<Direction>((2 + orientation) % 4));
-            break;
-        default:
+        STATS_ADD(assembly.stats, sweptEvents, 1);
+        pos fromPosition = pos{static_cast<int>(push.fromPosition.x), 
+                               static_cast<int>(push.fromPosition.y)};
+        pos adjacentPosition = GetAdjacentPosition(fromPosition, push.direction);
+
+        bool isBlocked = !checkBounds(adjacentPosition);
+
+        if (!isBlocked) {
+            int tileIndex = getTileIndexFromPosition(adjacentPosition);
+            if (!sweep.isTileSwept[tileIndex]) {
+                sweepTouchTile(sweep, tileIndex);
+                sweep.isTileSwept[tileIndex] = true;
+                sweptTiles.push_back(SweptTile{tileIndex, push.priority});
+            }
+
+            int occupant = sweepOccupant(sweep, tileIndex);
+            if (occupant >= 0 && !assembly.members.Test(occupant))
+                isBlocked = !sweepPushChain(assembly, occupant, push.direction);
+
+            occupant = sweepOccupant(sweep, tileIndex);
+            if (occupant >= 0 && !assembly.members.Test(occupant) && !sweep.isEntityTemporarilyMovable[occupant])
+                isBlocked = true;
+        }
+
+        if (isBlocked) {
+            collision.canComplete = false;
+            collision.maximumAngle = push.priority;
             break;
+        }
     }
 
-    return directions;
+    for (int index : sweep.touchedEntities) {
+        collision.pushedEntities.push_back(SweptEntity{index, sweepEntityTile(sweep, index), 
+                                                       static_cast<bool>(sweep.isEntityTemporarilyMovable[index])});
+    }
+
+    return collision;
 }
 
-void EntityManager::UpdateCurrentConnections(int currentId) 
+void EntityManager::ApplySweptPushes(Assembly& assembly, const CollisionResult& result)
 {
-    int index = getEntityIndexFromId(currentId);
-    pos currentPosition = positions[index];
-    std::vector<Direction> currentConnectableDirections = GetConnectableDirectionsFromId(currentId);
-
-    for(Direction d : currentConnectableDirections)
-    {
-        pos adjPosition = GetAdjacentPosition(currentPosition, d);
-        if (!doesEntityExistAtPosition(adjPosition))
-            continue;
+    for (const SweptEntity& pushed : result.pushedEntities) {
+        markPushed(assembly, pushed.entityIndex);
+        isTemporarilyMovable.Assign(pushed.entityIndex, pushed.isTemporarilyMovable);
+        setTileMapping(assembly, positions[pushed.entityIndex], -1);
+    }
 
-        int adjIndex = getEntityIndexFromPosition(adjPosition);
-        int adjId = ids[adjIndex];
-        if (IsAdjacentConnectable(d, adjId))
-            isMovable[adjIndex] = true;
+    for (const SweptEntity& pushed : result.pushedEntities) {
+        int i = pushed.entityIndex;
+        pos position = getPositionFromTileIndex(pushed.tileIndex);
+        markMoved(assembly, i, posf{static_cast<float>(position.x - positions[i].x), 
+                                    static_cast<float>(position.y - positions[i].y)});
+        setEntityPosition(assembly, i, position);
+        setTileMapping(assembly, position, i);
     }
 }
 
-bool EntityManager::IsAdjacentConnectable(Direction connectionDirection, int adjId) 
+void EntityManager::RotateMovables(Assembly& assembly, Direction direction, pos pivotPosition)
 {
-    std::vector<Direction> adjConnectableDirections = GetConnectableDirectionsFromId(adjId);
-    for(Direction adjDir : adjConnectableDirections)
-    {
-        if (adjDir == ((connectionDirection + 2) % 4))
+    // check every destination before touching the board
+    std::vector<int>& chainEntities = assembly.chainEntities;
+    chainEntities.clear();
+
+    if (!CanPlaceRotation(assembly, pivotPosition, direction)) {
+        assembly.isTurnOk = false;
+        return;
+    }
+
+    assembly.rotatingEntities.ForEachSetBit(numEntities, [&](int i) {
+        chainEntities.push_back(i);
+        return true;
+    });
+
+    for (int index : chainEntities) {
+        setTileMapping(assembly, positions[index], -1);
+    }
+
+    for (int index : chainEntities) {
+        pos projectedPosition = GetProjectedPosition(positions[index], pivotPosition, direction);
+        setEntityTransform(assembly, index, projectedPosition, static_cast<Direction>((orientations[index] + direction) % 4));
+        setTileMapping(assembly, projectedPosition, index);
+    }
+}
+
+bool EntityManager::CanPlaceRotation(Assembly& assembly, pos pivotPosition, Direction direction)
+{
+    // The whole assembly is checked at once: its mask is turned a quarter turn,
+    // the turned bounding box must lie on the board, and no turned bit may land
+    // on an occupied tile that is not itself part of the assembly.
+    BitSet& rotatingEntities = assembly.rotatingEntities;
+    Bitboard& assemblyMask = assembly.assemblyMask;
+    Bitboard& rotatedAssemblyMask = assembly.rotatedAssemblyMask;
+    std::vector<uint64_t>& occupiedRow = assembly.occupiedRow;
+    std::vector<uint64_t>& assemblyRow = assembly.assemblyRow;
+
+    // pieces this assembly picked up while sweeping turn with it
+    rotatingEntities.CopyFrom(assembly.members, numEntities);
+    for (const EntityRecord& record : assembly.pushedEntities) {
+        if (isTemporarilyMovable.Test(record.entityIndex))
+            rotatingEntities.Set(record.entityIndex);
+    }
+
+    pos low = pos{board.columns, board.rows};
+    pos high = pos{-1, -1};
+    rotatingEntities.ForEachSetBit(numEntities, [&](int i) {
+        low = pos{std::min(low.x, positions[i].x), std::min(low.y, positions[i].y)};
+        high = pos{std::max(high.x, positions[i].x), std::max(high.y, positions[i].y)};
+        return true;
+    });
+
+    if (high.x < 0)
+        return true;
+
+    pos cornerA = GetProjectedPosition(low, pivotPosition, direction);
+    pos cornerB = GetProjectedPosition(high, pivotPosition, direction);
+    pos rotatedLow = pos{std::min(cornerA.x, cornerB.x), std::min(cornerA.y, cornerB.y)};
+    pos rotatedHigh = pos{std::max(cornerA.x, cornerB.x), std::max(cornerA.y, cornerB.y)};
+
+    if (!checkBounds(rotatedLow) || !checkBounds(rotatedHigh))
+        return false;
+
+    assemblyMask.Resize(high.x - low.x + 1, high.y - low.y + 1);
+    rotatingEntities.ForEachSetBit(numEntities, [&](int i) {
+        assemblyMask.Set(pos{positions[i].x - low.x, positions[i].y - low.y});
+        return true;
+    });
+
+    rotatedAssemblyMask.RotateQuarterFrom(assemblyMask, direction - 2);
+
+    int width = rotatedAssemblyMask.Columns();
+    int wordCount = rotatedAssemblyMask.WordsPerRow();
+    occupiedRow.resize(wordCount);
+    assemblyRow.resize(wordCount);
+
+    for (int r = 0; r < rotatedAssemblyMask.Rows(); r++) {
+        int y = rotatedLow.y + r;
+        occupancy.ExtractRow(y, rotatedLow.x, width, occupiedRow.data());
+
+        if (y >= low.y && y <= high.y)
+            assemblyMask.ExtractRow(y - low.y, rotatedLow.x - low.x, width, assemblyRow.data());
+        else
+            std::fill(assemblyRow.begin(), assemblyRow.end(), 0);
+
+        const uint64_t* rotatedRow = rotatedAssemblyMask.Row(r);
+        for (int k = 0; k < wordCount; k++) {
+            if (rotatedRow[k] & occupiedRow[k] & ~assemblyRow[k])
+                return false;
+        }
+    }
+
+    return true;
+}
+
+pos EntityManager::GetProjectedPosition(pos currentPosition, pos pivotPosition, Direction direction) const {
+    int deltaX = currentPosition.x-pivotPosition.x;
+    int deltaY = currentPosition.y-pivotPosition.y;
+    int sign = direction - 2;
+    int deltaRotX = -sign * deltaY;
+    int deltaRotY = sign * deltaX;
+    int x = pivotPosition.x + deltaRotX;
+    int y = pivotPosition.y + deltaRotY;
+    return pos{.x=x, .y=y};
+}
+
+void EntityManager::Rotate(Assembly& assembly, EntityHandle id, Direction direction) 
+{
+    int index = getEntityIndexFromId(id);
+
+    Direction d = static_cast<Direction>((orientations[index] + direction) % 4);
+
+    setEntityTransform(assembly, index, positions[index], d);
+}
+
+void EntityManager::CollectRotationStreams(Assembly& assembly, pos pivotPosition, Direction direction)
+{
+    assembly.rotationEvents.Clear();
+
+    assembly.members.ForEachSetBit(numEntities, [&](int i) {
+        if (positions[i].x == pivotPosition.x && positions[i].y == pivotPosition.y)
             return true;
+
+        pos offset = pos{.x=positions[i].x-pivotPosition.x, .y=positions[i].y-pivotPosition.y};
+        TrajectorySpan span = GetCachedTrajectory(offset, direction);
+        assembly.rotationEvents.AddStream(span);
+        STATS_ADD(assembly.stats, rotationEvents, span.count);
+        return true;
+    });
+}
+
+TrajectorySpan EntityManager::GetCachedTrajectory(pos offset, Direction rotationDirection) 
+{
+    TrajectorySpan span;
+    if (trajectoryCache.Find(offset, rotationDirection, span))
+        return span;
+
+    return trajectoryCache.Insert(offset, rotationDirection, ComputeRelativeTrajectory(offset, rotationDirection));
+}
+
+void EntityManager::PrebuildTrajectoryCache(BoardGeometry extent) 
+{
+    for (int y = 1 - extent.rows; y < extent.rows; y++) {
+        for (int x = 1 - extent.columns; x < extent.columns; x++) {
+            if (x == 0 && y == 0)
+                continue;
+
+            GetCachedTrajectory(pos{.x=x, .y=y}, LEFT);
+            GetCachedTrajectory(pos{.x=x, .y=y}, RIGHT);
+        }
     }
-    return false;
 }
 
-void EntityManager::UpdateAllConnections() 
+std::vector<Push> EntityManager::ComputeRelativeTrajectory(pos offset, Direction rotationDirection)
+{
+    // Walks the tiles the arc through the offset crosses, in doubled coordinates so tile
+    // edges are odd integers. The circle never passes through a tile corner, so the corner
+    // ahead of the current tile decides on which side the arc leaves it: a corner outside
+    // the circle means the arc leaves through the edge nearer the pivot.
+    // Each step enters the next tile at the angle the piece entered the current one.
+    int sign = rotationDirection - 2;
+    pos cell = offset;
+    pos endCell = pos{.x=-offset.y*sign, .y=offset.x*sign};
+    int64_t radiusSquared = 4ll*offset.x*offset.x + 4ll*offset.y*offset.y;
+    BinaryAngle startAngle = BinaryAngleOf(4ll*offset.x*offset.x, 4ll*offset.y*offset.y, offset.x, offset.y);
+    BinaryAngle entryAngle = 0;
+
+    std::vector<Push> pushes;
+
+    while (cell.x != endCell.x || cell.y != endCell.y) {
+        int stepX = -sign * ((cell.y > 0) - (cell.y < 0));
+        int stepY = sign * ((cell.x > 0) - (cell.x < 0));
+
+        bool isStepInX = stepY == 0;
+        if (stepX != 0 && stepY != 0) {
+            int64_t cornerX = 2*cell.x + stepX;
+            int64_t cornerY = 2*cell.y + stepY;
+            bool isCornerOutside = cornerX*cornerX + cornerY*cornerY > radiusSquared;
+            isStepInX = isCornerOutside == (stepX*cell.x < 0);
+        }
+
+        BinaryAngle crossingAngle;
+        Direction direction;
+        if (isStepInX) {
+            int64_t edge = 2*cell.x + stepX;
+            crossingAngle = BinaryAngleOf(edge*edge, radiusSquared - edge*edge, edge > 0 ? 1 : -1, cell.y);
+            direction = stepX > 0 ? RIGHT : LEFT;
+        } else {
+            int64_t edge = 2*cell.y + stepY;
+            crossingAngle = BinaryAngleOf(radiusSquared - edge*edge, edge*edge, cell.x, edge > 0 ? 1 : -1);
+            direction = stepY > 0 ? DOWN : UP;
+        }
+
+        posf fromPosition = posf{static_cast<float>(cell.x), static_cast<float>(cell.y)};
+        pushes.push_back(Push{.priority=entryAngle, .fromPosition=fromPosition, .direction=direction});
+
+        entryAngle = sign > 0 ? crossingAngle - startAngle : startAngle - crossingAngle;
+        cell = isStepInX ? pos{.x=cell.x + stepX, .y=cell.y} : pos{.x=cell.x, .y=cell.y + stepY};
+    }
+    
+    return pushes;
+}
+
+PortMask EntityManager::GetPortsFromId(EntityHandle id) 
+{
+    int index = getEntityIndexFromId(id);
+    if (index < 0)
+        return 0;
+
+    return ports[index];
+}
+
+bool EntityManager::IsAdjacentConnectable(Direction connectionDirection, EntityHandle adjId) 
+{
+    return CanConnectInDirection(adjId, static_cast<Direction>((connectionDirection + 2) % 4));
+}
+
+bool EntityManager::CanConnectInDirection(EntityHandle id, Direction direction) 
+{
+    return GetPortsFromId(id) & PortBit(direction);
+}
+
+void EntityManager::UpdateAllConnections(Assembly& assembly) 
 {
+    TurnJournal& journal = assembly.journal;
+    STATS_START_TIMER(connectionStart);
+    STATS_ADD(assembly.stats, linkRefreshes, journal.tiles.size() + journal.entities.size());
+
+    // only tiles written during the turn can have gained or lost links, the ones whose
+    // occupant changed come first
+    changedTiles.clear();
+    for (const TileRecord& record : journal.tiles) {
+        markChangedTile(record.tileIndex);
+    }
+    size_t writtenCount = changedTiles.size();
+
+    for (const EntityRecord& record : journal.entities) {
+        markChangedTile(getTileIndexFromEntityIndex(record.entityIndex));
+    }
+    refreshChangedLinks();
+
+    for (size_t n = 0; n < writtenCount; n++) {
+        int tileIndex = changedTiles[n];
+        int index = tileToEntityMapping[tileIndex];
+        if (!doesEntityExist(index))
+            continue;
+
+        if (isMovable.Test(index)) {
+            AttachConnected(index);
+            continue;
+        }
+
+        for (int d = 0; d < 4; d++) {
+            if (!(tileLinks[tileIndex] & (1 << d)))
+                continue;
+
+            int adjIndex = getEntityIndexFromPosition(GetAdjacentPosition(positions[index], static_cast<Direction>(d)));
+            if (isMovable.Test(adjIndex))
+                AttachConnected(adjIndex);
+        }
+    }
+
+    UpdateFlow();
+    STATS_ADD_TIME(assembly.stats, connectionMicros, connectionStart);
+}
+
+void EntityManager::RefreshLinksAround(int tileIndex) 
+{
+    // the occupant of the tile may have changed even when its links did not
+    pos position = getPositionFromTileIndex(tileIndex);
+    tileLinks[tileIndex] = ComputeTileLinks(tileIndex);
+    flow.dirtyTiles.push_back(tileIndex);
+
+    for (int d = 0; d < 4; d++) {
+        pos adjPosition = GetAdjacentPosition(position, static_cast<Direction>(d));
+        if (!checkBounds(adjPosition))
+            continue;
+
+        int adjTileIndex = getTileIndexFromPosition(adjPosition);
+        unsigned char links = ComputeTileLinks(adjTileIndex);
+        if (links != tileLinks[adjTileIndex]) {
+            tileLinks[adjTileIndex] = links;
+            flow.dirtyTiles.push_back(adjTileIndex);
+        }
+    }
+}
+
+unsigned char EntityManager::ComputeTileLinks(int tileIndex) 
+{
+    int index = tileToEntityMapping[tileIndex];
+    if (!doesEntityExist(index))
+        return 0;
+
+    // a neighbour's openings turned half way round face back at this tile
+    unsigned char links = 0;
+    PortMask openings = ports[index];
+    pos currentPosition = positions[index];
+
+    for (int d = 0; d < 4; d++) {
+        if (!(openings & PortBit(static_cast<Direction>(d))))
+            continue;
+
+        pos adjPosition = GetAdjacentPosition(currentPosition, static_cast<Direction>(d));
+        if (!checkBounds(adjPosition))
+            continue;
+
+        int adjIndex = getEntityIndexFromPosition(adjPosition);
+        if (doesEntityExist(adjIndex))
+            links |= RotatePorts(ports[adjIndex], 2) & PortBit(static_cast<Direction>(d));
+    }
+
+    return links;
+}
+
+void EntityManager::AttachConnected(int index) 
+{
+    // flood through linked pieces that are not movable yet, so a whole chain joins
+    // the assembly of the piece it touched at once
+    int assemblyIndex = getAssemblyIndexOfEntity(index);
+    if (assemblyIndex < 0)
+        return;
+
+    // an assembly that grows before its turn is applied has to be resolved again
+    Assembly& assembly = assemblies[assemblyIndex];
+    BitSet& members = assembly.members;
+    attachQueue.clear();
+    attachQueue.push_back(index);
+
+    while (!attachQueue.empty()) {
+        int current = attachQueue.back();
+        attachQueue.pop_back();
+
+        int tileIndex = getTileIndexFromEntityIndex(current);
+        for (int d = 0; d < 4; d++) {
+            if (!(tileLinks[tileIndex] & (1 << d)))
+                continue;
+
+            int adjIndex = getEntityIndexFromPosition(GetAdjacentPosition(positions[current], static_cast<Direction>(d)));
+            if (isMovable.Test(adjIndex))
+                continue;
+
+            hash ^= pieceKey(adjIndex);
+            isMovable.Set(adjIndex);
+            hash ^= pieceKey(adjIndex);
+            members.Set(adjIndex);
+            attachments.push_back(AttachRecord{adjIndex, assemblyIndex});
+            assembly.isResolved = false;
+            attachQueue.push_back(adjIndex);
+        }
+    }
+}
+
+uint64_t EntityManager::ComputeHash() const
+{
+    uint64_t fullHash = ZobristBoardKey(board);
     for (int i = 0; i < numEntities; i++) {
-        if (!isMovable[i])
+        fullHash ^= pieceKey(i);
+    }
+    return fullHash;
+}
+
+const FlowStatus& EntityManager::EvaluateFlow() 
+{
+    UpdateFlow();
+    return flow.status;
+}
+
+void EntityManager::UpdateFlow() 
+{
+    // The components the dirty tiles belonged to are retired and new ones are labelled
+    // by walking the links out of the dirty tiles. A retired component can only have
+    // split across a changed link, and both ends of a changed link are dirty, so the
+    // walks reach every tile that carried a retired label.
+    if (flow.dirtyTiles.empty())
+        return;
+
+    for (int tileIndex : flow.dirtyTiles) {
+        flow.Retire(flow.componentOfTile[tileIndex]);
+    }
+
+    for (int tileIndex : flow.dirtyTiles) {
+        int label = flow.componentOfTile[tileIndex];
+        if (label >= 0 && flow.components[label].isNew)
             continue;
 
-        int currentId = ids[i];
-        UpdateCurrentConnections(currentId);
+        // a piece without links is a component of its own, never a path or a loop, and
+        // no walk reaches it, so it stays unlabelled until it gains a link
+        if (!doesEntityExist(tileToEntityMapping[tileIndex]) || tileLinks[tileIndex] == 0) {
+            flow.componentOfTile[tileIndex] = -1;
+            continue;
+        }
+
+        int id = flow.Allocate();
+        FlowComponent& component = flow.components[id];
+        flow.componentOfTile[tileIndex] = id;
+        flow.queue.clear();
+        flow.queue.push_back(tileIndex);
+
+        while (!flow.queue.empty()) {
+            int current = flow.queue.back();
+            flow.queue.pop_back();
+
+            int index = tileToEntityMapping[current];
+            unsigned char links = tileLinks[current];
+            component.pieces++;
+            component.linkEnds += __builtin_popcount(links);
+            component.sources += types[index] == EntityType::SOURCE;
+            component.sinks += types[index] == EntityType::SINK;
+
+            pos position = getPositionFromTileIndex(current);
+            for (int d = 0; d < 4; d++) {
+                if (!(links & (1 << d)))
+                    continue;
+
+                int adjTileIndex = getTileIndexFromPosition(GetAdjacentPosition(position, static_cast<Direction>(d)));
+                int adjLabel = flow.componentOfTile[adjTileIndex];
+                if (adjLabel == id)
+                    continue;
+
+                flow.Retire(adjLabel);
+                flow.componentOfTile[adjTileIndex] = id;
+                flow.queue.push_back(adjTileIndex);
+            }
+        }
     }
+
+    flow.FinishUpdate();
 }
 
-void EntityManager::UpdateRotations(RotationCounts& rotation) {
-    rotation.rightRotations+=pendingRotation.rightRotations;
-    rotation.leftRotations+=pendingRotation.leftRotations;
+void EntityManager::UpdateRotations(Assembly& assembly) {
+    assembly.rotationCounts.rightRotations+=assembly.pendingRotation.rightRotations;
+    assembly.rotationCounts.leftRotations+=assembly.pendingRotation.leftRotations;
     
 }
 
-int EntityManager::getSmallestAvailableID() {
-    bool isIdAvailable[NUMBER_OF_TILES];
-    std::fill(isIdAvailable, isIdAvailable+NUMBER_OF_TILES, true);
+const MoveResult& EntityManager::EvaluateMove(const MoveQuery& query, MoveScratch& scratch) const
+{
+    // Resolves the move as RunTurn would, but every write goes to the scratch: the sweep
+    // overlay of its assembly ends up holding the tiles the move changes, and links and
+    // attachments are then worked out on that overlay.
+    MoveResult& result = scratch.result;
+    result.isOk = true;
+    result.collisionAngle = BINARY_QUARTER_TURN;
+    result.placements.clear();
+    result.connectedEntities.clear();
+
+    if (query.assemblyIndex < 0 || query.assemblyIndex >= static_cast<int>(assemblies.size())) {
+        result.isOk = false;
+        result.collisionAngle = 0;
+        return result;
+    }
 
-    for (int i = 0; i < numEntities; i++)
-    {
-        isIdAvailable[ids[i]] = false;
+    if (scratch.attached.Size() != maxNumEntities)
+        scratch.Resize(maxNumEntities, maxNumEntities);
+
+    Assembly& assembly = scratch.assembly;
+    SweepScratch& sweep = assembly.sweep;
+    const Assembly& source = assemblies[query.assemblyIndex];
+    assembly.pivot = source.pivot;
+    assembly.members.CopyFrom(source.members, numEntities);
+    assembly.rotatingEntities.ClearAll(numEntities);
+    scratch.writtenTiles.clear();
+
+    if (!query.isRotation) {
+        if (translationBackend == TranslationBackend::BITBOARD)
+            ResolveTranslationOnBitboards(assembly, query.direction);
+        else
+            ResolvePushChains(assembly, query.direction);
+
+        result.isOk = assembly.isTurnOk;
+        if (!result.isOk)
+            return result;
+
+        sweep.Reset();
+        for (int index : assembly.chainEntities) {
+            int tileIndex = getTileIndexFromEntityIndex(index);
+            sweepVacate(sweep, tileIndex);
+            scratch.writtenTiles.push_back(tileIndex);
+        }
+
+        for (int index : assembly.chainEntities) {
+            pos adjacentPosition = GetAdjacentPosition(positions[index], query.direction);
+            int tileIndex = getTileIndexFromPosition(adjacentPosition);
+            sweepPlace(sweep, index, tileIndex);
+            scratch.writtenTiles.push_back(tileIndex);
+            result.placements.push_back(EntityPlacement{index, adjacentPosition, orientations[index]});
+        }
+
+        evaluateConnections(scratch, 0);
+        return result;
     }
 
-    for (int i = 0; i < NUMBER_OF_TILES; i++) {
-        if (isIdAvailable[i])
-            return i;
+    pos pivotPosition;
+    if (!getPivotPosition(assembly, pivotPosition))
+        return result;
+
+    collectEvaluatedStreams(scratch, pivotPosition, query.direction);
+    const CollisionResult& collision = SweepRotation(assembly, scratch.trajectories.data(), scratch.steps.data(), pivotPosition);
+
+    if (!collision.canComplete) {
+        result.isOk = false;
+        result.collisionAngle = collision.maximumAngle;
+        return result;
     }
 
-    return -1;
+    if (!placeEvaluatedRotation(scratch, pivotPosition, query.direction)) {
+        result.isOk = false;
+        result.placements.clear();
+        return result;
+    }
+
+    // a quarter turn to the left adds one to an orientation, one to the right adds three
+    evaluateConnections(scratch, query.direction);
+    return result;
 }
 
-int EntityManager::getEntityIndexFromId(int id) 
+void EntityManager::collectEvaluatedStreams(MoveScratch& scratch, pos pivotPosition, Direction direction) const
 {
-    for (int i = 0; i < numEntities; i++)
-    {
-        if (ids[i] == id)
-            return i;
+    // CollectRotationStreams without growing the shared cache, trajectories it lacks
+    // are computed here, and every stream is copied so the merge reads one array
+    Assembly& assembly = scratch.assembly;
+    std::vector<Push>& trajectories = scratch.trajectories;
+    std::vector<TrajectoryStep>& steps = scratch.steps;
+    assembly.rotationEvents.Clear();
+    trajectories.clear();
+    steps.clear();
+
+    assembly.members.ForEachSetBit(numEntities, [&](int i) {
+        if (positions[i].x == pivotPosition.x && positions[i].y == pivotPosition.y)
+            return true;
+
+        pos offset = pos{.x=positions[i].x-pivotPosition.x, .y=positions[i].y-pivotPosition.y};
+        int first = trajectories.size();
+        TrajectorySpan span;
+        if (trajectoryCache.Find(offset, direction, span)) {
+            const Push* cached = trajectoryCache.Data() + span.first;
+            const TrajectoryStep* cachedSteps = trajectoryCache.Steps() + span.first;
+            trajectories.insert(trajectories.end(), cached, cached + span.count);
+            steps.insert(steps.end(), cachedSteps, cachedSteps + span.count);
+        } else {
+            std::vector<Push> computed = ComputeRelativeTrajectory(offset, direction);
+            trajectories.insert(trajectories.end(), computed.begin(), computed.end());
+            span.reach = TrajectoryCache::AppendSteps(computed.data(), computed.data() + computed.size(), steps);
+        }
+
+        span = TrajectorySpan{first, static_cast<int>(trajectories.size()) - first, span.reach};
+        assembly.rotationEvents.AddStream(span);
+        STATS_ADD(assembly.stats, rotationEvents, span.count);
+        return true;
+    });
+}
+
+bool EntityManager::placeEvaluatedRotation(MoveScratch& scratch, pos pivotPosition, Direction direction) const
+{
+    // ApplySweptPushes and RotateMovables on the overlay, which already holds the pushes.
+    // Every turning piece is lifted first, so a destination that is not free holds a
+    // piece that stays, the tile by tile form of the CanPlaceRotation check.
+    Assembly& assembly = scratch.assembly;
+    SweepScratch& sweep = assembly.sweep;
+    BitSet& rotatingEntities = assembly.rotatingEntities;
+    MoveResult& result = scratch.result;
+
+    rotatingEntities.CopyFrom(assembly.members, numEntities);
+    for (const SweptEntity& pushed : assembly.collision.pushedEntities) {
+        scratch.writtenTiles.push_back(getTileIndexFromEntityIndex(pushed.entityIndex));
+        scratch.writtenTiles.push_back(pushed.tileIndex);
+
+        if (pushed.isTemporarilyMovable)
+            rotatingEntities.Set(pushed.entityIndex);
+        else
+            result.placements.push_back(EntityPlacement{pushed.entityIndex, getPositionFromTileIndex(pushed.tileIndex),
+                                                        orientations[pushed.entityIndex]});
+    }
+
+    rotatingEntities.ForEachSetBit(numEntities, [&](int i) {
+        int tileIndex = sweepEntityTile(sweep, i);
+        sweepVacate(sweep, tileIndex);
+        scratch.writtenTiles.push_back(tileIndex);
+        return true;
+    });
+
+    return rotatingEntities.ForEachSetBit(numEntities, [&](int i) {
+        pos projectedPosition = GetProjectedPosition(getPositionFromTileIndex(sweepEntityTile(sweep, i)), pivotPosition, direction);
+        if (!checkBounds(projectedPosition))
+            return false;
+
+        int tileIndex = getTileIndexFromPosition(projectedPosition);
+        if (sweepOccupant(sweep, tileIndex) >= 0)
+            return false;
+
+        sweepPlace(sweep, i, tileIndex);
+        scratch.writtenTiles.push_back(tileIndex);
+        result.placements.push_back(EntityPlacement{i, projectedPosition, static_cast<Direction>((orientations[i] + direction) % 4)});
+        return true;
+    });
+}
+
+void EntityManager::evaluateConnections(MoveScratch& scratch, int quarterTurns) const
+{
+    // UpdateAllConnections on the overlay. Links are worked out where they are read,
+    // away from the written tiles they are the ones in tileLinks.
+    SweepScratch& sweep = scratch.assembly.sweep;
+    BitSet& attached = scratch.attached;
+
+    for (int tileIndex : scratch.writtenTiles) {
+        int index = sweepOccupant(sweep, tileIndex);
+        if (!doesEntityExist(index))
+            continue;
+
+        if (isMovable.Test(index) || attached.Test(index)) {
+            evaluateAttach(scratch, index, quarterTurns);
+            continue;
+        }
+
+        unsigned char links = evaluateTileLinks(scratch, tileIndex, quarterTurns);
+        pos position = getPositionFromTileIndex(tileIndex);
+        for (int d = 0; d < 4; d++) {
+            if (!(links & (1 << d)))
+                continue;
+
+            int adjIndex = sweepOccupant(sweep, getTileIndexFromPosition(GetAdjacentPosition(position, static_cast<Direction>(d))));
+            if (isMovable.Test(adjIndex) || attached.Test(adjIndex))
+                evaluateAttach(scratch, adjIndex, quarterTurns);
+        }
+    }
+
+    for (int index : scratch.result.connectedEntities) {
+        attached.Reset(index);
+    }
+}
+
+void EntityManager::evaluateAttach(MoveScratch& scratch, int index, int quarterTurns) const
+{
+    // AttachConnected with the pieces it would attach kept in the scratch
+    SweepScratch& sweep = scratch.assembly.sweep;
+    BitSet& attached = scratch.attached;
+    std::vector<int>& queue = scratch.attachQueue;
+
+    if (!attached.Test(index) && getAssemblyIndexOfEntity(index) < 0)
+        return;
+
+    queue.clear();
+    queue.push_back(index);
+
+    while (!queue.empty()) {
+        int current = queue.back();
+        queue.pop_back();
+
+        int tileIndex = sweepEntityTile(sweep, current);
+        unsigned char links = evaluateTileLinks(scratch, tileIndex, quarterTurns);
+        pos position = getPositionFromTileIndex(tileIndex);
+        for (int d = 0; d < 4; d++) {
+            if (!(links & (1 << d)))
+                continue;
+
+            int adjIndex = sweepOccupant(sweep, getTileIndexFromPosition(GetAdjacentPosition(position, static_cast<Direction>(d))));
+            if (isMovable.Test(adjIndex) || attached.Test(adjIndex))
+                continue;
+
+            attached.Set(adjIndex);
+            scratch.result.connectedEntities.push_back(adjIndex);
+            queue.push_back(adjIndex);
+        }
+    }
+}
+
+unsigned char EntityManager::evaluateTileLinks(MoveScratch& scratch, int tileIndex, int quarterTurns) const
+{
+    // ComputeTileLinks on the overlay
+    SweepScratch& sweep = scratch.assembly.sweep;
+    int index = sweepOccupant(sweep, tileIndex);
+    if (!doesEntityExist(index))
+        return 0;
+
+    unsigned char links = 0;
+    PortMask openings = evaluatedPorts(scratch, index, quarterTurns);
+    pos currentPosition = getPositionFromTileIndex(tileIndex);
+
+    for (int d = 0; d < 4; d++) {
+        if (!(openings & PortBit(static_cast<Direction>(d))))
+            continue;
+
+        pos adjPosition = GetAdjacentPosition(currentPosition, static_cast<Direction>(d));
+        if (!checkBounds(adjPosition))
+            continue;
+
+        int adjIndex = sweepOccupant(sweep, getTileIndexFromPosition(adjPosition));
+        if (doesEntityExist(adjIndex))
+            links |= RotatePorts(evaluatedPorts(scratch, adjIndex, quarterTurns), 2) & PortBit(static_cast<Direction>(d));
+    }
+
+    return links;
+}
+
+PortMask EntityManager::evaluatedPorts(const MoveScratch& scratch, int index, int quarterTurns) const
+{
+    if (scratch.assembly.rotatingEntities.Test(index))
+        return RotatePorts(ports[index], quarterTurns);
+
+    return ports[index];
+}
+
+int EntityManager::sweepOccupant(SweepScratch& sweep, int tileIndex) const
+{
+    int occupant = sweep.tileOccupants[tileIndex];
+    if (occupant != SWEEP_UNTOUCHED)
+        return occupant;
+
+    sweep.boardReads.push_back(tileIndex);
+    return tileToEntityMapping[tileIndex];
+}
+
+int EntityManager::sweepEntityTile(SweepScratch& sweep, int index) const
+{
+    int tileIndex = sweep.entityTiles[index];
+    return tileIndex < 0 ? getTileIndexFromEntityIndex(index) : tileIndex;
+}
+
+void EntityManager::sweepTouchTile(SweepScratch& sweep, int tileIndex) const
+{
+    if (sweep.tileOccupants[tileIndex] == SWEEP_UNTOUCHED && !sweep.isTileSwept[tileIndex])
+        sweep.touchedTiles.push_back(tileIndex);
+}
+
+void EntityManager::sweepMove(SweepScratch& sweep, int index, int tileIndex) const
+{
+    sweepVacate(sweep, sweepEntityTile(sweep, index));
+    sweepPlace(sweep, index, tileIndex);
+}
+
+void EntityManager::sweepVacate(SweepScratch& sweep, int tileIndex) const
+{
+    sweepTouchTile(sweep, tileIndex);
+    sweep.tileOccupants[tileIndex] = -1;
+}
+
+void EntityManager::sweepPlace(SweepScratch& sweep, int index, int tileIndex) const
+{
+    if (sweep.entityTiles[index] < 0 && !sweep.isEntityTemporarilyMovable[index])
+        sweep.touchedEntities.push_back(index);
+
+    sweepTouchTile(sweep, tileIndex);
+    sweep.tileOccupants[tileIndex] = index;
+    sweep.entityTiles[index] = tileIndex;
+}
+
+bool EntityManager::sweepPushChain(Assembly& assembly, int index, Direction direction) const
+{
+    // Collect the run of obstacles in front of the push. It moves one tile if it ends
+    // in a free tile. It stays in place if it ends against a piece of the assembly, and
+    // then the last obstacle is carried along with the rotation.
+    SweepScratch& sweep = assembly.sweep;
+    sweep.chain.clear();
+    int current = index;
+
+    while (true) {
+        sweep.chain.push_back(current);
+        STATS_MAX(assembly.stats, longestPushChain, sweep.chain.size());
+
+        pos nextPosition = GetAdjacentPosition(getPositionFromTileIndex(sweepEntityTile(sweep, current)), direction);
+        if (!checkBounds(nextPosition))
+            return false;
+
+        int next = sweepOccupant(sweep, getTileIndexFromPosition(nextPosition));
+        if (next < 0)
+            break;
+
+        if (assembly.members.Test(next)) {
+            if (sweep.entityTiles[current] < 0 && !sweep.isEntityTemporarilyMovable[current])
+                sweep.touchedEntities.push_back(current);
+            sweep.isEntityTemporarilyMovable[current] = true;
+            return true;
+        }
+
+        current = next;
+    }
+
+    for (auto it = sweep.chain.rbegin(); it != sweep.chain.rend(); ++it) {
+        pos nextPosition = GetAdjacentPosition(getPositionFromTileIndex(sweepEntityTile(sweep, *it)), direction);
+        sweepMove(sweep, *it, getTileIndexFromPosition(nextPosition));
+    }
+
+    return true;
+}
+
+bool EntityManager::getPivotPosition(const Assembly& assembly, pos& position) const
+{
+    int index = getEntityIndexFromId(assembly.pivot);
+    if (index < 0)
+        return false;
+
+    position = positions[index];
+    return true;
+}
+
+int EntityManager::getAssemblyIndexOfEntity(int index) const
+{
+    for (int k = 0; k < assemblies.size(); k++) {
+        if (assemblies[k].members.Test(index))
+            return k;
     }
     return -1;
 }
 
-int EntityManager::getEntityIndexFromPosition(pos position) 
+void EntityManager::computeSweptRegion(Assembly& assembly, bool isRotation) 
+{
+    // tiles the assembly's own pieces pass over, pushed runs reaching further out
+    // are caught when the footprint is checked
+    pos low = pos{board.columns, board.rows};
+    pos high = pos{-1, -1};
+    assembly.members.ForEachSetBit(numEntities, [&](int i) {
+        low = pos{std::min(low.x, positions[i].x), std::min(low.y, positions[i].y)};
+        high = pos{std::max(high.x, positions[i].x), std::max(high.y, positions[i].y)};
+        return true;
+    });
+
+    pos pivotPosition;
+    if (high.x < 0 || (isRotation && !getPivotPosition(assembly, pivotPosition))) {
+        assembly.regionLow = pos{0, 0};
+        assembly.regionHigh = pos{-1, -1};
+        return;
+    }
+
+    if (isRotation) {
+        int reachX = std::max(std::abs(low.x - pivotPosition.x), std::abs(high.x - pivotPosition.x));
+        int reachY = std::max(std::abs(low.y - pivotPosition.y), std::abs(high.y - pivotPosition.y));
+        int radius = static_cast<int>(ceil(sqrt(static_cast<float>(reachX * reachX + reachY * reachY))));
+        low = pos{pivotPosition.x - radius, pivotPosition.y - radius};
+        high = pos{pivotPosition.x + radius, pivotPosition.y + radius};
+    }
+
+    assembly.regionLow = pos{low.x - 1, low.y - 1};
+    assembly.regionHigh = pos{high.x + 1, high.y + 1};
+}
+
+void EntityManager::recordFootprint(Assembly& assembly, Direction direction, bool isRotation) 
+{
+    std::vector<int>& footprint = assembly.footprint;
+    footprint.clear();
+
+    if (isRotation) {
+        footprint.insert(footprint.end(), assembly.sweep.boardReads.begin(), assembly.sweep.boardReads.end());
+        assembly.members.ForEachSetBit(numEntities, [&](int i) {
+            footprint.push_back(getTileIndexFromEntityIndex(i));
+            return true;
+        });
+        return;
+    }
+
+    // a translation reads every tile of its runs and the tile ahead of each
+    for (int index : assembly.chainEntities) {
+        footprint.push_back(getTileIndexFromEntityIndex(index));
+        pos adjacentPosition = GetAdjacentPosition(positions[index], direction);
+        if (checkBounds(adjacentPosition))
+            footprint.push_back(getTileIndexFromPosition(adjacentPosition));
+    }
+}
+
+bool EntityManager::readsWrittenTiles(const Assembly& assembly) 
+{
+    for (int tileIndex : assembly.footprint) {
+        if (writtenTiles.Test(tileIndex))
+            return true;
+    }
+    return false;
+}
+
+#ifdef PIPE_STATS
+void EntityManager::recordTurnStats(StatsClock::time_point turnStart)
+{
+    TurnStats& turn = stats.lastTurn;
+    turn = TurnStats{};
+
+    for (Assembly& assembly : assemblies) {
+        assembly.stats.movedPieces = assembly.journal.movedEntities.size();
+        assembly.stats.blockedAssemblies = !assembly.isTurnOk;
+        turn.Add(assembly.stats);
+    }
+    turn.turnMicros = MicrosecondsSince(turnStart);
+
+    stats.totals.Add(turn);
+    stats.turns++;
+    stats.blockedTurns += !isTurnOk;
+    stats.turnMicros.Add(turn.turnMicros);
+}
+#endif
+
+uint64_t EntityManager::pieceKey(int index) const
+{
+    return ZobristPieceKey(positions[index], PackTile(types[index], orientations[index], isMovable.Test(index)));
+}
+
+void EntityManager::setEntityPosition(Assembly& assembly, int index, pos position) 
+{
+    assembly.journal.entities.push_back(EntityRecord{index, positions[index], orientations[index]});
+    hash ^= pieceKey(index);
+    positions[index] = position;
+    hash ^= pieceKey(index);
+}
+
+void EntityManager::setEntityTransform(Assembly& assembly, int index, pos position, Direction orientation) 
+{
+    assembly.journal.entities.push_back(EntityRecord{index, positions[index], orientations[index]});
+    hash ^= pieceKey(index);
+    positions[index] = position;
+    ports[index] = RotatePorts(ports[index], orientation - orientations[index]);
+    orientations[index] = orientation;
+    hash ^= pieceKey(index);
+}
+
+void EntityManager::setTileMapping(Assembly& assembly, pos position, int entityIndex) 
 {
     int tileIndex = getTileIndexFromPosition(position);
-    return tileToEntityMapping[tileIndex];
+    assembly.journal.tiles.push_back(TileRecord{tileIndex, tileToEntityMapping[tileIndex]});
+    tileToEntityMapping[tileIndex] = entityIndex;
+    occupancy.Assign(position, entityIndex >= 0);
 }
 
-int EntityManager::getTileIndexFromPosition(pos position) 
+void EntityManager::markMoved(Assembly& assembly, int index, posf deltaPosition) 
 {
-    if (!checkBounds(position)) {
-        return -1;
+    if (!hasMoved.Test(index))
+        assembly.journal.movedEntities.push_back(index);
+
+    hasMoved.Set(index);
+    deltaPositions[index] = deltaPosition;
+}
+
+void EntityManager::markPushed(Assembly& assembly, int index) 
+{
+    if (!gotPushed.Test(index))
+        assembly.pushedEntities.push_back(EntityRecord{index, positions[index], orientations[index]});
+
+    gotPushed.Set(index);
+}
+
+void EntityManager::refreshRegionLinks(BoardRegion region) 
+{
+    // RefreshLinksAround for a whole region: any tile inside may have a new occupant,
+    // the ring around it can only have gained or lost links
+    pos low = pos{std::max(region.low.x - 1, 0), std::max(region.low.y - 1, 0)};
+    pos high = pos{std::min(region.low.x + region.columns, board.columns - 1),
+                   std::min(region.low.y + region.rows, board.rows - 1)};
+
+    for (int y = low.y; y <= high.y; y++) {
+        for (int x = low.x; x <= high.x; x++) {
+            int tileIndex = getTileIndexFromPosition(pos{x, y});
+            unsigned char links = ComputeTileLinks(tileIndex);
+            bool isInside = x >= region.low.x && x < region.low.x + region.columns &&
+                            y >= region.low.y && y < region.low.y + region.rows;
+
+            if (isInside || links != tileLinks[tileIndex]) {
+                tileLinks[tileIndex] = links;
+                flow.dirtyTiles.push_back(tileIndex);
+            }
+        }
     }
-         
-    int index = position.x + position.y * TILES_COLUMNS;
-    return index;
 }
 
-int EntityManager::getTileIndexFromEntityIndex(int i) 
+void EntityManager::markChangedTile(int tileIndex)
+{
+    if (refreshedTiles.Test(tileIndex))
+        return;
+
+    refreshedTiles.Set(tileIndex);
+    changedTiles.push_back(tileIndex);
+}
+
+void EntityManager::refreshChangedLinks()
+{
+    // RefreshLinksAround for every changed tile, working out each tile and neighbour once
+    // however many times the turn wrote it. The neighbours are listed after the changed tiles.
+    size_t changedCount = changedTiles.size();
+    for (int tileIndex : changedTiles) {
+        tileLinks[tileIndex] = ComputeTileLinks(tileIndex);
+        flow.dirtyTiles.push_back(tileIndex);
+    }
+
+    for (size_t n = 0; n < changedCount; n++) {
+        pos position = getPositionFromTileIndex(changedTiles[n]);
+        for (int d = 0; d < 4; d++) {
+            pos adjPosition = GetAdjacentPosition(position, static_cast<Direction>(d));
+            if (!checkBounds(adjPosition))
+                continue;
+
+            int adjTileIndex = getTileIndexFromPosition(adjPosition);
+            if (refreshedTiles.Test(adjTileIndex))
+                continue;
+
+            refreshedTiles.Set(adjTileIndex);
+            changedTiles.push_back(adjTileIndex);
+            unsigned char links = ComputeTileLinks(adjTileIndex);
+            if (links != tileLinks[adjTileIndex]) {
+                tileLinks[adjTileIndex] = links;
+                flow.dirtyTiles.push_back(adjTileIndex);
+            }
+        }
+    }
+
+    for (int tileIndex : changedTiles) {
+        refreshedTiles.Reset(tileIndex);
+    }
+}
+
+void EntityManager::refreshEntityLinks()
+{
+    // Every piece's tile starts without links. A link joins two openings facing each
+    // other, so it is found once from its left or upper end and set on both tiles.
+    static const Direction forward[2] = {RIGHT, DOWN};
+
+    for (int i = 0; i < static_cast<int>(numEntities); i++) {
+        int tileIndex = getTileIndexFromEntityIndex(i);
+        flow.dirtyTiles.push_back(tileIndex);
+
+        for (Direction direction : forward) {
+            if (!(ports[i] & PortBit(direction)))
+                continue;
+
+            pos adjPosition = GetAdjacentPosition(positions[i], direction);
+            if (!checkBounds(adjPosition))
+                continue;
+
+            int adjTileIndex = getTileIndexFromPosition(adjPosition);
+            int adjIndex = tileToEntityMapping[adjTileIndex];
+            if (doesEntityExist(adjIndex) && (RotatePorts(ports[adjIndex], 2) & PortBit(direction))) {
+                tileLinks[tileIndex] |= PortBit(direction);
+                tileLinks[adjTileIndex] |= PortBit(static_cast<Direction>((direction + 2) % 4));
+            }
+        }
+    }
+}
+
+void EntityManager::removeEntityIndex(int i) 
+{
+    // move last entity to index of deleted, the key of a piece does not depend on its index
+    hash ^= pieceKey(i);
+    int last = numEntities - 1;
+    if (i != last) {
+        ids[i] = ids[last];
+        types[i] = types[last];
+        positions[i] = positions[last];
+        orientations[i] = orientations[last];
+        ports[i] = ports[last];
+        isMovable.Assign(i, isMovable.Test(last));
+        isTemporarilyMovable.Assign(i, isTemporarilyMovable.Test(last));
+        gotPushed.Assign(i, gotPushed.Test(last));
+        hasMoved.Assign(i, hasMoved.Test(last));
+        deltaPositions[i] = deltaPositions[last];
+
+        slotToEntityIndex[ids[i].slot] = i;
+        tileToEntityMapping[getTileIndexFromEntityIndex(i)] = i;
+    }
+
+    isMovable.Reset(last);
+    isTemporarilyMovable.Reset(last);
+    gotPushed.Reset(last);
+    hasMoved.Reset(last);
+
+    for (Assembly& assembly : assemblies) {
+        if (i != last)
+            assembly.members.Assign(i, assembly.members.Test(last));
+        assembly.members.Reset(last);
+    }
+
+    // decrement number of entities
+    numEntities--;
+}
+
+EntityHandle EntityManager::allocateHandle(int entityIndex) 
+{
+    unsigned int slot = freeSlots.back();
+    freeSlots.pop_back();
+
+    slotToEntityIndex[slot] = entityIndex;
+    return EntityHandle{slot, slotGenerations[slot]};
+}
+
+void EntityManager::releaseHandle(EntityHandle id) 
+{
+    slotToEntityIndex[id.slot] = -1;
+    slotGenerations[id.slot]++;
+    freeSlots.push_back(id.slot);
+}
+
+int EntityManager::getEntityIndexFromPosition(pos position) const
+{
+    int tileIndex = getTileIndexFromPosition(position);
+    return tileToEntityMapping[tileIndex];
+}
+
+int EntityManager::getTileIndexFromEntityIndex(int i) const
 {
     pos position = positions[i];
     return getTileIndexFromPosition(position);
 }
 
-bool EntityManager::checkBounds(pos position) 
+pos EntityManager::getPositionFromTileIndex(int tileIndex) const
 {
-    return (position.x >= 0) &&
-        (position.y >= 0) &&
-        (position.x <= TILES_COLUMNS - 1) &&
-        (position.y <= TILES_ROWS - 1);
+    return board.PositionFromTileIndex(tileIndex);
 }
\ No newline at end of file
@@ -1,6 +1,34 @@
 #pragma once
 
-#include "common.h"
+#include "SimulationTypes.h"
+#include "Board.h"
+#include "BoardRegion.h"
+#include "BitSet.h"
+#include "Bitboard.h"
+#include "EntityHandle.h"
+#include "Assembly.h"
+#include "MoveEvaluation.h"
+#include "TurnJournal.h"
+#include "TrajectoryCache.h"
+#include "CollisionSweep.h"
+#include "FlowState.h"
+#include "Ports.h"
+#include "TurnStats.h"
+#include "Zobrist.h"
+
+#include <vector>
+
+// worker threads need pthreads under Emscripten
+#if !defined(__EMSCRIPTEN__) || defined(__EMSCRIPTEN_PTHREADS__)
+#define PARALLEL_ASSEMBLIES
+#endif
+
+// how MoveAllToAdjacent finds the pieces a translation moves, both take about as long
+// per turn, see BitboardTranslator for where bitboards pay off
+enum class TranslationBackend {
+    PUSH_CHAINS,
+    BITBOARD
+};
 
 struct move {
     int entityIndex;
@@ -13,76 +41,237 @@ class EntityManager {
     unsigned int maxNumEntities;
     unsigned int numEntities;
 
+    BoardGeometry board;
+#ifdef PIPE_SHIPPED_BOARD
+    // built for the shipped board alone, index math folds to constants
+    static constexpr bool isShippedBoard = true;
+#else
+    bool isShippedBoard;
+#endif
+
     // identity
-    int ids[NUMBER_OF_TILES];
-    EntityType types[NUMBER_OF_TILES];
-    bool isMovable[NUMBER_OF_TILES];
-    bool isTemporarilyMovable[NUMBER_OF_TILES];
-    bool gotPushed[NUMBER_OF_TILES];
-    bool hasMoved[NUMBER_OF_TILES];
+    std::vector<EntityHandle> ids;
+    std::vector<int> slotToEntityIndex;
+    std::vector<unsigned int> slotGenerations;
+    std::vector<unsigned int> freeSlots;
+    std::vector<EntityType> types;
+
+    // flags, one bit per entity index, bits at and past numEntities stay clear
+    BitSet isMovable;
+    BitSet isTemporarilyMovable;
+    BitSet gotPushed;
+    BitSet hasMoved;
 
     // transform
-    pos positions[NUMBER_OF_TILES];
-    pos positionsBackup[NUMBER_OF_TILES];
-    Direction orientations[NUMBER_OF_TILES];
-    Direction orientationsBackup[NUMBER_OF_TILES];
-    int tileToEntityMapping[NUMBER_OF_TILES];
-    int tileToEntityMappingBackup[NUMBER_OF_TILES];
-    posf deltaPositions[NUMBER_OF_TILES];
-
-    RotationCounts rotationCounts = RotationCounts{0,0};
-    RotationCounts pendingRotation = RotationCounts{0,0};
-    float partialRotationAngle = 0.0f;
-    int partialRotationSign = 0;
-
-    bool isTurnOk;
-    bool isRotationOk;
+    std::vector<pos> positions;
+    std::vector<Direction> orientations;
+    std::vector<int> tileToEntityMapping;
+    Bitboard occupancy;
+    std::vector<posf> deltaPositions;
+
+    // connectivity, the openings of every entity and the links of every tile,
+    // bit d of a tile is set when its occupant connects to the neighbor in direction d
+    std::vector<PortMask> ports;
+    std::vector<unsigned char> tileLinks;
+    std::vector<int> attachQueue;
+    std::vector<int> regionEntities;
+    std::vector<AttachRecord> attachments;
+    // tiles a turn or its undo wrote, each listed once, and then their neighbours
+    std::vector<int> changedTiles;
+    BitSet refreshedTiles;
+
+    // sources joined to sinks and closed loops, relabelled where links change
+    FlowState flow;
+
+    TranslationBackend translationBackend = TranslationBackend::PUSH_CHAINS;
+    TrajectoryCache trajectoryCache;
+
+    // independently controlled assemblies, every turn moves all of them and the first
+    // one is the player's, whose pivot and rotation the renderer follows
+    std::vector<Assembly> assemblies;
+
+    // assemblies clear of each other are resolved on up to workerCount threads,
+    // once they hold at least parallelMinimumMembers pieces between them. One by
+    // default, AssemblyBenchmark has yet to show more threads winning on a turn.
+    int workerCount = 1;
+    int parallelMinimumMembers = 1024;
+    std::vector<int> independentAssemblies;
+    BitSet writtenTiles;
+
+    // every assembly completed its part of the last turn
+    bool isTurnOk = true;
+
+    // Zobrist hash of every piece's type, position, orientation and movable flag, kept
+    // up to date by every write and rolled back with the turn by AbortTurn. Build with
+    // -DPIPE_VERIFY_HASH to check it against ComputeHash after every turn.
+    uint64_t hash = 0;
+
+#ifdef PIPE_STATS
+    // counters of the last turn, running totals and the durations of recent turns
+    PipeStats stats = {};
+#endif
 
     EntityManager();
+    explicit EntityManager(BoardGeometry geometry);
 
+    void LoadBoard(BoardGeometry geometry);
     void Initialize();
-    void InitializeTurn();
-    void InitializeRotation();
-    void FinalizeTurn();
-    void AbortTurn();
-    void AddEntity(EntityType type, pos position, bool isMovable, Direction orientation);
-    void DeleteEntity(int id);
+    int AddAssembly();
+    void InitializeTurn(Assembly& assembly);
+    void InitializeRotation(Assembly& assembly);
+    void FinalizeTurn(Assembly& assembly);
+    void AbortTurn(Assembly& assembly);
+    EntityHandle AddEntity(EntityType type, pos position, bool isMovable, Direction orientation, int assemblyIndex = 0);
+    void DeleteEntity(EntityHandle id);
     void DeleteEntity(pos position); 
 
-    void MoveEntity(int id, pos position);
+    // whole regions at once, for paging parts of a large board in and out
+    int InsertRegion(BoardRegion region, const PackedTile* tiles, int assemblyIndex = 0);
+    int RemoveRegion(BoardRegion region, PackedTile* tiles = nullptr);
+    // RemoveRegion of the whole board, visiting only the pieces
+    int RemoveAllEntities();
+
+    void MoveEntity(EntityHandle id, pos position);
     void MoveEntity(pos current, pos destination);
-    pos GetAdjacentPosition(pos position, Direction direction);
+    pos GetAdjacentPosition(pos position, Direction direction) const;
     void MoveAllToAdjacent(Direction direction);
-    void PushInDirection(Push push);
-    void MoveToAdjacentTile(int id, Direction direction, bool isRotation = false);
-    bool doesEntityExistAtPosition(pos position);
-    bool doesEntityExist(int index);
+    void RunTurn(Direction direction, bool isRotation);
+    // takes back the last turn, links, attached pieces and rotation counts included, as
+    // long as nothing else has changed the board since
+    void UndoTurn();
+    void ResolveIndependentAssemblies(Direction direction, bool isRotation);
+    void ResolveAssembly(Assembly& assembly, Direction direction, bool isRotation);
+    void ApplyAssembly(Assembly& assembly, Direction direction, bool isRotation);
+    void ResolvePushChains(Assembly& assembly, Direction direction) const;
+    void ResolveTranslationOnBitboards(Assembly& assembly, Direction direction) const;
+    void ShiftChainEntities(Assembly& assembly, Direction direction);
+    void MoveToAdjacentTile(Assembly& assembly, int id, Direction direction, bool isRotation = false);
+    bool doesEntityExistAtPosition(pos position) const;
+    bool doesEntityExist(int index) const;
 
     void RotateAll(Direction direction);
     void PartialRotation(float angleAmount);
-    void RotateMovable(int index, Direction direction, pos pivotPosition);
-    pos GetProjectedPosition(pos currentPosition, pos pivotPosition, Direction direction);
-    void Rotate(int id, Direction direction);
-    float ComputeCollisionAngle();
-    std::vector<Push> CalculateAllRotationPushes(pos pivotPosition, Direction direction);
-    std::vector<Push> GetQuantizedRotationTrajectory(pos currentPosition, pos pivotPosition, Direction rotationDirection);
-    posf getNextRotationStep(posf& currentPosition, float& currentAngle, int sign, float radius);
-    posf idealizedStep(posf& currentPosition, float& angle, int sign, float radius);
-    posf idealizedCoords(posf& currentPosition, int sign, float radius);
-    std::vector<Direction> GetConnectableDirectionsFromId(int id);
-    void UpdateCurrentConnections(int id);
-
-    bool CanConnectInDirection(int id, Direction direction);
-    bool IsAdjacentConnectable(Direction connectionDirection, int adjIndex);
-    void UpdateAllConnections();
-    void UpdateRotations(RotationCounts& rotation);
-
-    int getSmallestAvailableID();
-    int getEntityIndexFromId(int id);
-    int getEntityIndexFromPosition(pos position);
-    int getTileIndexFromPosition(pos position);
-    int getTileIndexFromEntityIndex(int i);
-    pos getPositionFromTileIndex(int tileIndex);
-
-    bool checkBounds(pos position);
-};
\ No newline at end of file
+    void RotateMovables(Assembly& assembly, Direction direction, pos pivotPosition);
+    bool CanPlaceRotation(Assembly& assembly, pos pivotPosition, Direction direction);
+    pos GetProjectedPosition(pos currentPosition, pos pivotPosition, Direction direction) const;
+    void Rotate(Assembly& assembly, EntityHandle id, Direction direction);
+    const CollisionResult& ComputeCollisionAngle(Assembly& assembly, pos pivotPosition, Direction direction);
+    const CollisionResult& SweepRotation(Assembly& assembly, const Push* trajectories, const TrajectoryStep* steps,
+                                         pos pivotPosition) const;
+    void ApplySweptPushes(Assembly& assembly, const CollisionResult& result);
+    void CollectRotationStreams(Assembly& assembly, pos pivotPosition, Direction direction);
+    static std::vector<Push> ComputeRelativeTrajectory(pos offset, Direction rotationDirection);
+    TrajectorySpan GetCachedTrajectory(pos offset, Direction rotationDirection);
+    void PrebuildTrajectoryCache(BoardGeometry extent);
+    PortMask GetPortsFromId(EntityHandle id);
+
+    bool CanConnectInDirection(EntityHandle id, Direction direction);
+    bool IsAdjacentConnectable(Direction connectionDirection, EntityHandle adjId);
+    void UpdateAllConnections(Assembly& assembly);
+    void RefreshLinksAround(int tileIndex);
+    unsigned char ComputeTileLinks(int tileIndex);
+    void AttachConnected(int index);
+    const FlowStatus& EvaluateFlow();
+    void UpdateFlow();
+    void UpdateRotations(Assembly& assembly);
+    uint64_t ComputeHash() const;
+
+    // what a move of the query's assembly alone would do, without changing the board, any
+    // number of threads may evaluate against the same board at once as long as it does not
+    // change meanwhile. RunTurn moves every assembly, so with several on the board this is
+    // the turn's outcome only while the others stay clear of the assembly's swept tiles.
+    // An index without an assembly evaluates as a blocked move.
+    const MoveResult& EvaluateMove(const MoveQuery& query, MoveScratch& scratch) const;
+
+    int sweepOccupant(SweepScratch& sweep, int tileIndex) const;
+    int sweepEntityTile(SweepScratch& sweep, int index) const;
+    void sweepTouchTile(SweepScratch& sweep, int tileIndex) const;
+    void sweepMove(SweepScratch& sweep, int index, int tileIndex) const;
+    void sweepVacate(SweepScratch& sweep, int tileIndex) const;
+    void sweepPlace(SweepScratch& sweep, int index, int tileIndex) const;
+    bool sweepPushChain(Assembly& assembly, int index, Direction direction) const;
+
+    void collectEvaluatedStreams(MoveScratch& scratch, pos pivotPosition, Direction direction) const;
+    bool placeEvaluatedRotation(MoveScratch& scratch, pos pivotPosition, Direction direction) const;
+    void evaluateConnections(MoveScratch& scratch, int quarterTurns) const;
+    void evaluateAttach(MoveScratch& scratch, int index, int quarterTurns) const;
+    unsigned char evaluateTileLinks(MoveScratch& scratch, int tileIndex, int quarterTurns) const;
+    PortMask evaluatedPorts(const MoveScratch& scratch, int index, int quarterTurns) const;
+
+    bool getPivotPosition(const Assembly& assembly, pos& position) const;
+    int getAssemblyIndexOfEntity(int index) const;
+    void computeSweptRegion(Assembly& assembly, bool isRotation);
+    void recordFootprint(Assembly& assembly, Direction direction, bool isRotation);
+    bool readsWrittenTiles(const Assembly& assembly);
+#ifdef PIPE_STATS
+    void recordTurnStats(StatsClock::time_point turnStart);
+#endif
+
+    uint64_t pieceKey(int index) const;
+    void setEntityPosition(Assembly& assembly, int index, pos position);
+    void setEntityTransform(Assembly& assembly, int index, pos position, Direction orientation);
+    void setTileMapping(Assembly& assembly, pos position, int entityIndex);
+    void markMoved(Assembly& assembly, int index, posf deltaPosition);
+    void markPushed(Assembly& assembly, int index);
+
+    void refreshRegionLinks(BoardRegion region);
+    void markChangedTile(int tileIndex);
+    void refreshChangedLinks();
+    // pieces written one by one with placeEntity after RemoveAllEntities and linked once
+    // all are down, for restoring a whole board in time proportional to its pieces
+    int placeEntity(int tileIndex, pos position, EntityType type, Direction orientation, bool isCurrentMovable,
+                    Assembly& assembly);
+    void refreshEntityLinks();
+    void removeEntityIndex(int index);
+
+    EntityHandle allocateHandle(int entityIndex);
+    void releaseHandle(EntityHandle id);
+    bool isHandleValid(EntityHandle id) const;
+    int getEntityIndexFromId(EntityHandle id) const;
+    int getEntityIndexFromPosition(pos position) const;
+    int getTileIndexFromPosition(pos position) const;
+    int getTileIndexFromEntityIndex(int i) const;
+    pos getPositionFromTileIndex(int tileIndex) const;
+
+    bool checkBounds(pos position) const;
+};
+
+inline int EntityManager::getEntityIndexFromId(EntityHandle id) const
+{
+    if (!isHandleValid(id))
+        return -1;
+
+    return slotToEntityIndex[id.slot];
+}
+
+inline bool EntityManager::isHandleValid(EntityHandle id) const
+{
+    return id.slot < slotGenerations.size() && slotGenerations[id.slot] == id.generation;
+}
+
+inline pos EntityManager::GetAdjacentPosition(pos position, Direction direction) const
+{
+    // without branches, the events of a rotation head every way and a switch mispredicts
+    return pos{.x=position.x + (direction == RIGHT) - (direction == LEFT),
+               .y=position.y + (direction == DOWN) - (direction == UP)};
+}
+
+inline int EntityManager::getTileIndexFromPosition(pos position) const
+{
+    if (!checkBounds(position)) {
+        return -1;
+    }
+
+    if (isShippedBoard)
+        return ShippedBoard::TileIndex(position);
+
+    return board.TileIndex(position);
+}
+
+inline bool EntityManager::checkBounds(pos position) const
+{
+    if (isShippedBoard)
+        return ShippedBoard::CheckBounds(position);
+
+    return board.CheckBounds(position);
+}
\ No newline at end of file
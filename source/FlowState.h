@@ -0,0 +1,102 @@
+#pragma once
+
+#include "SimulationTypes.h"
+
+#include <vector>
+
+// a set of pieces joined by links, every piece has at most a few openings
+// so a component with as many links as pieces must close on itself
+struct FlowComponent {
+    int pieces;
+    int linkEnds;
+    int sources;
+    int sinks;
+    bool isLive;
+    bool isNew;
+
+    bool IsConnectedPath() const { return sources > 0 && sinks > 0; }
+    bool IsClosedLoop() const { return linkEnds / 2 >= pieces; }
+};
+
+struct FlowStatus {
+    int connectedPaths;
+    int closedLoops;
+};
+
+// component labels of every occupied tile, kept current by relabelling only the
+// components that touch a tile whose links or occupant changed
+struct FlowState {
+    std::vector<int> componentOfTile;
+    std::vector<FlowComponent> components;
+    std::vector<int> freeComponents;
+    std::vector<int> retiredComponents;
+    std::vector<int> newComponents;
+    std::vector<int> dirtyTiles;
+    std::vector<int> queue;
+    FlowStatus status = FlowStatus{0, 0};
+
+    void Resize(int tileCount) {
+        componentOfTile.assign(tileCount, -1);
+        components.clear();
+        freeComponents.clear();
+        retiredComponents.clear();
+        newComponents.clear();
+        dirtyTiles.clear();
+        status = FlowStatus{0, 0};
+    }
+
+    // drops every component, once only tiles waiting in dirtyTiles may still carry a label
+    void Forget() {
+        for (int tileIndex : dirtyTiles) {
+            componentOfTile[tileIndex] = -1;
+        }
+        components.clear();
+        freeComponents.clear();
+        retiredComponents.clear();
+        newComponents.clear();
+        dirtyTiles.clear();
+        status = FlowStatus{0, 0};
+    }
+
+    int Allocate() {
+        int id;
+        if (freeComponents.empty()) {
+            id = components.size();
+            components.emplace_back();
+        } else {
+            id = freeComponents.back();
+            freeComponents.pop_back();
+        }
+
+        components[id] = FlowComponent{0, 0, 0, 0, true, true};
+        newComponents.push_back(id);
+        return id;
+    }
+
+    // ids are only reused once the update that retired them is over,
+    // so an old label still on a tile never aliases a new component
+    void Retire(int id) {
+        if (id < 0 || !components[id].isLive || components[id].isNew)
+            return;
+
+        Count(components[id], -1);
+        components[id].isLive = false;
+        retiredComponents.push_back(id);
+    }
+
+    void Count(const FlowComponent& component, int sign) {
+        status.connectedPaths += sign * component.IsConnectedPath();
+        status.closedLoops += sign * component.IsClosedLoop();
+    }
+
+    void FinishUpdate() {
+        for (int id : newComponents) {
+            components[id].isNew = false;
+            Count(components[id], 1);
+        }
+        freeComponents.insert(freeComponents.end(), retiredComponents.begin(), retiredComponents.end());
+        retiredComponents.clear();
+        newComponents.clear();
+        dirtyTiles.clear();
+    }
+};
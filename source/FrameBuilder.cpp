@@ -0,0 +1,227 @@
+#include "FrameBuilder.h"
+
+#include <functional>
+
+FrameBuilder::FrameBuilder(BoardGeometry geometry, float tileWidth, float tileHeight) 
+{
+    board = geometry;
+    int tileCount = board.TileCount();
+
+    x_tile_size = tileWidth;
+    y_tile_size = tileHeight;
+
+    gridPositions.assign(tileCount * 2, 0.f);
+    movementRemaining.assign(tileCount, posf{0.f, 0.f});
+    renderPositions = std::shared_ptr<float[]>(new float[tileCount * 2]);
+    orientations = std::shared_ptr<float[]>(new float[tileCount]);
+    angles = std::shared_ptr<float[]>(new float[tileCount]);
+    pipeTypes = std::shared_ptr<float[]>(new float[tileCount]);
+
+    for (int i = 0; i < SHADER_TYPE_COUNT; i++) {
+        std::shared_ptr<unsigned int[]> indices(new unsigned int[tileCount]);
+        elementIndexArrays[i] = indices;
+    }
+
+    std::fill(numberOfShaderType, numberOfShaderType+SHADER_TYPE_COUNT, 0);
+    origo = posf{0.f, 0.f};
+    angleRemaining = 0.;
+    partialRotationRemaining = 0.f;
+
+    InitializeScreenPositions();
+}
+
+void FrameBuilder::InitializeScreenPositions() {
+    int i = 0;
+    for (int x = 0; x < board.columns; x++) {
+        for (int y = 0; y < board.rows; y++) {
+            i = board.TileIndex(pos{.x=x, .y=y});
+            movementRemaining[i].x = 0.0f;
+            movementRemaining[i].y = 0.0f;
+            gridPositions[2*i]     = -1. + (x+.5)*x_tile_size;
+            gridPositions[2*i + 1] =  1. - (y+.5)*y_tile_size;
+        }
+    }
+}
+
+RotationCounts FrameBuilder::HandleAngle(RotationCounts rotationCounts) 
+{
+    if (rotationCounts.leftRotations > 0) {
+        rotationCounts.leftRotations--;
+        angleRemaining -= 3.141592/2.;
+    }
+
+    if (rotationCounts.rightRotations > 0) {
+        rotationCounts.rightRotations--;
+        angleRemaining += 3.141592/2.;
+    }
+
+    if (abs(angleRemaining) > 0.01) {
+        angleRemaining *= 0.6;
+    } else {
+        angleRemaining = 0;
+    }
+
+    return rotationCounts;
+}
+
+void FrameBuilder::HandleMovement(posf deltaPos, int tileIndex, bool hasMovementStarted) 
+{
+    if (!hasMovementStarted && movementRemaining[tileIndex].x == 0 && movementRemaining[tileIndex].y == 0) {
+        return;
+    }
+
+    if (hasMovementStarted)
+        movementRemaining[tileIndex] = posf{movementRemaining[tileIndex].x - ((deltaPos.x)*x_tile_size),
+                                            movementRemaining[tileIndex].y + ((deltaPos.y)*y_tile_size)};
+
+    if (abs(movementRemaining[tileIndex].x) + abs(movementRemaining[tileIndex].y) > 0.01) {
+        movementRemaining[tileIndex].x *= 0.6f;
+        movementRemaining[tileIndex].y *= 0.6f;
+    } else {
+        movementRemaining[tileIndex].x = 0.f;
+        movementRemaining[tileIndex].y = 0.f;
+    }
+
+}
+
+void FrameBuilder::HandlePartialAngle(float& partialAngle, int& rotationSign, float& amountRemaining) 
+{
+    if (rotationSign == 0 && amountRemaining == 0)
+        return;
+    
+    if (rotationSign != 0) {
+        amountRemaining = -rotationSign;
+        amountRemaining = abs(amountRemaining) > 1. ? (amountRemaining > 0) - (amountRemaining < 0) : amountRemaining;
+        rotationSign = 0;
+    }
+
+    if (abs(amountRemaining) > 0.1) {
+        amountRemaining *= 0.7f;
+        angleRemaining = partialAngle *(-cos(amountRemaining * 6.28f)*0.5f + 0.5);
+    } else {
+        partialAngle = 0;
+        amountRemaining = 0;
+        angleRemaining = 0;
+    }
+}
+
+std::vector<int> ShaderTypeFromEntityType(EntityType entityType) {
+    std::vector<int> types;
+    switch (entityType) 
+    { 
+        case EntityType::BENT_PIPE:
+            types.push_back(static_cast<int>(ShaderType::PIPE));
+            types.push_back(static_cast<int>(ShaderType::PIPE_SHADOW));
+            return types;
+        case EntityType::STRAIGHT_PIPE:
+            types.push_back(static_cast<int>(ShaderType::PIPE));
+            types.push_back(static_cast<int>(ShaderType::PIPE_SHADOW));
+            return types;
+        case EntityType::TEE_PIPE:
+        case EntityType::CROSS_PIPE:
+        case EntityType::SOURCE:
+        case EntityType::SINK:
+            types.push_back(static_cast<int>(ShaderType::PIPE));
+            types.push_back(static_cast<int>(ShaderType::PIPE_SHADOW));
+            return types;
+        case EntityType::BACKGROUND:
+            types.push_back(static_cast<int>(ShaderType::BACKGROUND));
+            return types;
+        default:
+            types.push_back(static_cast<int>(ShaderType::NONE));
+            return types;
+    }
+}
+
+void FrameBuilder::Build(EntityManager& em)
+{
+    // the view turns with the player's assembly
+    Assembly& primary = em.assemblies.front();
+    primary.rotationCounts = HandleAngle(primary.rotationCounts);
+    HandlePartialAngle(primary.partialRotationAngle, primary.partialRotationSign, partialRotationRemaining);
+
+    int pivotIndex = std::max(em.getEntityIndexFromId(primary.pivot), 0);
+    int origoIndex = em.getTileIndexFromEntityIndex(pivotIndex);
+    
+    origo.x = gridPositions[origoIndex*2];
+    origo.y = gridPositions[origoIndex*2+1];
+
+    std::fill(numberOfShaderType, numberOfShaderType+SHADER_TYPE_COUNT, 0);
+
+    std::vector<int> movableIndices;
+    std::vector<int> nonMovableIndices;
+
+    for (int i = 0; i < static_cast<int>(em.numEntities); i++) {
+        unsigned int tileIndex = em.getTileIndexFromEntityIndex(i);
+        EntityType entityType = em.types[i];
+        std::vector<int> shaderTypes = ShaderTypeFromEntityType(entityType);
+        for (int shaderType : shaderTypes) {
+            if (shaderType >= SHADER_TYPE_COUNT)
+                continue;
+            int index = numberOfShaderType[shaderType];
+            if (index >= board.TileCount())
+                continue;
+
+            elementIndexArrays[shaderType].get()[index] = tileIndex;
+            angles[tileIndex] = (em.isMovable.Test(i) || em.isTemporarilyMovable.Test(i)) && !(em.gotPushed.Test(i)) ? angleRemaining : 0;
+            orientations[tileIndex] = em.orientations[i];
+            if (shaderType == static_cast<int>(ShaderType::PIPE)) 
+            {
+                switch (entityType) 
+                {
+                case EntityType::BENT_PIPE:
+                    pipeTypes[tileIndex] = 1.;
+                    break;
+                case EntityType::STRAIGHT_PIPE:
+                    pipeTypes[tileIndex] = 0.;
+                    break;
+                // bars across and along, the tee's stem towards UP
+                case EntityType::TEE_PIPE:
+                    pipeTypes[tileIndex] = 2.;
+                    break;
+                case EntityType::CROSS_PIPE:
+                    pipeTypes[tileIndex] = 3.;
+                    break;
+                // a stem towards the opening and a round end, sources orange and sinks blue
+                case EntityType::SOURCE:
+                    pipeTypes[tileIndex] = 4.;
+                    break;
+                case EntityType::SINK:
+                    pipeTypes[tileIndex] = 5.;
+                    break;
+                default:
+                    break;
+                }
+            }
+            
+            HandleMovement(em.deltaPositions[i], tileIndex, em.hasMoved.Test(i));
+            em.hasMoved.Reset(i);
+            renderPositions[tileIndex*2] = gridPositions[tileIndex*2] + movementRemaining[tileIndex].x;
+            renderPositions[tileIndex*2+1] = gridPositions[tileIndex*2+1] + movementRemaining[tileIndex].y;
+            numberOfShaderType[shaderType]++;
+        }
+    }
+
+    int pipeType = static_cast<int>(ShaderType::PIPE);
+
+    std::function<bool (int, int)> sortFunc;
+
+    // draw order follows reading order whatever the tile layout
+    BoardGeometry geometry = board;
+    if ((angleRemaining > -1.5 && angleRemaining <= .01) || angleRemaining > 1.5) {
+        sortFunc = [geometry](int a, int b) {return geometry.RowMajorIndex(a) < geometry.RowMajorIndex(b);};
+    } else if (angleRemaining < 1.5 && angleRemaining >= 0)  {
+        sortFunc = [geometry](int a, int b) {
+            int rowMajorA = geometry.RowMajorIndex(a);
+            int rowMajorB = geometry.RowMajorIndex(b);
+            int columns = geometry.columns;
+            return rowMajorA % columns != rowMajorB % columns ? rowMajorA > rowMajorB : rowMajorA < rowMajorB;
+        };
+    } else {
+        sortFunc = [geometry](int a, int b) {return geometry.RowMajorIndex(a) < geometry.RowMajorIndex(b);};
+    }
+
+    std::sort(elementIndexArrays[pipeType].get(), 
+            elementIndexArrays[pipeType].get() + numberOfShaderType[pipeType],
+            sortFunc);
+}
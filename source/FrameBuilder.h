@@ -0,0 +1,49 @@
+#pragma once
+
+#include "SimulationTypes.h"
+#include "EntityManager.h"
+
+#include <memory>
+#include <vector>
+
+enum class ShaderType {
+    NONE,
+    PIPE_SHADOW,
+    PIPE,
+    BACKGROUND,
+    Count
+};
+
+#define SHADER_TYPE_COUNT static_cast<int>(ShaderType::Count)
+
+// the vertex data of a frame and the animation state it is built from, kept apart
+// from the renderer so it builds and can be measured without a GL context
+class FrameBuilder
+{
+    BoardGeometry board;
+    float x_tile_size;
+    float y_tile_size;
+
+    std::vector<float> gridPositions;
+    std::vector<posf> movementRemaining;
+    float angleRemaining;
+    float partialRotationRemaining;
+
+    public:
+        // attributes and per shader element indices the renderer uploads
+        std::shared_ptr<float[]> renderPositions;
+        std::shared_ptr<float[]> orientations;
+        std::shared_ptr<float[]> angles;
+        std::shared_ptr<float[]> pipeTypes;
+        std::shared_ptr<unsigned int[]> elementIndexArrays[SHADER_TYPE_COUNT];
+        int numberOfShaderType[SHADER_TYPE_COUNT];
+        posf origo;
+
+        FrameBuilder(BoardGeometry geometry, float tileWidth, float tileHeight);
+
+        void InitializeScreenPositions();
+        RotationCounts HandleAngle(RotationCounts rotationCount);
+        void HandleMovement(posf deltaPos, int gridIndex, bool isMovementOn);
+        void HandlePartialAngle(float& partialAngle, int& rotationStarted, float& amountRemaining);
+        void Build(EntityManager& em);
+};
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <mutex>
+#include <vector>
+
+// The states of one search level, as fixed size records in chunks. Chunks are kept in
+// memory up to a budget, past it they are appended to an unnamed temporary file and read
+// back when taken, so a wide level costs disk rather than memory. Chunk ids count the
+// chunks in memory first, then the ones on disk.
+class FrontierStore {
+    struct DiskChunk {
+        long offset;
+        size_t bytes;
+    };
+
+    size_t memoryBudget = 0;
+    size_t memoryBytes = 0;
+    int64_t spilledBytes = 0;
+    std::mutex mutex;
+    std::vector<std::vector<unsigned char>> memoryChunks;
+    std::vector<DiskChunk> diskChunks;
+    FILE* file = nullptr;
+    long fileEnd = 0;
+
+    bool spill(const std::vector<unsigned char>& chunk) {
+        if (!file)
+            file = tmpfile();
+        if (!file || fseek(file, fileEnd, SEEK_SET) != 0 ||
+            fwrite(chunk.data(), 1, chunk.size(), file) != chunk.size())
+            return false;
+
+        diskChunks.push_back(DiskChunk{fileEnd, chunk.size()});
+        fileEnd += chunk.size();
+        spilledBytes += chunk.size();
+        return true;
+    }
+
+    public:
+        FrontierStore() = default;
+        FrontierStore(const FrontierStore&) = delete;
+        FrontierStore& operator=(const FrontierStore&) = delete;
+
+        ~FrontierStore() {
+            if (file)
+                fclose(file);
+        }
+
+        void SetMemoryBudget(size_t bytes) { memoryBudget = bytes; }
+
+        // takes the contents of chunk, which is left empty, a chunk the disk refuses
+        // stays in memory over the budget
+        void Add(std::vector<unsigned char>& chunk) {
+            if (chunk.empty())
+                return;
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (memoryBytes + chunk.size() > memoryBudget && spill(chunk)) {
+                chunk.clear();
+                return;
+            }
+
+            memoryBytes += chunk.size();
+            memoryChunks.emplace_back();
+            memoryChunks.back().swap(chunk);
+        }
+
+        int ChunkCount() const { return memoryChunks.size() + diskChunks.size(); }
+
+        // every chunk is taken once, by one thread
+        bool Take(int chunk, std::vector<unsigned char>& records) {
+            if (chunk < static_cast<int>(memoryChunks.size())) {
+                records.clear();
+                records.swap(memoryChunks[chunk]);
+                return true;
+            }
+
+            const DiskChunk& disk = diskChunks[chunk - memoryChunks.size()];
+            records.resize(disk.bytes);
+            std::lock_guard<std::mutex> lock(mutex);
+            return fseek(file, disk.offset, SEEK_SET) == 0 && fread(records.data(), 1, disk.bytes, file) == disk.bytes;
+        }
+
+        void Clear() {
+            memoryChunks.clear();
+            diskChunks.clear();
+            memoryBytes = 0;
+            fileEnd = 0;
+        }
+
+        int64_t SpilledBytes() const { return spilledBytes; }
+};
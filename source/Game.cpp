@@ -21,7 +21,8 @@ void Game::init(const char* title, int xpos, int ypos, int width, int height, bo
         GlCall(glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA));
         SDL_GL_SetSwapInterval(1);
         entityManager = std::make_unique<EntityManager>();
-        renderer = std::make_unique<Renderer>();
+        entityManager->PrebuildTrajectoryCache(entityManager->board);
+        renderer = std::make_unique<Renderer>(entityManager->board);
         isRunning = true;
     }
 }
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "SimulationTypes.h"
+#include "Assembly.h"
+#include "BitSet.h"
+
+#include <vector>
+
+// a move of one assembly, the part it plays in RunTurn(direction, isRotation)
+struct MoveQuery {
+    Direction direction;
+    bool isRotation;
+    int assemblyIndex = 0;
+};
+
+struct EntityPlacement {
+    int entityIndex;
+    pos position;
+    Direction orientation;
+};
+
+// what a move would do, nothing is listed for a move that does not go through
+struct MoveResult {
+    bool isOk;
+    // how far a rotation gets before it is blocked, a quarter turn when it is not
+    BinaryAngle collisionAngle;
+    std::vector<EntityPlacement> placements;
+    // pieces the move would link to a movable piece, they would join its assembly
+    std::vector<int> connectedEntities;
+};
+
+// everything EvaluateMove writes, one per thread evaluating against the same board
+struct MoveScratch {
+    Assembly assembly;
+    std::vector<Push> trajectories;
+    std::vector<TrajectoryStep> steps;
+    std::vector<int> writtenTiles;
+    BitSet attached;
+    std::vector<int> attachQueue;
+    MoveResult result;
+
+    void Resize(int entityCount, int tileCount) {
+        assembly.Resize(entityCount, tileCount);
+        attached.Resize(entityCount);
+    }
+};
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "SimulationTypes.h"
+
+// openings of a piece as a 4-bit mask, bit d is set when it connects towards direction d
+typedef unsigned char PortMask;
+
+constexpr PortMask PortBit(Direction direction)
+{
+    return static_cast<PortMask>(1 << direction);
+}
+
+// directions are in turning order, so a quarter turn to the left moves every opening
+// one bit up, UP to LEFT and RIGHT around to UP
+constexpr PortMask RotatePorts(PortMask ports, int quarterTurns)
+{
+    return static_cast<PortMask>(((ports << (quarterTurns & 3)) | (ports >> (4 - (quarterTurns & 3)))) & 0xF);
+}
+
+// openings of every piece type facing UP, a new pipe type only needs its row here
+constexpr PortMask uprightPorts[ENTITY_TYPE_COUNT] = {
+    0,                                            // BACKGROUND
+    0,                                            // PLAYER
+    PortBit(UP) | PortBit(LEFT),                  // BENT_PIPE
+    PortBit(UP) | PortBit(DOWN),                  // STRAIGHT_PIPE
+    0,                                            // BOX
+    PortBit(UP),                                  // SOURCE
+    PortBit(UP),                                  // SINK
+    PortBit(UP) | PortBit(LEFT) | PortBit(RIGHT), // TEE_PIPE
+    PortBit(UP) | PortBit(LEFT) | PortBit(DOWN) | PortBit(RIGHT), // CROSS_PIPE
+};
+
+struct PortTable {
+    PortMask masks[ENTITY_TYPE_COUNT][4];
+};
+
+constexpr PortTable BuildPortTable()
+{
+    PortTable table = {};
+    for (int type = 0; type < ENTITY_TYPE_COUNT; type++) {
+        for (int orientation = 0; orientation < 4; orientation++) {
+            table.masks[type][orientation] = RotatePorts(uprightPorts[type], orientation);
+        }
+    }
+    return table;
+}
+
+constexpr PortTable portTable = BuildPortTable();
+
+static_assert(portTable.masks[static_cast<int>(EntityType::BENT_PIPE)][RIGHT] == (PortBit(RIGHT) | PortBit(UP)),
+              "a bent pipe opens towards its orientation and the next direction");
+
+inline PortMask PortsOf(EntityType type, Direction orientation)
+{
+    return portTable.masks[static_cast<int>(type)][orientation];
+}
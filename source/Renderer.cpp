@@ -1,28 +1,24 @@
 #include "Renderer.h"
 
-Renderer::Renderer() 
+#include <algorithm>
+
+Renderer::Renderer(BoardGeometry geometry) 
+    : board(geometry),
+      tileSize(std::min(static_cast<float>(PIXEL_WIDTH) / geometry.columns, static_cast<float>(PIXEL_HEIGHT) / geometry.rows)),
+      tilesPerHeight(static_cast<float>(PIXEL_HEIGHT) / tileSize),
+      frame(geometry, 2.0f * tileSize / static_cast<float>(PIXEL_WIDTH), 2.0f * tileSize / static_cast<float>(PIXEL_HEIGHT))
 {
-    x_tile_size = 2.0f * static_cast<float>(TILE_SIZE) / static_cast<float>(PIXEL_WIDTH);
-    y_tile_size = 2.0f / static_cast<float>(TILES_ROWS);
 
-    renderPositions = std::shared_ptr<float[POSITIONS_LENGTH]>(new float[POSITIONS_LENGTH]);
-    
     corners = std::shared_ptr<float[8]>(new float[8] {
                         1., -1.,
                         -1., -1., 
                         -1.,  1., 
                         1.,  1.
     });
-    orientations = std::shared_ptr<float[ORIENTATIONS_LENGTH]>(new float[ORIENTATIONS_LENGTH]);
-    angles = std::shared_ptr<float[ANGLES_LENGTH]>(new float[ANGLES_LENGTH]);
-    pipeTypes = std::shared_ptr<float[NUMBER_OF_TILES]>(new float[NUMBER_OF_TILES]);
     cornerIndexArray = std::shared_ptr<unsigned int[6]>(new unsigned int[6]{0,1,2,2,3,0});
 
     timeLocation = 0;
     time = 0.f;
-    angleRemaining = 0.;
-    angle = 0.;
-    partialRotationRemaining = 0.f;
     _isInitialized = false;
 
     Initialize();
@@ -30,6 +26,8 @@ Renderer::Renderer()
 
 void Renderer::Initialize() 
 {   
+    int tileCount = board.TileCount();
+
     const char vShaderStr[] =
         "precision mediump float;                                               \n"
         "attribute vec4 vPosition;                                              \n"
@@ -41,6 +39,7 @@ void Renderer::Initialize()
         "varying float fAngle;                                                  \n"
         "varying float fPipeType;                                               \n"
         "uniform vec4 u_translation;                                            \n"
+        "uniform float u_tileSize;                                              \n"
         "void main()                                                            \n"
         "{                                                                      \n"
         "   fOrientation = vOrientation;                                        \n"
@@ -56,8 +55,7 @@ void Renderer::Initialize()
         "   vec2 pos2D = rotMat * (position - origo) + origo;                   \n"
         "   pos2D *= vec2(1.,ratio);                                            \n"
         "   gl_Position = vec4(pos2D, 0., 1.);                                  \n"
-        "   float tileSize = float(" STR(TILE_SIZE) ");                         \n"
-        "   gl_PointSize = 2.*tileSize;                                         \n"
+        "   gl_PointSize = 2.*u_tileSize;                                       \n"
         "}                                                                      \n";
 
     const char fPipeShadowShader[] = 
@@ -82,7 +80,14 @@ void Renderer::Initialize()
         "    float mask = 1.;\n"
         "    uv -= .5;\n"
         "    uv = rotate(uv,  orientation*3.141592/2.+fAngle);\n"
-        "    if (pipeType > 0.5) {\n"
+        "    if (pipeType > 3.5) {\n"
+        "        bool stem = abs(uv.x) < .35 && uv.y > -.5 && uv.y < 0.;\n"
+        "        mask = stem || length(uv) < .35 ? mask : 0.;\n"
+        "    } else if (pipeType > 1.5) {\n"
+        "        bool across = abs(uv.y) < .35 && abs(uv.x) < .5;\n"
+        "        bool along = abs(uv.x) < .35 && uv.y > -.5 && uv.y < (pipeType > 2.5 ? .5 : 0.);\n"
+        "        mask = across || along ? mask : 0.;\n"
+        "    } else if (pipeType > 0.5) {\n"
         "        mask = uv.x < -.5 || uv.y < -.5 || uv.y > .5 || uv.x > .35 ? 0. : mask;\n"
         "        mask = uv.y - sqrt(.0225-(uv.x+.5)*(uv.x+.5)) < -0.5 || uv.y - sqrt(.7225-(uv.x+.5)*(uv.x+.5)) > -0.5 ? 0. : mask;\n"
         "    } else {\n"
@@ -143,7 +148,16 @@ void Renderer::Initialize()
         "    float l = 0.;\n"
         "    float theta = 0.;\n"
         "    vec2 v = vec2(0.);\n"
-        "    if (pipeType < 0.5) {\n"
+        "    if (pipeType > 3.5) {\n"
+        "        uv -= .5;\n"
+        "        normals.xy = length(uv) < .35 ? uv/.35 : vec2(uv.x/.35, 0.);\n"
+        "        normals.z = sqrt(max(0., 1.-dot(normals.xy, normals.xy)));\n"
+        "    } else if (pipeType > 1.5) {\n"
+        "        uv -= .5;\n"
+        "        bool isAcross = abs(uv.y) < abs(uv.x) || (pipeType < 2.5 && uv.y > 0.);\n"
+        "        normals.xy = isAcross ? vec2(0., uv.y/.35) : vec2(uv.x/.35, 0.);\n"
+        "        normals.z = sqrt(max(0., 1.-dot(normals.xy, normals.xy)));\n"
+        "    } else if (pipeType < 0.5) {\n"
         "        vec2 point1 = vec2(0.);\n"
         "        vec2 point2 = vec2(0.);\n"
         "        uv -= .5;\n"
@@ -172,7 +186,14 @@ void Renderer::Initialize()
         "    float mask = 1.;\n"
         "    uv -= .5;\n"
         "    uv = rotate(uv,  orientation*3.141592/2.+fAngle);\n"
-        "    if (pipeType > 0.5) {\n"
+        "    if (pipeType > 3.5) {\n"
+        "        bool stem = abs(uv.x) < .35 && uv.y > -.5 && uv.y < 0.;\n"
+        "        mask = stem || length(uv) < .35 ? mask : 0.;\n"
+        "    } else if (pipeType > 1.5) {\n"
+        "        bool across = abs(uv.y) < .35 && abs(uv.x) < .5;\n"
+        "        bool along = abs(uv.x) < .35 && uv.y > -.5 && uv.y < (pipeType > 2.5 ? .5 : 0.);\n"
+        "        mask = across || along ? mask : 0.;\n"
+        "    } else if (pipeType > 0.5) {\n"
         "        mask = uv.x < -.5 || uv.y < -.5 || uv.y > .5 || uv.x > .35 ? 0. : mask;\n"
         "        mask = uv.y - sqrt(.0225-(uv.x+.5)*(uv.x+.5)) < -0.5 || uv.y - sqrt(.7225-(uv.x+.5)*(uv.x+.5)) > -0.5 ? 0. : mask;\n"
         "    } else {\n"
@@ -204,6 +225,7 @@ void Renderer::Initialize()
         "    vec3 normals = getNormals(fPipeType, uv, fOrientation);  \n"
         "    normals.x *= -1.;\n"
         "    vec4 color =  vec4(0.4, 1., 0.3, 1.);\n"
+        "    color.rgb = fPipeType > 4.5 ? vec3(0.3, 0.5, 1.) : fPipeType > 3.5 ? vec3(1., 0.6, 0.2) : color.rgb;\n"
         "    color.a = 1.;\n"
         "    vec2 uv1 = vec2(uv.x - gl_FragCoord.x + 400., uv.y + gl_FragCoord.y - 320.);\n"
         "    float light = dot(lightTransform, normals)/length(lightTransform);\n"
@@ -228,6 +250,7 @@ void Renderer::Initialize()
         "precision mediump float;\n"
         "uniform vec2 u_resolution;\n"
         "uniform vec2 u_lightPosition;\n"
+        "uniform float u_tilesPerHeight;\n"
         "float rand(float n) {\n"
         "    return fract(sin(n) * 34590.4532);\n"
         "}\n"
@@ -253,7 +276,7 @@ void Renderer::Initialize()
         "   vec2 uv = (gl_FragCoord.xy)/" STR(PIXEL_HEIGHT) ".;\n"
         "   vec3 lightTransform = vec3(u_lightPosition+uv, .5);                                \n"
         "   uv -= .5;\n"
-        "   uv *= " STR(TILES_ROWS) ".;\n"
+        "   uv *= u_tilesPerHeight;\n"
         "   vec2 uv2 = uv;\n"
         "   uv.x = mix(softBitCrunch(uv.x,16.), bitCrunch(uv.x, 16.),.0);                   \n"
         "   uv.y = mix(softBitCrunch(uv.y,16.),bitCrunch(uv.y, 16.),.0);                    \n"
@@ -300,55 +323,38 @@ void Renderer::Initialize()
     shaders[static_cast<int>(ShaderType::PIPE_SHADOW)] = std::make_unique<ShaderProgram>(vShaderStr, fPipeShadowShader);
     shaders[static_cast<int>(ShaderType::BACKGROUND)] = std::make_unique<ShaderProgram>(vTileShaderStr, fShinyTileShaderStr);
 
-    shaders[static_cast<int>(ShaderType::PIPE)]->AddAttribute(VertexAttribute("vPosition", 2, NUMBER_OF_TILES, renderPositions));
-    shaders[static_cast<int>(ShaderType::PIPE)]->AddAttribute(VertexAttribute("vOrientation", 1, NUMBER_OF_TILES, orientations));
-    shaders[static_cast<int>(ShaderType::PIPE)]->AddAttribute(VertexAttribute("vAngle", 1, NUMBER_OF_TILES, angles));
-    shaders[static_cast<int>(ShaderType::PIPE)]->AddAttribute(VertexAttribute("vPipeType", 1, NUMBER_OF_TILES, pipeTypes));
-    shaders[static_cast<int>(ShaderType::PIPE)]->AddUniform(Uniform("u_origo", 2, origo.array));
+    shaders[static_cast<int>(ShaderType::PIPE)]->AddAttribute(VertexAttribute("vPosition", 2, tileCount, frame.renderPositions));
+    shaders[static_cast<int>(ShaderType::PIPE)]->AddAttribute(VertexAttribute("vOrientation", 1, tileCount, frame.orientations));
+    shaders[static_cast<int>(ShaderType::PIPE)]->AddAttribute(VertexAttribute("vAngle", 1, tileCount, frame.angles));
+    shaders[static_cast<int>(ShaderType::PIPE)]->AddAttribute(VertexAttribute("vPipeType", 1, tileCount, frame.pipeTypes));
+    shaders[static_cast<int>(ShaderType::PIPE)]->AddUniform(Uniform("u_origo", 2, frame.origo.array));
     shaders[static_cast<int>(ShaderType::PIPE)]->AddUniform(Uniform("u_lightPosition", 2, lightPosition.array));
+    shaders[static_cast<int>(ShaderType::PIPE)]->AddUniform(Uniform("u_tileSize", 1, &tileSize));
 
-    shaders[static_cast<int>(ShaderType::PIPE_SHADOW)]->AddAttribute(VertexAttribute("vPosition", 2, NUMBER_OF_TILES, renderPositions));
-    shaders[static_cast<int>(ShaderType::PIPE_SHADOW)]->AddAttribute(VertexAttribute("vOrientation", 1, NUMBER_OF_TILES, orientations));
-    shaders[static_cast<int>(ShaderType::PIPE_SHADOW)]->AddAttribute(VertexAttribute("vAngle", 1, NUMBER_OF_TILES, angles));
-    shaders[static_cast<int>(ShaderType::PIPE_SHADOW)]->AddAttribute(VertexAttribute("vPipeType", 1, NUMBER_OF_TILES, pipeTypes));
-    shaders[static_cast<int>(ShaderType::PIPE_SHADOW)]->AddUniform(Uniform("u_origo", 2, origo.array));
+    shaders[static_cast<int>(ShaderType::PIPE_SHADOW)]->AddAttribute(VertexAttribute("vPosition", 2, tileCount, frame.renderPositions));
+    shaders[static_cast<int>(ShaderType::PIPE_SHADOW)]->AddAttribute(VertexAttribute("vOrientation", 1, tileCount, frame.orientations));
+    shaders[static_cast<int>(ShaderType::PIPE_SHADOW)]->AddAttribute(VertexAttribute("vAngle", 1, tileCount, frame.angles));
+    shaders[static_cast<int>(ShaderType::PIPE_SHADOW)]->AddAttribute(VertexAttribute("vPipeType", 1, tileCount, frame.pipeTypes));
+    shaders[static_cast<int>(ShaderType::PIPE_SHADOW)]->AddUniform(Uniform("u_origo", 2, frame.origo.array));
     shaders[static_cast<int>(ShaderType::PIPE_SHADOW)]->AddUniform(Uniform("u_lightPosition", 2, lightPosition.array));
+    shaders[static_cast<int>(ShaderType::PIPE_SHADOW)]->AddUniform(Uniform("u_tileSize", 1, &tileSize));
 
     shaders[static_cast<int>(ShaderType::BACKGROUND)]->AddAttribute(VertexAttribute("vCorners", 2, 4, corners));
     shaders[static_cast<int>(ShaderType::BACKGROUND)]->AddUniform(Uniform("u_lightPosition", 2, lightPosition.array));
+    shaders[static_cast<int>(ShaderType::BACKGROUND)]->AddUniform(Uniform("u_tilesPerHeight", 1, &tilesPerHeight));
     
-    InitializeScreenPositions();
-
-    for (int i = 0; i < SHADER_TYPE_COUNT; i++) {
-        std::shared_ptr<unsigned int[NUMBER_OF_TILES]> indices(new unsigned int[NUMBER_OF_TILES]);
-        elementIndexArrays[i] = indices;
-    }
-
     const int numElementArrays = SHADER_TYPE_COUNT;
 
     for(int i = 0; i < SHADER_TYPE_COUNT; i++)
     {
         GlCall(glGenBuffers(1, &elementBuffers[i]));
         GlCall(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBuffers[i]));
-        GlCall(glBufferData(GL_ELEMENT_ARRAY_BUFFER, NUMBER_OF_TILES * sizeof(unsigned int), elementIndexArrays[i].get(), GL_DYNAMIC_DRAW));
+        GlCall(glBufferData(GL_ELEMENT_ARRAY_BUFFER, tileCount * sizeof(unsigned int), frame.elementIndexArrays[i].get(), GL_DYNAMIC_DRAW));
     }
 
     _isInitialized = true;
 }
 
-void Renderer::InitializeScreenPositions() {
-    int i = 0;
-    for (int x = 0; x < TILES_COLUMNS; x++) {
-        for (int y = 0; y < TILES_ROWS; y++) {
-            i = x + y*TILES_COLUMNS;
-            movementRemaining[i].x = 0.0f;
-            movementRemaining[i].y = 0.0f;
-            gridPositions[2*i]     = -1. + (x+.5)*x_tile_size;
-            gridPositions[2*i + 1] =  1. - (y+.5)*y_tile_size;
-        }
-    }
-}
-
 void Renderer::DrawGrid() {
     
     int typeIndex = static_cast<int>(ShaderType::BACKGROUND);
@@ -364,160 +370,12 @@ void Renderer::DrawShaderType(ShaderType type) {
     if (!shaders[typeIndex])
         return;
 
-    shaders[typeIndex]->DrawElements(elementIndexArrays[typeIndex], elementBuffers[typeIndex], numberOfShaderType[typeIndex], GL_POINTS);
-}
-
-RotationCounts Renderer::HandleAngle(RotationCounts rotationCounts) 
-{
-    if (rotationCounts.leftRotations > 0) {
-        rotationCounts.leftRotations--;
-        angleRemaining -= 3.141592/2.;
-    }
-
-    if (rotationCounts.rightRotations > 0) {
-        rotationCounts.rightRotations--;
-        angleRemaining += 3.141592/2.;
-    }
-
-    if (abs(angleRemaining) > 0.01) {
-        angleRemaining *= 0.6;
-    } else {
-        angleRemaining = 0;
-    }
-
-    return rotationCounts;
-}
-
-void Renderer::HandleMovement(posf deltaPos, int tileIndex, bool& hasMovementStarted) 
-{
-    if (!hasMovementStarted && movementRemaining[tileIndex].x == 0 && movementRemaining[tileIndex].y == 0) {
-        return;
-    }
-
-    if (hasMovementStarted)
-        movementRemaining[tileIndex] = posf{movementRemaining[tileIndex].x - ((deltaPos.x)*x_tile_size),
-                                            movementRemaining[tileIndex].y + ((deltaPos.y)*y_tile_size)};
-        hasMovementStarted = false;
-
-    if (abs(movementRemaining[tileIndex].x) + abs(movementRemaining[tileIndex].y) > 0.01) {
-        movementRemaining[tileIndex].x *= 0.6f;
-        movementRemaining[tileIndex].y *= 0.6f;
-    } else {
-        movementRemaining[tileIndex].x = 0.f;
-        movementRemaining[tileIndex].y = 0.f;
-    }
-
-}
-
-void Renderer::HandlePartialAngle(float& partialAngle, int& rotationSign, float& amountRemaining) 
-{
-    if (rotationSign == 0 && amountRemaining == 0)
-        return;
-    
-    if (rotationSign != 0) {
-        amountRemaining = -rotationSign;
-        amountRemaining = abs(amountRemaining) > 1. ? (amountRemaining > 0) - (amountRemaining < 0) : amountRemaining;
-        rotationSign = 0;
-    }
-
-    if (abs(amountRemaining) > 0.1) {
-        amountRemaining *= 0.7f;
-        angleRemaining = partialAngle *(-cos(amountRemaining * 6.28f)*0.5f + 0.5);
-    } else {
-        partialAngle = 0;
-        amountRemaining = 0;
-        angleRemaining = 0;
-    }
-}
-
-std::vector<int> ShaderTypeFromEntityType(EntityType entityType) {
-    std::vector<int> types;
-    switch (entityType) 
-    { 
-        case EntityType::BENT_PIPE:
-            types.push_back(static_cast<int>(ShaderType::PIPE));
-            types.push_back(static_cast<int>(ShaderType::PIPE_SHADOW));
-            return types;
-        case EntityType::STRAIGHT_PIPE:
-            types.push_back(static_cast<int>(ShaderType::PIPE));
-            types.push_back(static_cast<int>(ShaderType::PIPE_SHADOW));
-            return types;
-        case EntityType::BACKGROUND:
-            types.push_back(static_cast<int>(ShaderType::BACKGROUND));
-            return types;
-        default:
-            types.push_back(static_cast<int>(ShaderType::NONE));
-            return types;
-    }
+    shaders[typeIndex]->DrawElements(frame.elementIndexArrays[typeIndex], elementBuffers[typeIndex], frame.numberOfShaderType[typeIndex], GL_POINTS);
 }
 
 void Renderer::UpdateGraphicsData(std::unique_ptr<EntityManager>& em)
 {
-    em->rotationCounts = HandleAngle(em->rotationCounts);
-    HandlePartialAngle(em->partialRotationAngle, em->partialRotationSign, partialRotationRemaining);
-
-    int origoIndex = em->getTileIndexFromEntityIndex(0);
-    
-    origo.x = gridPositions[origoIndex*2];
-    origo.y = gridPositions[origoIndex*2+1];
-
-    std::fill(numberOfShaderType, numberOfShaderType+SHADER_TYPE_COUNT, 0);
-
-    std::vector<int> movableIndices;
-    std::vector<int> nonMovableIndices;
-
-    for (int i = 0; i < em->numEntities; i++) {
-        unsigned int tileIndex = em->getTileIndexFromEntityIndex(i);
-        EntityType entityType = em->types[i];
-        std::vector<int> shaderTypes = ShaderTypeFromEntityType(entityType);
-        for (int shaderType : shaderTypes) {
-            if (shaderType >= SHADER_TYPE_COUNT)
-                continue;
-            int index = numberOfShaderType[shaderType];
-            if (index >= NUMBER_OF_TILES)
-                continue;
-
-            elementIndexArrays[shaderType].get()[index] = tileIndex;
-            angles[tileIndex] = (em->isMovable[i] || em->isTemporarilyMovable[i]) && !(em->gotPushed[i]) ? angleRemaining : 0;
-            orientations[tileIndex] = em->orientations[i];
-            if (shaderType == static_cast<int>(ShaderType::PIPE)) 
-            {
-                switch (entityType) 
-                {
-                case EntityType::BENT_PIPE:
-                    pipeTypes[tileIndex] = 1.;
-                    break;
-                case EntityType::STRAIGHT_PIPE:
-                    pipeTypes[tileIndex] = 0.;
-                    break;
-                default:
-                    break;
-                }
-            }
-            
-            HandleMovement(em->deltaPositions[i], tileIndex, em->hasMoved[i]);
-            renderPositions[tileIndex*2] = gridPositions[tileIndex*2] + movementRemaining[tileIndex].x;
-            renderPositions[tileIndex*2+1] = gridPositions[tileIndex*2+1] + movementRemaining[tileIndex].y;
-            numberOfShaderType[shaderType]++;
-        }
-    }
-
-    int pipeType = static_cast<int>(ShaderType::PIPE);
-    unsigned int* pipeIndices = elementIndexArrays[pipeType].get();
-
-    std::function<bool (int, int)> sortFunc;
-
-    if (angleRemaining > -1.5 && angleRemaining <= .01 || angleRemaining > 1.5) {
-        sortFunc = [](int a, int b) {return a < b;};
-    } else if (angleRemaining < 1.5 && angleRemaining >= 0)  {
-        sortFunc = [](int a, int b) {return a % TILES_COLUMNS != b % TILES_COLUMNS ? a > b : a < b;};
-    } else {
-        sortFunc = [](int a, int b) {return a < b;};
-    }
-
-    std::sort(elementIndexArrays[pipeType].get(), 
-            elementIndexArrays[pipeType].get() + numberOfShaderType[pipeType],
-            sortFunc);
+    frame.Build(*em);
 }
 
 void Renderer::Draw() 
@@ -76,7 +76,7 @@ void ShaderProgram::SetAttributes()
     for(auto& va : vertexAttributes)
     {
         GlCall(glBindBuffer(GL_ARRAY_BUFFER, va.buffer));
-        GlCall(glBufferData(GL_ARRAY_BUFFER, va.size * NUMBER_OF_TILES * sizeof(float), va.data.get(), GL_STATIC_DRAW));
+        GlCall(glBufferData(GL_ARRAY_BUFFER, va.size * va.count * sizeof(float), va.data.get(), GL_STATIC_DRAW));
         GlCall(unsigned int index = glGetAttribLocation(programId, va.name));
         GlCall(glEnableVertexAttribArray(index));
         GlCall(glVertexAttribPointer(index, va.size, GL_FLOAT, GL_FALSE, 0,0));
@@ -115,7 +115,7 @@ void ShaderProgram::DrawElements(const std::shared_ptr<unsigned int[]>& elements
     SetUniforms();
 
     GlCall(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer));
-    GlCall(glBufferData(GL_ELEMENT_ARRAY_BUFFER, NUMBER_OF_TILES * sizeof(unsigned int), elementsArray.get(), GL_DYNAMIC_DRAW));
+    GlCall(glBufferData(GL_ELEMENT_ARRAY_BUFFER, count * sizeof(unsigned int), elementsArray.get(), GL_DYNAMIC_DRAW));
     GlCall(glDrawElements(mode, count, GL_UNSIGNED_INT, nullptr));
 }
 
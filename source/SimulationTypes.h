@@ -0,0 +1,50 @@
+#pragma once
+
+// Types of the game logic. Nothing here or in the headers that include it may depend
+// on SDL, OpenGL or Emscripten, so the simulation builds natively as well.
+
+#include <algorithm>
+#include <math.h>
+
+#include "BinaryAngle.h"
+
+// size of the shipped board
+#define TILES_COLUMNS 20
+#define TILES_ROWS 16
+
+enum class EntityType {
+    BACKGROUND, PLAYER, BENT_PIPE, STRAIGHT_PIPE, BOX, SOURCE, SINK, TEE_PIPE, CROSS_PIPE, Count
+};
+
+#define ENTITY_TYPE_COUNT static_cast<int>(EntityType::Count)
+
+enum Direction {
+    UP, LEFT, DOWN, RIGHT
+};
+
+struct RotationCounts {
+    unsigned int leftRotations;
+    unsigned int rightRotations;
+};
+
+struct posf {
+    union {
+        struct {
+            float x, y;
+        };
+        struct {
+            float array[2];
+        };
+    };
+};
+
+struct pos {
+    int x, y;
+};
+
+// priority is the angle turned when the piece enters the tile it pushes from
+struct Push {
+    BinaryAngle priority;
+    posf fromPosition;
+    Direction direction;
+};
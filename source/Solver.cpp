@@ -0,0 +1,324 @@
+#include "Solver.h"
+#include "FrontierStore.h"
+#include "VisitedSet.h"
+#include "WorkStealingQueue.h"
+
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+#ifdef PARALLEL_ASSEMBLIES
+#include <thread>
+#endif
+
+static const char moveLetters[] = "wasdLR";
+static const int MOVE_COUNT = 6;
+static const unsigned char NO_MOVE = 0xFF;
+
+// states handed between workers at a time
+static const size_t CHUNK_STATES = 4096;
+
+// The pivot is part of a state, two boards with equal pieces can turn about different
+// ones. Its key marks the tile with a bit no packed piece uses.
+static const PackedTile PIVOT_MARK = 0x80;
+
+static Direction moveDirection(int move)
+{
+    static const Direction directions[MOVE_COUNT] = {UP, LEFT, DOWN, RIGHT, LEFT, RIGHT};
+    return directions[move];
+}
+
+static bool isRotationMove(int move)
+{
+    return move >= 4;
+}
+
+static bool isGoal(EntityManager& em, const SolverGoal& goal)
+{
+    const FlowStatus& flow = em.EvaluateFlow();
+    return flow.connectedPaths >= goal.connectedPaths && flow.closedLoops >= goal.closedLoops;
+}
+
+static bool getPivot(const EntityManager& em, pos& pivot)
+{
+    return em.getPivotPosition(em.assemblies[0], pivot);
+}
+
+static uint64_t stateKey(const EntityManager& em)
+{
+    pos pivot;
+    if (!getPivot(em, pivot))
+        return em.hash;
+    return em.hash ^ ZobristPieceKey(pivot, PIVOT_MARK);
+}
+
+// A second hash of the state, kept with its key to catch two states sharing a key. It
+// adds murmur3 finalized pieces where the key XORs splitmix64 mixed ones, so the two are
+// unrelated, and like the key it ignores the order of the pieces.
+static uint64_t checkPieceKey(pos position, PackedTile tile)
+{
+    uint64_t value = (static_cast<uint64_t>(static_cast<uint16_t>(position.x)) << 40) ^
+                     (static_cast<uint64_t>(static_cast<uint16_t>(position.y)) << 16) ^ tile ^ 0x2545F4914F6CDD1Dull;
+    value = (value ^ (value >> 33)) * 0xFF51AFD7ED558CCDull;
+    value = (value ^ (value >> 33)) * 0xC4CEB9FE1A85EC53ull;
+    return value ^ (value >> 33);
+}
+
+static uint64_t stateCheck(const EntityManager& em)
+{
+    uint64_t check = 0;
+    for (int i = 0; i < static_cast<int>(em.numEntities); i++) {
+        check += checkPieceKey(em.positions[i], PackTile(em.types[i], em.orientations[i], em.isMovable.Test(i)));
+    }
+
+    pos pivot;
+    if (getPivot(em, pivot))
+        check += checkPieceKey(pivot, PIVOT_MARK);
+    return check;
+}
+
+// A record is the state key, the pivot and every piece as two 16 bit coordinates and its
+// packed tile. Turns neither add nor remove pieces, so every record of a search is the
+// same size.
+static size_t recordSize(int pieceCount)
+{
+    return sizeof(uint64_t) + 2 * sizeof(uint16_t) + pieceCount * (2 * sizeof(uint16_t) + 1);
+}
+
+static void putPosition(unsigned char*& out, pos position)
+{
+    uint16_t coordinates[2] = {static_cast<uint16_t>(position.x), static_cast<uint16_t>(position.y)};
+    memcpy(out, coordinates, sizeof(coordinates));
+    out += sizeof(coordinates);
+}
+
+static pos getPosition(const unsigned char*& in)
+{
+    uint16_t coordinates[2];
+    memcpy(coordinates, in, sizeof(coordinates));
+    in += sizeof(coordinates);
+    return pos{coordinates[0], coordinates[1]};
+}
+
+static void appendState(const EntityManager& em, uint64_t key, std::vector<unsigned char>& records)
+{
+    size_t offset = records.size();
+    records.resize(offset + recordSize(em.numEntities));
+    unsigned char* out = records.data() + offset;
+
+    memcpy(out, &key, sizeof(key));
+    out += sizeof(key);
+
+    // no pivot is stored off the board, where no piece can be
+    pos pivot;
+    if (!getPivot(em, pivot))
+        pivot = pos{0xFFFF, 0xFFFF};
+    putPosition(out, pivot);
+
+    for (int i = 0; i < em.numEntities; i++) {
+        putPosition(out, em.positions[i]);
+        *out++ = PackTile(em.types[i], em.orientations[i], em.isMovable.Test(i));
+    }
+}
+
+// clears the board and adds the pieces of the record back, movable ones join the
+// player's assembly
+static void restoreState(EntityManager& em, const unsigned char* record, int pieceCount)
+{
+    const unsigned char* in = record + sizeof(uint64_t);
+    pos pivot = getPosition(in);
+
+    em.RemoveAllEntities();
+    for (int k = 0; k < pieceCount; k++) {
+        pos position = getPosition(in);
+        PackedTile tile = *in++;
+        em.AddEntity(PackedType(tile), position, IsPackedMovable(tile), PackedOrientation(tile));
+    }
+
+    if (em.checkBounds(pivot))
+        em.assemblies[0].pivot = em.ids[em.getEntityIndexFromPosition(pivot)];
+}
+
+static uint64_t recordKey(const unsigned char* record)
+{
+    uint64_t key;
+    memcpy(&key, record, sizeof(key));
+    return key;
+}
+
+namespace {
+
+struct Search {
+    const SolverOptions& options;
+    int pieceCount;
+    size_t stateBytes;
+    VisitedSet visited;
+    FrontierStore levels[2];
+    WorkStealingQueue queue;
+    std::atomic<bool> isFound;
+    std::atomic<bool> isStopped;
+    std::atomic<uint64_t> goalKey;
+    std::atomic<int64_t> explored;
+    std::atomic<int64_t> visitedCount;
+
+    Search(const SolverOptions& searchOptions, int pieces)
+        : options(searchOptions), pieceCount(pieces), stateBytes(recordSize(pieces)),
+          visited(searchOptions.visitedMemory), isFound(false), isStopped(false), goalKey(0),
+          explored(0), visitedCount(0) {
+        levels[0].SetMemoryBudget(options.frontierMemory);
+        levels[1].SetMemoryBudget(options.frontierMemory);
+    }
+
+    // plays the six moves from every state of the chunks this worker gets, new states go
+    // to the next level. Every worker stops once maxStates are visited, the ones already
+    // inserting may each add one more.
+    void Expand(EntityManager& em, int worker, FrontierStore& current, FrontierStore& next) {
+        std::vector<unsigned char> records;
+        std::vector<unsigned char> children;
+        int64_t expanded = 0;
+        int chunk;
+
+        while (!isFound && !isStopped && queue.Pop(worker, chunk)) {
+            if (!current.Take(chunk, records))
+                continue;
+
+            for (size_t offset = 0; offset + stateBytes <= records.size() && !isFound && !isStopped; offset += stateBytes) {
+                const unsigned char* record = records.data() + offset;
+                uint64_t parentKey = recordKey(record);
+                restoreState(em, record, pieceCount);
+                expanded++;
+
+                // a blocked turn leaves the board as it found it, any other is undone
+                for (int move = 0; move < MOVE_COUNT && !isStopped; move++) {
+                    em.RunTurn(moveDirection(move), isRotationMove(move));
+                    if (!em.isTurnOk)
+                        continue;
+
+                    uint64_t key = stateKey(em);
+                    if (visited.Insert(key, stateCheck(em), parentKey, move)) {
+                        if (++visitedCount >= options.maxStates)
+                            isStopped = true;
+
+                        if (isGoal(em, options.goal)) {
+                            bool wasFound = false;
+                            if (isFound.compare_exchange_strong(wasFound, true))
+                                goalKey = key;
+                        }
+
+                        appendState(em, key, children);
+                        if (children.size() >= CHUNK_STATES * stateBytes)
+                            next.Add(children);
+                    }
+
+                    em.UndoTurn();
+                }
+            }
+        }
+
+        next.Add(children);
+        explored += expanded;
+    }
+};
+
+}
+
+SolverResult SolvePuzzle(const EntityManager& start, const SolverOptions& options)
+{
+    SolverResult result;
+    auto startTime = std::chrono::steady_clock::now();
+
+    if (start.assemblies.size() != 1) {
+        result.error = "the solver plays boards with a single assembly";
+        return result;
+    }
+
+    int threadCount = 1;
+    int coreCount = 1;
+#ifdef PARALLEL_ASSEMBLIES
+    coreCount = std::max(1u, std::thread::hardware_concurrency());
+    threadCount = options.threadCount > 0 ? options.threadCount : coreCount;
+#endif
+    result.threadCount = threadCount;
+    result.coreCount = std::min(threadCount, coreCount);
+
+    Search search(options, start.numEntities);
+    std::vector<EntityManager> workers(threadCount, start);
+
+    uint64_t startKey = stateKey(start);
+    search.visited.Insert(startKey, stateCheck(start), startKey, NO_MOVE);
+    search.visitedCount = 1;
+    bool isSolved = isGoal(workers[0], options.goal);
+    if (isSolved)
+        search.goalKey = startKey;
+
+    std::vector<unsigned char> records;
+    appendState(start, startKey, records);
+    search.levels[0].Add(records);
+
+    int depth = 0;
+    while (!isSolved && depth < options.maxDepth && search.levels[depth % 2].ChunkCount() > 0) {
+        FrontierStore& current = search.levels[depth % 2];
+        FrontierStore& next = search.levels[(depth + 1) % 2];
+
+        search.queue.Reset(threadCount);
+        for (int chunk = 0; chunk < current.ChunkCount(); chunk++) {
+            search.queue.Push(chunk % threadCount, chunk);
+        }
+
+#ifdef PARALLEL_ASSEMBLIES
+        std::vector<std::thread> threads;
+        for (int worker = 1; worker < threadCount; worker++) {
+            threads.emplace_back([&, worker]() { search.Expand(workers[worker], worker, current, next); });
+        }
+        search.Expand(workers[0], 0, current, next);
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+#else
+        search.Expand(workers[0], 0, current, next);
+#endif
+
+        current.Clear();
+        depth++;
+        isSolved = search.isFound;
+
+        if (search.isStopped)
+            break;
+    }
+
+    result.isSolved = isSolved;
+    result.isLimitReached = !isSolved && (search.isStopped || search.levels[depth % 2].ChunkCount() > 0);
+    result.depth = depth;
+    result.statesExplored = search.explored;
+    result.statesVisited = search.visited.Count();
+    result.keyCollisions = search.visited.Collisions();
+    result.visitedBytes = search.visited.Bytes();
+    result.spilledBytes = search.levels[0].SpilledBytes() + search.levels[1].SpilledBytes() +
+                          search.visited.SpilledBytes();
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+    if (!isSolved)
+        return result;
+
+    // walk back from the goal to the start, then play the moves to check them
+    uint64_t key = search.goalKey;
+    uint64_t parent;
+    unsigned char move;
+    while (search.visited.Find(key, parent, move) && move != NO_MOVE) {
+        result.moves.insert(result.moves.begin(), moveLetters[move]);
+        key = parent;
+    }
+
+    EntityManager& em = workers[0];
+    em = start;
+    bool isPlayable = true;
+    for (char letter : result.moves) {
+        int m = strchr(moveLetters, letter) - moveLetters;
+        em.RunTurn(moveDirection(m), isRotationMove(m));
+        isPlayable &= em.isTurnOk;
+    }
+    result.isVerified = isPlayable && isGoal(em, options.goal);
+
+    return result;
+}
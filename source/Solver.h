@@ -0,0 +1,58 @@
+#pragma once
+
+#include "SimulationTypes.h"
+#include "EntityManager.h"
+
+#include <stdint.h>
+#include <string>
+
+// the flow a solved board shows, sources joined to sinks and closed loops
+struct SolverGoal {
+    int connectedPaths = 1;
+    int closedLoops = 0;
+};
+
+struct SolverOptions {
+    SolverGoal goal;
+    int threadCount = 0;                         // 0 for one per hardware thread
+    int maxDepth = 200;
+    int64_t maxStates = 100000000;               // workers stop once this many states are visited
+    size_t frontierMemory = size_t(256) << 20;   // bytes of a level kept in memory, the rest spills to disk
+    size_t visitedMemory = size_t(1) << 30;      // bytes of visited states kept in memory, the rest spills to disk
+};
+
+struct SolverResult {
+    bool isSolved = false;
+    bool isVerified = false;      // playing the moves from the start reaches the goal
+    bool isLimitReached = false;  // stopped by maxDepth or maxStates
+    std::string moves;            // w a s d move up, left, down and right, L and R rotate
+    std::string error;
+
+    int depth = 0;                // levels searched
+    int64_t statesExplored = 0;   // states whose six moves were played
+    int64_t statesVisited = 0;    // distinct states reached
+    int64_t keyCollisions = 0;    // states dropped as their key was taken, see SolvePuzzle
+    int64_t visitedBytes = 0;
+    int64_t spilledBytes = 0;     // levels written to disk and the disk the visited states take
+    int threadCount = 0;
+    int coreCount = 0;            // threads that could run at once
+    double seconds = 0.;
+
+    double StatesPerSecondPerCore() const {
+        return seconds > 0. ? statesExplored / seconds / coreCount : 0.;
+    }
+};
+
+// Breadth first search over the six moves with RunTurn as the transition function, so
+// the first solution found is a shortest one. Levels are spread over worker threads that
+// steal from each other, states are told apart by the board hash and the pivot, and a
+// level's states spill to disk past frontierMemory and visited states past visitedMemory.
+// Boards with a single assembly only.
+//
+// Of n visited states two share a 64 bit key with a probability of about n^2 / 2^65,
+// about one in 3700 for a hundred million states. Every key is kept with a second,
+// independent 64 bit hash of its state, so a collision goes unseen only if both match,
+// and the ones seen are counted in keyCollisions. A search with collisions skipped those
+// states, so its solution may not be a shortest one, and if it found none it may have
+// missed one.
+SolverResult SolvePuzzle(const EntityManager& start, const SolverOptions& options);
@@ -0,0 +1,51 @@
+#include "TrajectoryCache.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+unsigned long long TrajectoryCache::Key(pos offset, Direction direction) 
+{
+    unsigned long long x = static_cast<unsigned int>(offset.x);
+    unsigned long long y = static_cast<unsigned int>(offset.y) & 0x7fffffffu;
+    return (x << 32) | (y << 1) | (direction == RIGHT ? 1 : 0);
+}
+
+void TrajectoryCache::Clear() 
+{
+    spans.clear();
+    pushes.clear();
+    steps.clear();
+}
+
+bool TrajectoryCache::Find(pos offset, Direction direction, TrajectorySpan& span) const
+{
+    auto it = spans.find(Key(offset, direction));
+    if (it == spans.end())
+        return false;
+
+    span = it->second;
+    return true;
+}
+
+TrajectorySpan TrajectoryCache::Insert(pos offset, Direction direction, const std::vector<Push>& relativePushes) 
+{
+    int first = pushes.size();
+    pushes.insert(pushes.end(), relativePushes.begin(), relativePushes.end());
+    int reach = AppendSteps(pushes.data() + first, pushes.data() + pushes.size(), steps);
+
+    TrajectorySpan span = TrajectorySpan{first, static_cast<int>(relativePushes.size()), reach};
+    spans[Key(offset, direction)] = span;
+    return span;
+}
+
+int TrajectoryCache::AppendSteps(const Push* first, const Push* last, std::vector<TrajectoryStep>& steps)
+{
+    int reach = 0;
+    for (const Push* push = first; push != last; push++) {
+        int x = static_cast<int>(push->fromPosition.x) + (push->direction == RIGHT) - (push->direction == LEFT);
+        int y = static_cast<int>(push->fromPosition.y) + (push->direction == DOWN) - (push->direction == UP);
+        steps.push_back(TrajectoryStep{push->priority, static_cast<short>(x), static_cast<short>(y)});
+        reach = std::max(reach, std::max(std::abs(x), std::abs(y)));
+    }
+    return reach;
+}
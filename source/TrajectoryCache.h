@@ -0,0 +1,41 @@
+#pragma once
+
+#include "SimulationTypes.h"
+
+#include <unordered_map>
+#include <vector>
+
+struct TrajectorySpan {
+    int first;
+    int count;
+    // furthest a step lands from the pivot along either axis
+    int reach;
+};
+
+// the tile a step of a trajectory enters relative to the pivot, kept beside the pushes
+// for passes over every step that need nothing else
+struct TrajectoryStep {
+    BinaryAngle angle;
+    short x;
+    short y;
+};
+
+// quantized rotation trajectories relative to the pivot, keyed by offset and rotation direction
+class TrajectoryCache {
+    std::unordered_map<unsigned long long, TrajectorySpan> spans;
+    std::vector<Push> pushes;
+    std::vector<TrajectoryStep> steps;
+
+    static unsigned long long Key(pos offset, Direction direction);
+
+    public:
+        void Clear();
+        bool Find(pos offset, Direction direction, TrajectorySpan& span) const;
+        TrajectorySpan Insert(pos offset, Direction direction, const std::vector<Push>& relativePushes);
+        const Push* Data() const { return pushes.data(); }
+        const TrajectoryStep* Steps() const { return steps.data(); }
+        size_t Size() const { return spans.size(); }
+
+        // appends the steps of relative pushes, returns their reach
+        static int AppendSteps(const Push* first, const Push* last, std::vector<TrajectoryStep>& steps);
+};
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "SimulationTypes.h"
+#include "TrajectoryCache.h"
+
+#include <algorithm>
+#include <vector>
+
+// merges the cached trajectories of every moving piece into one angle ordered event stream,
+// a stable radix pass over the concatenated streams keeps equal angles in entity order,
+// buffers keep their capacity between turns so steady state rotations do not allocate
+class TrajectoryMerge {
+    struct Entry {
+        unsigned int key;
+        int push;
+    };
+
+    static const int radixBits = 11;
+    static const int smallRadixBits = 8;
+    static const size_t smallMergeSize = 1024;
+
+    std::vector<TrajectorySpan> streams;
+    std::vector<Entry> entries;
+    std::vector<Entry> scratch;
+    std::vector<int> histogram;
+    const Push* pushes = nullptr;
+    pos pivot = pos{0,0};
+    size_t next = 0;
+    int reach = 0;
+
+    public:
+        void Clear() {
+            streams.clear();
+            entries.clear();
+            next = 0;
+            reach = 0;
+        }
+
+        // streams must be added in entity order, the trajectories must not move while merging
+        void AddStream(TrajectorySpan span) {
+            streams.push_back(span);
+            reach = std::max(reach, span.reach);
+        }
+
+        // furthest any event lands from the pivot along either axis
+        int Reach() const { return reach; }
+
+        // every push or step in stream order, relative to the pivot, without ordering them
+        template<typename Event, typename Visit>
+        void ForEach(const Event* data, Visit visit) const {
+            for (const TrajectorySpan& span : streams) {
+                for (const Event* event = data + span.first; event != data + span.first + span.count; event++) {
+                    visit(*event);
+                }
+            }
+        }
+
+        // orders the events at or after fromAngle, the ones before it are left out
+        void Start(const Push* data, pos pivotPosition, BinaryAngle fromAngle = 0) {
+            pushes = data;
+            pivot = pivotPosition;
+            next = 0;
+
+            entries.clear();
+            for (const TrajectorySpan& span : streams) {
+                for (int i = span.first; i < span.first + span.count; i++) {
+                    if (data[i].priority >= fromAngle)
+                        entries.push_back(Entry{data[i].priority, i});
+                }
+            }
+
+            // a few hundred events sort in four passes over small histograms faster than in
+            // three over large ones, clearing the large histograms would dominate
+            int bits = entries.size() < smallMergeSize ? smallRadixBits : radixBits;
+            int size = 1 << bits;
+            scratch.resize(entries.size());
+            histogram.resize(size);
+
+            for (int shift = 0; shift < 32; shift += bits) {
+                std::fill(histogram.begin(), histogram.end(), 0);
+                for (const Entry& entry : entries) {
+                    histogram[(entry.key >> shift) & (size - 1)]++;
+                }
+
+                int offset = 0;
+                for (int& count : histogram) {
+                    int bucket = count;
+                    count = offset;
+                    offset += bucket;
+                }
+
+                for (const Entry& entry : entries) {
+                    scratch[histogram[(entry.key >> shift) & (size - 1)]++] = entry;
+                }
+                entries.swap(scratch);
+            }
+        }
+
+        bool Next(Push& push) {
+            if (next == entries.size())
+                return false;
+
+            push = pushes[entries[next++].push];
+            push.fromPosition.x += pivot.x;
+            push.fromPosition.y += pivot.y;
+            return true;
+        }
+};
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "SimulationTypes.h"
+
+#include <vector>
+
+struct EntityRecord {
+    int entityIndex;
+    pos position;
+    Direction orientation;
+};
+
+struct TileRecord {
+    int tileIndex;
+    int entityIndex;
+};
+
+// a piece a turn made movable and the assembly it joined
+struct AttachRecord {
+    int entityIndex;
+    int assemblyIndex;
+};
+
+// undo log of everything a turn has written, replayed backwards on abort
+struct TurnJournal {
+    std::vector<EntityRecord> entities;
+    std::vector<TileRecord> tiles;
+    std::vector<int> movedEntities;
+
+    void Clear() {
+        entities.clear();
+        tiles.clear();
+        movedEntities.clear();
+    }
+};
@@ -0,0 +1,116 @@
+#pragma once
+
+// Per turn counters and timings, compiled in with -DPIPE_STATS. Without it the
+// STATS_ macros compile to nothing and none of their arguments are evaluated.
+
+#ifdef PIPE_STATS
+
+#include <algorithm>
+#include <chrono>
+
+typedef std::chrono::steady_clock StatsClock;
+
+struct TurnStats {
+    int rotationEvents;       // trajectory steps merged into the rotation event streams
+    int sweptEvents;          // events replayed from the first contact, none when nothing is in the way
+    int longestPushChain;     // most pieces one push moved or checked in a row
+    int movedPieces;
+    int blockedAssemblies;    // assemblies whose move or rotation did not go through
+    int resolutions;          // above the assembly count when parallel results were thrown away
+    int linkRefreshes;        // tiles whose links and those of their neighbours were recomputed
+    double resolveMicros;     // summed over assemblies, also when resolved on workers
+    double connectionMicros;
+    double turnMicros;
+
+    void Add(const TurnStats& other) {
+        rotationEvents += other.rotationEvents;
+        sweptEvents += other.sweptEvents;
+        longestPushChain = std::max(longestPushChain, other.longestPushChain);
+        movedPieces += other.movedPieces;
+        blockedAssemblies += other.blockedAssemblies;
+        resolutions += other.resolutions;
+        linkRefreshes += other.linkRefreshes;
+        resolveMicros += other.resolveMicros;
+        connectionMicros += other.connectionMicros;
+        turnMicros += other.turnMicros;
+    }
+};
+
+// turn durations of the last windowSize turns in power of two buckets,
+// bucket b holds turns shorter than 2^b microseconds that did not fit b - 1
+class TurnHistogram {
+    public:
+        static const int windowSize = 256;
+        static const int bucketCount = 24;
+
+    private:
+        unsigned char window[windowSize] = {};
+        int buckets[bucketCount] = {};
+        int sampleCount = 0;
+        int next = 0;
+
+    public:
+        static int Bucket(double micros) {
+            int bucket = 0;
+            while (bucket < bucketCount - 1 && micros >= static_cast<double>(1 << bucket))
+                bucket++;
+            return bucket;
+        }
+
+        void Add(double micros) {
+            if (sampleCount == windowSize)
+                buckets[window[next]]--;
+            else
+                sampleCount++;
+
+            int bucket = Bucket(micros);
+            window[next] = bucket;
+            buckets[bucket]++;
+            next = (next + 1) % windowSize;
+        }
+
+        int Count(int bucket) const { return buckets[bucket]; }
+        int SampleCount() const { return sampleCount; }
+
+        // upper bound in microseconds of the bucket holding the given fraction of recent turns
+        double Percentile(double fraction) const {
+            int wanted = std::max(1, static_cast<int>(fraction * sampleCount + 0.5));
+            int seen = 0;
+            for (int bucket = 0; bucket < bucketCount; bucket++) {
+                seen += buckets[bucket];
+                if (seen >= wanted)
+                    return static_cast<double>(1 << bucket);
+            }
+            return 0.;
+        }
+};
+
+struct PipeStats {
+    TurnStats lastTurn;
+    TurnStats totals;
+    int turns;
+    int blockedTurns;
+    TurnHistogram turnMicros;
+};
+
+inline double MicrosecondsSince(StatsClock::time_point start)
+{
+    return std::chrono::duration<double, std::micro>(StatsClock::now() - start).count();
+}
+
+#define STATS_RESET(stats) ((stats) = TurnStats{})
+#define STATS_ADD(stats, field, amount) ((stats).field += (amount))
+#define STATS_MAX(stats, field, value) ((stats).field = std::max((stats).field, static_cast<int>(value)))
+#define STATS_START_TIMER(name) StatsClock::time_point name = StatsClock::now()
+#define STATS_ADD_TIME(stats, field, name) ((stats).field += MicrosecondsSince(name))
+
+#else
+
+// sizeof keeps locals that only feed the counters referenced without evaluating them
+#define STATS_RESET(stats) ((void)0)
+#define STATS_ADD(stats, field, amount) ((void)sizeof(amount))
+#define STATS_MAX(stats, field, value) ((void)sizeof(value))
+#define STATS_START_TIMER(name) ((void)0)
+#define STATS_ADD_TIME(stats, field, name) ((void)0)
+
+#endif
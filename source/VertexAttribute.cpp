@@ -8,5 +8,5 @@ VertexAttribute::VertexAttribute(char const* _name, int _size, const int _count,
     buffer = 0;
     GlCall(glGenBuffers(1, &buffer));
     GlCall(glBindBuffer(GL_ARRAY_BUFFER, buffer));
-    GlCall(glBufferData(GL_ARRAY_BUFFER, size * NUMBER_OF_TILES * sizeof(float), data.get(), GL_STATIC_DRAW));
+    GlCall(glBufferData(GL_ARRAY_BUFFER, size * count * sizeof(float), data.get(), GL_STATIC_DRAW));
 }
@@ -0,0 +1,359 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// State keys seen by a search, each with a check of the state it was first given to and
+// the key and move it was first reached from, safe to insert into from many threads.
+// Keys are split into shards by their top bits, so threads rarely wait on the same lock
+// and every shard holds one key range. A shard is an open addressing table that doubles
+// when half full, up to its share of the memory budget. Past that the table is written
+// to the shard's unnamed temporary file as a run sorted by key and emptied, and a run is
+// merged with the one before it once it is as large, so a shard keeps a logarithmic
+// number of runs and a key missing from the table costs one block read per run. Key 0
+// marks an empty slot, so a zero key is stored as 1.
+class VisitedSet {
+    struct Entry {
+        uint64_t key;
+        uint64_t check;
+        uint64_t parent;
+        unsigned char move;
+    };
+
+    static constexpr size_t ENTRY_BYTES = 3 * sizeof(uint64_t) + 1;
+    static constexpr size_t RUN_BLOCK = 128;
+    static constexpr size_t MIN_SLOTS = 64;
+
+    struct Run {
+        long offset;
+        size_t count;
+        std::vector<uint64_t> blockKeys;   // first key of every block of RUN_BLOCK entries
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        std::vector<uint64_t> keys;
+        std::vector<uint64_t> checks;
+        std::vector<uint64_t> parents;
+        std::vector<unsigned char> moves;
+        size_t count = 0;
+
+        std::vector<Run> runs;
+        std::vector<Entry> block;
+        int64_t runEntries = 0;
+        FILE* file = nullptr;
+        long fileEnd = 0;
+        long fileBytes = 0;                // merged runs are moved down, the file stays this long
+        int64_t collisions = 0;
+
+        ~Shard() {
+            if (file)
+                fclose(file);
+        }
+    };
+
+    std::vector<std::unique_ptr<Shard>> shards;
+    int shardShift;
+    size_t shardBudget;
+
+    static uint64_t storedKey(uint64_t key) { return key ? key : 1; }
+
+    Shard& shardOf(uint64_t key) const { return *shards[key >> shardShift]; }
+
+    static size_t slotOf(const Shard& shard, uint64_t key) {
+        size_t mask = shard.keys.size() - 1;
+        size_t slot = key & mask;
+        while (shard.keys[slot] != 0 && shard.keys[slot] != key) {
+            slot = (slot + 1) & mask;
+        }
+        return slot;
+    }
+
+    static void reset(Shard& shard, size_t slots) {
+        shard.keys.assign(slots, 0);
+        shard.checks.assign(slots, 0);
+        shard.parents.assign(slots, 0);
+        shard.moves.assign(slots, 0);
+        shard.count = 0;
+    }
+
+    static void grow(Shard& shard) {
+        std::vector<uint64_t> keys(shard.keys.size() * 2, 0);
+        std::vector<uint64_t> checks(keys.size());
+        std::vector<uint64_t> parents(keys.size());
+        std::vector<unsigned char> moves(keys.size());
+        keys.swap(shard.keys);
+        checks.swap(shard.checks);
+        parents.swap(shard.parents);
+        moves.swap(shard.moves);
+
+        for (size_t k = 0; k < keys.size(); k++) {
+            if (keys[k] == 0)
+                continue;
+
+            size_t slot = slotOf(shard, keys[k]);
+            shard.keys[slot] = keys[k];
+            shard.checks[slot] = checks[k];
+            shard.parents[slot] = parents[k];
+            shard.moves[slot] = moves[k];
+        }
+    }
+
+    // appends entries to the end of the shard's file as the next part of run
+    static bool writeEntries(Shard& shard, Run& run, const Entry* entries, size_t count) {
+        std::vector<unsigned char> bytes(count * ENTRY_BYTES);
+        for (size_t k = 0; k < count; k++) {
+            unsigned char* out = bytes.data() + k * ENTRY_BYTES;
+            memcpy(out, &entries[k].key, sizeof(uint64_t));
+            memcpy(out + sizeof(uint64_t), &entries[k].check, sizeof(uint64_t));
+            memcpy(out + 2 * sizeof(uint64_t), &entries[k].parent, sizeof(uint64_t));
+            out[3 * sizeof(uint64_t)] = entries[k].move;
+            if ((run.count + k) % RUN_BLOCK == 0)
+                run.blockKeys.push_back(entries[k].key);
+        }
+
+        if (fseek(shard.file, shard.fileEnd, SEEK_SET) != 0 ||
+            fwrite(bytes.data(), 1, bytes.size(), shard.file) != bytes.size())
+            return false;
+
+        run.count += count;
+        shard.fileEnd += bytes.size();
+        shard.fileBytes = std::max(shard.fileBytes, shard.fileEnd);
+        return true;
+    }
+
+    // reads the block of run that starts at entry first into the shard's block buffer
+    static bool readBlock(Shard& shard, const Run& run, size_t first) {
+        size_t count = std::min(RUN_BLOCK, run.count - first);
+        unsigned char bytes[RUN_BLOCK * ENTRY_BYTES];
+        if (fseek(shard.file, run.offset + first * ENTRY_BYTES, SEEK_SET) != 0 ||
+            fread(bytes, 1, count * ENTRY_BYTES, shard.file) != count * ENTRY_BYTES)
+            return false;
+
+        shard.block.resize(count);
+        for (size_t k = 0; k < count; k++) {
+            const unsigned char* in = bytes + k * ENTRY_BYTES;
+            memcpy(&shard.block[k].key, in, sizeof(uint64_t));
+            memcpy(&shard.block[k].check, in + sizeof(uint64_t), sizeof(uint64_t));
+            memcpy(&shard.block[k].parent, in + 2 * sizeof(uint64_t), sizeof(uint64_t));
+            shard.block[k].move = in[3 * sizeof(uint64_t)];
+        }
+        return true;
+    }
+
+    // runs hold disjoint keys, so the first run with the key has the only entry
+    static bool findOnDisk(Shard& shard, uint64_t key, Entry& entry) {
+        for (const Run& run : shard.runs) {
+            size_t block = std::upper_bound(run.blockKeys.begin(), run.blockKeys.end(), key) - run.blockKeys.begin();
+            if (block == 0 || !readBlock(shard, run, (block - 1) * RUN_BLOCK))
+                continue;
+
+            auto found = std::lower_bound(shard.block.begin(), shard.block.end(), key,
+                                          [](const Entry& e, uint64_t k) { return e.key < k; });
+            if (found != shard.block.end() && found->key == key) {
+                entry = *found;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // merges the last two runs into one and moves it down to where the first began
+    static bool mergeLastRuns(Shard& shard) {
+        Run second = std::move(shard.runs.back());
+        shard.runs.pop_back();
+        Run first = std::move(shard.runs.back());
+        shard.runs.pop_back();
+
+        Run merged{shard.fileEnd, 0, {}};
+        std::vector<Entry> blocks[2];
+        std::vector<Entry> out;
+        const Run* sources[2] = {&first, &second};
+        size_t read[2] = {0, 0};
+        size_t next[2] = {0, 0};
+        bool isOk = true;
+
+        while (isOk) {
+            for (int s = 0; s < 2 && isOk; s++) {
+                if (next[s] == blocks[s].size() && read[s] < sources[s]->count) {
+                    isOk = readBlock(shard, *sources[s], read[s]);
+                    blocks[s].swap(shard.block);
+                    read[s] += blocks[s].size();
+                    next[s] = 0;
+                }
+            }
+
+            bool hasFirst = next[0] < blocks[0].size();
+            bool hasSecond = next[1] < blocks[1].size();
+            if (!isOk || (!hasFirst && !hasSecond))
+                break;
+
+            int s = hasFirst && (!hasSecond || blocks[0][next[0]].key < blocks[1][next[1]].key) ? 0 : 1;
+            out.push_back(blocks[s][next[s]++]);
+            if (out.size() == RUN_BLOCK) {
+                isOk = writeEntries(shard, merged, out.data(), out.size());
+                out.clear();
+            }
+        }
+
+        if (isOk && !out.empty())
+            isOk = writeEntries(shard, merged, out.data(), out.size());
+        if (!isOk) {
+            shard.fileEnd = merged.offset;
+            shard.runs.push_back(std::move(first));
+            shard.runs.push_back(std::move(second));
+            return false;
+        }
+
+        // the merged run is whole past the two it replaces, so a failed move keeps it there
+        long bytes = merged.count * ENTRY_BYTES;
+        std::vector<unsigned char> buffer(RUN_BLOCK * ENTRY_BYTES);
+        for (long done = 0; done < bytes; done += buffer.size()) {
+            size_t size = std::min<long>(buffer.size(), bytes - done);
+            if (fseek(shard.file, merged.offset + done, SEEK_SET) != 0 ||
+                fread(buffer.data(), 1, size, shard.file) != size ||
+                fseek(shard.file, first.offset + done, SEEK_SET) != 0 ||
+                fwrite(buffer.data(), 1, size, shard.file) != size) {
+                shard.runs.push_back(std::move(merged));
+                return true;
+            }
+        }
+
+        merged.offset = first.offset;
+        shard.fileEnd = first.offset + bytes;
+        shard.runs.push_back(std::move(merged));
+        return true;
+    }
+
+    // writes the table out as a new run, false when the disk refuses it
+    static bool spill(Shard& shard) {
+        std::vector<Entry> entries;
+        entries.reserve(shard.count);
+        for (size_t slot = 0; slot < shard.keys.size(); slot++) {
+            if (shard.keys[slot] != 0)
+                entries.push_back(Entry{shard.keys[slot], shard.checks[slot], shard.parents[slot], shard.moves[slot]});
+        }
+        std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.key < b.key; });
+
+        if (!shard.file)
+            shard.file = tmpfile();
+        Run run{shard.fileEnd, 0, {}};
+        if (!shard.file || !writeEntries(shard, run, entries.data(), entries.size())) {
+            shard.fileEnd = run.offset;
+            return false;
+        }
+
+        shard.runs.push_back(std::move(run));
+        shard.runEntries += entries.size();
+        while (shard.runs.size() >= 2 && shard.runs.back().count >= shard.runs[shard.runs.size() - 2].count) {
+            if (!mergeLastRuns(shard))
+                break;
+        }
+        return true;
+    }
+
+    public:
+        // a table stays in memory over its share of the budget when the disk refuses it
+        explicit VisitedSet(size_t memoryBudget = SIZE_MAX, int shardBits = 6) {
+            shardShift = 64 - shardBits;
+            shardBudget = memoryBudget >> shardBits;
+            for (int k = 0; k < (1 << shardBits); k++) {
+                shards.push_back(std::make_unique<Shard>());
+                reset(*shards.back(), MIN_SLOTS);
+            }
+        }
+
+        VisitedSet(const VisitedSet&) = delete;
+        VisitedSet& operator=(const VisitedSet&) = delete;
+
+        // false when the key was already there, its check, parent and move are kept. A
+        // key seen with another check is counted as a collision.
+        bool Insert(uint64_t key, uint64_t check, uint64_t parent, unsigned char move) {
+            key = storedKey(key);
+            Shard& shard = shardOf(key);
+            std::lock_guard<std::mutex> lock(shard.mutex);
+
+            size_t slot = slotOf(shard, key);
+            Entry seen;
+            if (shard.keys[slot] == key) {
+                shard.collisions += shard.checks[slot] != check;
+                return false;
+            }
+            if (!shard.runs.empty() && findOnDisk(shard, key, seen)) {
+                shard.collisions += seen.check != check;
+                return false;
+            }
+
+            shard.keys[slot] = key;
+            shard.checks[slot] = check;
+            shard.parents[slot] = parent;
+            shard.moves[slot] = move;
+            if (++shard.count * 2 > shard.keys.size()) {
+                bool isOverBudget = shard.keys.size() * 2 * ENTRY_BYTES > shardBudget;
+                if (isOverBudget && spill(shard))
+                    reset(shard, MIN_SLOTS);
+                else
+                    grow(shard);
+            }
+            return true;
+        }
+
+        // not safe while other threads insert
+        bool Find(uint64_t key, uint64_t& parent, unsigned char& move) {
+            key = storedKey(key);
+            Shard& shard = shardOf(key);
+            size_t slot = slotOf(shard, key);
+            Entry seen;
+            if (shard.keys[slot] == key) {
+                seen.parent = shard.parents[slot];
+                seen.move = shard.moves[slot];
+            } else if (!findOnDisk(shard, key, seen)) {
+                return false;
+            }
+
+            parent = seen.parent;
+            move = seen.move;
+            return true;
+        }
+
+        int64_t Count() const {
+            int64_t count = 0;
+            for (const std::unique_ptr<Shard>& shard : shards) {
+                count += shard->count + shard->runEntries;
+            }
+            return count;
+        }
+
+        // tables and the block index of the runs
+        int64_t Bytes() const {
+            int64_t bytes = 0;
+            for (const std::unique_ptr<Shard>& shard : shards) {
+                bytes += shard->keys.size() * ENTRY_BYTES;
+                for (const Run& run : shard->runs) {
+                    bytes += run.blockKeys.size() * sizeof(uint64_t);
+                }
+            }
+            return bytes;
+        }
+
+        int64_t SpilledBytes() const {
+            int64_t bytes = 0;
+            for (const std::unique_ptr<Shard>& shard : shards) {
+                bytes += shard->fileBytes;
+            }
+            return bytes;
+        }
+
+        int64_t Collisions() const {
+            int64_t collisions = 0;
+            for (const std::unique_ptr<Shard>& shard : shards) {
+                collisions += shard->collisions;
+            }
+            return collisions;
+        }
+};
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#endif
+
+// elementwise operations on arrays of 64-bit words, shared by the bitset and bitboard types.
+// AVX2 handles four words per step on native builds, SIMD128 two on the web build
+
+inline void OrWords(uint64_t* destination, const uint64_t* source, size_t count)
+{
+    size_t i = 0;
+#if defined(__AVX2__)
+    for (; i + 4 <= count; i += 4) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(destination + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + i), _mm256_or_si256(a, b));
+    }
+#elif defined(__wasm_simd128__)
+    for (; i + 2 <= count; i += 2) {
+        v128_t a = wasm_v128_load(destination + i);
+        v128_t b = wasm_v128_load(source + i);
+        wasm_v128_store(destination + i, wasm_v128_or(a, b));
+    }
+#endif
+    for (; i < count; i++) {
+        destination[i] |= source[i];
+    }
+}
+
+inline void AndWords(uint64_t* destination, const uint64_t* source, size_t count)
+{
+    size_t i = 0;
+#if defined(__AVX2__)
+    for (; i + 4 <= count; i += 4) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(destination + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + i), _mm256_and_si256(a, b));
+    }
+#elif defined(__wasm_simd128__)
+    for (; i + 2 <= count; i += 2) {
+        v128_t a = wasm_v128_load(destination + i);
+        v128_t b = wasm_v128_load(source + i);
+        wasm_v128_store(destination + i, wasm_v128_and(a, b));
+    }
+#endif
+    for (; i < count; i++) {
+        destination[i] &= source[i];
+    }
+}
+
+// destination &= ~source
+inline void AndNotWords(uint64_t* destination, const uint64_t* source, size_t count)
+{
+    size_t i = 0;
+#if defined(__AVX2__)
+    for (; i + 4 <= count; i += 4) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(destination + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + i), _mm256_andnot_si256(b, a));
+    }
+#elif defined(__wasm_simd128__)
+    for (; i + 2 <= count; i += 2) {
+        v128_t a = wasm_v128_load(destination + i);
+        v128_t b = wasm_v128_load(source + i);
+        wasm_v128_store(destination + i, wasm_v128_andnot(a, b));
+    }
+#endif
+    for (; i < count; i++) {
+        destination[i] &= ~source[i];
+    }
+}
+
+// destination |= a & b, returns whether destination gained any bit
+inline bool OrAndWords(uint64_t* destination, const uint64_t* a, const uint64_t* b, size_t count)
+{
+    uint64_t gained = 0;
+    size_t i = 0;
+#if defined(__AVX2__)
+    __m256i gainedVector = _mm256_setzero_si256();
+    for (; i + 4 <= count; i += 4) {
+        __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(destination + i));
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+        __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+        __m256i added = _mm256_andnot_si256(d, _mm256_and_si256(x, y));
+        gainedVector = _mm256_or_si256(gainedVector, added);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + i), _mm256_or_si256(d, added));
+    }
+    gained = !_mm256_testz_si256(gainedVector, gainedVector);
+#elif defined(__wasm_simd128__)
+    v128_t gainedVector = wasm_i64x2_splat(0);
+    for (; i + 2 <= count; i += 2) {
+        v128_t d = wasm_v128_load(destination + i);
+        v128_t x = wasm_v128_load(a + i);
+        v128_t y = wasm_v128_load(b + i);
+        v128_t added = wasm_v128_andnot(wasm_v128_and(x, y), d);
+        gainedVector = wasm_v128_or(gainedVector, added);
+        wasm_v128_store(destination + i, wasm_v128_or(d, added));
+    }
+    gained = wasm_v128_any_true(gainedVector);
+#endif
+    for (; i < count; i++) {
+        uint64_t added = a[i] & b[i] & ~destination[i];
+        gained |= added;
+        destination[i] |= added;
+    }
+    return gained != 0;
+}
+
+// destination = (source << bits) & mask, the same shift and mask for every word
+inline void ShiftLeftMaskWords(uint64_t* destination, const uint64_t* source, size_t count, int bits, uint64_t mask)
+{
+    size_t i = 0;
+#if defined(__AVX2__)
+    __m256i maskVector = _mm256_set1_epi64x(static_cast<long long>(mask));
+    __m128i shift = _mm_cvtsi32_si128(bits);
+    for (; i + 4 <= count; i += 4) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + i), _mm256_and_si256(_mm256_sll_epi64(a, shift), maskVector));
+    }
+#elif defined(__wasm_simd128__)
+    v128_t maskVector = wasm_i64x2_splat(static_cast<int64_t>(mask));
+    for (; i + 2 <= count; i += 2) {
+        v128_t a = wasm_v128_load(source + i);
+        wasm_v128_store(destination + i, wasm_v128_and(wasm_i64x2_shl(a, bits), maskVector));
+    }
+#endif
+    for (; i < count; i++) {
+        destination[i] = (source[i] << bits) & mask;
+    }
+}
+
+// destination = source >> bits
+inline void ShiftRightWords(uint64_t* destination, const uint64_t* source, size_t count, int bits)
+{
+    size_t i = 0;
+#if defined(__AVX2__)
+    __m128i shift = _mm_cvtsi32_si128(bits);
+    for (; i + 4 <= count; i += 4) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + i), _mm256_srl_epi64(a, shift));
+    }
+#elif defined(__wasm_simd128__)
+    for (; i + 2 <= count; i += 2) {
+        v128_t a = wasm_v128_load(source + i);
+        wasm_v128_store(destination + i, wasm_u64x2_shr(a, bits));
+    }
+#endif
+    for (; i < count; i++) {
+        destination[i] = source[i] >> bits;
+    }
+}
+
+inline bool AnyWords(const uint64_t* words, size_t count)
+{
+    uint64_t any = 0;
+    for (size_t i = 0; i < count; i++) {
+        any |= words[i];
+    }
+    return any != 0;
+}
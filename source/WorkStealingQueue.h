@@ -0,0 +1,55 @@
+#pragma once
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Task ids dealt out to one deque per worker. A worker takes from the back of its own
+// deque and, once that runs dry, steals from the front of the others, so workers that
+// drew cheap tasks help the ones that drew expensive ones.
+class WorkStealingQueue {
+    struct Deque {
+        std::mutex mutex;
+        std::deque<int> tasks;
+    };
+
+    std::vector<std::unique_ptr<Deque>> deques;
+
+    public:
+        void Reset(int workerCount) {
+            while (deques.size() < static_cast<size_t>(workerCount)) {
+                deques.push_back(std::make_unique<Deque>());
+            }
+            deques.resize(workerCount);
+            for (std::unique_ptr<Deque>& deque : deques) {
+                deque->tasks.clear();
+            }
+        }
+
+        void Push(int worker, int task) {
+            Deque& deque = *deques[worker];
+            std::lock_guard<std::mutex> lock(deque.mutex);
+            deque.tasks.push_back(task);
+        }
+
+        bool Pop(int worker, int& task) {
+            int count = deques.size();
+            for (int k = 0; k < count; k++) {
+                Deque& deque = *deques[(worker + k) % count];
+                std::lock_guard<std::mutex> lock(deque.mutex);
+                if (deque.tasks.empty())
+                    continue;
+
+                if (k == 0) {
+                    task = deque.tasks.back();
+                    deque.tasks.pop_back();
+                } else {
+                    task = deque.tasks.front();
+                    deque.tasks.pop_front();
+                }
+                return true;
+            }
+            return false;
+        }
+};
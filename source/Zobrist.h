@@ -0,0 +1,32 @@
+#pragma once
+
+#include "SimulationTypes.h"
+#include "Board.h"
+#include "BoardRegion.h"
+
+#include <stdint.h>
+
+// Keys of the board hash, which XORs one key per piece into a key for the board size, so
+// a piece that moves, turns or becomes movable changes it by two keys. Keys are mixed from
+// the tile and the packed piece rather than drawn into a table, one over every tile of a
+// large board would outweigh the board, so a board hashes the same across runs, tile
+// layouts and the order its pieces were added in.
+inline uint64_t MixZobrist(uint64_t value)
+{
+    // splitmix64
+    value += 0x9E3779B97F4A7C15ull;
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+    return value ^ (value >> 31);
+}
+
+inline uint64_t ZobristPieceKey(pos position, PackedTile tile)
+{
+    return MixZobrist((static_cast<uint64_t>(static_cast<uint32_t>(position.x)) << 36) ^
+                      (static_cast<uint64_t>(static_cast<uint32_t>(position.y)) << 8) ^ tile);
+}
+
+inline uint64_t ZobristBoardKey(BoardGeometry geometry)
+{
+    return MixZobrist(~((static_cast<uint64_t>(geometry.columns) << 32) | static_cast<uint32_t>(geometry.rows)));
+}
@@ -6,8 +6,8 @@
 #include <emscripten/emscripten.h>
 #include <iostream>
 #include <memory>
-#include <algorithm>
-#include <math.h>
+
+#include "SimulationTypes.h"
 
 #define GlCall(x) GlClearError();\
     x;\
@@ -34,8 +34,6 @@ static bool GlLogCall(const char* function, const char* file, int line) {
 #define PIXEL_WIDTH 800
 #define PIXEL_HEIGHT 640
 
-#define TILES_COLUMNS 20
-#define TILES_ROWS 16
 #define TILE_SIZE PIXEL_HEIGHT / TILES_ROWS
 #define NUMBER_OF_TILES TILES_COLUMNS * TILES_ROWS
 #define POSITIONS_LENGTH NUMBER_OF_TILES * 2
@@ -48,49 +46,3 @@ enum class VertexAttributeType {
 };
 
 #define VERTEX_ATTR_COUNT static_cast<int>(VertexAttributeType::Count)
-
-enum class EntityType {
-    BACKGROUND, PLAYER, BENT_PIPE, STRAIGHT_PIPE, BOX, Count
-};
-
-#define ENTITY_TYPE_COUNT static_cast<int>(EntityType::Count)
-
-enum Direction {
-    UP, LEFT, DOWN, RIGHT
-};
-
-enum class ShaderType {
-    NONE,
-    PIPE_SHADOW,
-    PIPE,
-    BACKGROUND,
-    Count
-};
-
-#define SHADER_TYPE_COUNT static_cast<int>(ShaderType::Count)
-
-struct RotationCounts {
-    unsigned int leftRotations;
-    unsigned int rightRotations;
-};
-
-struct posf {
-    union {
-        struct {
-            float x, y;
-        };
-        struct {
-            float array[2];
-        };
-    };
-};
-
-struct pos {
-    int x, y;
-};
-
-struct Push {
-    float priority;
-    posf fromPosition;
-    Direction direction;
-};
\ No newline at end of file
@@ -0,0 +1,127 @@
+// Loads a board, plays a string of moves on it and prints the board it ends on, with the
+// time every move took. Built natively against the simulation library, see the Makefile.
+//
+//     pipe_cli [-b board.txt] [-r repeats] [-q] moves
+//
+// moves: w a s d move up, left, down and right, L and R rotate left and right.
+// Without -b the game's own starting board is used, boards are read as in BoardText.h.
+// With -r the moves are played repeats times from the start and timings are averaged.
+
+#include "EntityManager.h"
+#include "BoardText.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct Move {
+    Direction direction;
+    bool isRotation;
+};
+
+static bool ParseMoves(const std::string& text, std::vector<Move>& moves)
+{
+    for (char c : text) {
+        switch (c) {
+            case 'w': moves.push_back(Move{UP, false}); break;
+            case 'a': moves.push_back(Move{LEFT, false}); break;
+            case 's': moves.push_back(Move{DOWN, false}); break;
+            case 'd': moves.push_back(Move{RIGHT, false}); break;
+            case 'L': moves.push_back(Move{LEFT, true}); break;
+            case 'R': moves.push_back(Move{RIGHT, true}); break;
+            default:
+                fprintf(stderr, "unknown move '%c', moves are w a s d L R\n", c);
+                return false;
+        }
+    }
+    return true;
+}
+
+static int Usage()
+{
+    fprintf(stderr, "usage: pipe_cli [-b board.txt] [-r repeats] [-q] moves\n");
+    return 2;
+}
+
+int main(int argc, char* argv[])
+{
+    const char* boardPath = nullptr;
+    const char* moveText = nullptr;
+    int repeats = 1;
+    bool isQuiet = false;
+
+    for (int k = 1; k < argc; k++) {
+        std::string argument = argv[k];
+        if (argument == "-b" && k + 1 < argc)
+            boardPath = argv[++k];
+        else if (argument == "-r" && k + 1 < argc)
+            repeats = std::max(1, atoi(argv[++k]));
+        else if (argument == "-q")
+            isQuiet = true;
+        else if (!moveText && argument[0] != '-')
+            moveText = argv[k];
+        else
+            return Usage();
+    }
+
+    if (!moveText)
+        return Usage();
+
+    std::vector<Move> moves;
+    if (!ParseMoves(moveText, moves))
+        return 2;
+
+    EntityManager start;
+    if (boardPath) {
+        std::ifstream file(boardPath);
+        if (!file) {
+            fprintf(stderr, "cannot read %s\n", boardPath);
+            return 1;
+        }
+
+        std::stringstream text;
+        text << file.rdbuf();
+        std::string error;
+        if (!ParseBoardText(text.str(), start, error)) {
+            fprintf(stderr, "%s: %s\n", boardPath, error.c_str());
+            return 1;
+        }
+    }
+
+    std::vector<double> micros(moves.size(), 0.);
+    std::vector<char> isOk(moves.size(), true);
+    EntityManager em;
+
+    for (int round = 0; round < repeats; round++) {
+        em = start;
+        for (size_t m = 0; m < moves.size(); m++) {
+            auto before = std::chrono::steady_clock::now();
+            em.RunTurn(moves[m].direction, moves[m].isRotation);
+            auto after = std::chrono::steady_clock::now();
+            micros[m] += std::chrono::duration<double, std::micro>(after - before).count();
+            isOk[m] = em.isTurnOk;
+        }
+    }
+
+    double total = 0.;
+    for (size_t m = 0; m < moves.size(); m++) {
+        micros[m] /= repeats;
+        total += micros[m];
+        if (!isQuiet)
+            printf("%c %-8s %10.2f us\n", moveText[m], isOk[m] ? "ok" : "blocked", micros[m]);
+    }
+
+    if (!isQuiet)
+        printf("\n%s\n", FormatBoardText(em).c_str());
+
+    const FlowStatus& flow = em.EvaluateFlow();
+    printf("%dx%d board, %u pieces, %d movable, %d connected paths, %d closed loops\n",
+           em.board.columns, em.board.rows, em.numEntities, em.isMovable.Count(em.numEntities),
+           flow.connectedPaths, flow.closedLoops);
+    printf("%zu moves in %.2f us, %.2f us per move\n", moves.size(), total, moves.empty() ? 0. : total / moves.size());
+    return 0;
+}
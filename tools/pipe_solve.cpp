@@ -0,0 +1,100 @@
+// Finds the fewest moves that bring a board to a goal flow, searching every move from
+// every reachable board. Built natively against the simulation library, see the Makefile.
+//
+//     pipe_solve [-b board.txt] [-p paths] [-l loops] [-t threads] [-d depth] [-s states] [-m megabytes] [-v megabytes]
+//
+// The goal is at least paths sources joined to sinks (1 by default) and loops closed loops
+// (0 by default). Without -b the game's own starting board is used, boards are read as in
+// BoardText.h. -t sets the worker threads, one per hardware thread by default, -d and -s
+// stop the search after that many moves or distinct boards, and -m and -v bound the
+// megabytes of a search level and of the boards already seen kept in memory before the
+// rest is written to temporary files.
+
+#include "EntityManager.h"
+#include "BoardText.h"
+#include "Solver.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+static int Usage()
+{
+    fprintf(stderr, "usage: pipe_solve [-b board.txt] [-p paths] [-l loops] [-t threads] [-d depth] [-s states] [-m megabytes] [-v megabytes]\n");
+    return 2;
+}
+
+int main(int argc, char* argv[])
+{
+    const char* boardPath = nullptr;
+    SolverOptions options;
+
+    for (int k = 1; k < argc; k++) {
+        std::string argument = argv[k];
+        if (k + 1 >= argc)
+            return Usage();
+
+        if (argument == "-b")
+            boardPath = argv[++k];
+        else if (argument == "-p")
+            options.goal.connectedPaths = atoi(argv[++k]);
+        else if (argument == "-l")
+            options.goal.closedLoops = atoi(argv[++k]);
+        else if (argument == "-t")
+            options.threadCount = atoi(argv[++k]);
+        else if (argument == "-d")
+            options.maxDepth = atoi(argv[++k]);
+        else if (argument == "-s")
+            options.maxStates = atoll(argv[++k]);
+        else if (argument == "-m")
+            options.frontierMemory = static_cast<size_t>(std::max(1, atoi(argv[++k]))) << 20;
+        else if (argument == "-v")
+            options.visitedMemory = static_cast<size_t>(std::max(1, atoi(argv[++k]))) << 20;
+        else
+            return Usage();
+    }
+
+    EntityManager start;
+    if (boardPath) {
+        std::ifstream file(boardPath);
+        if (!file) {
+            fprintf(stderr, "cannot read %s\n", boardPath);
+            return 1;
+        }
+
+        std::stringstream text;
+        text << file.rdbuf();
+        std::string error;
+        if (!ParseBoardText(text.str(), start, error)) {
+            fprintf(stderr, "%s: %s\n", boardPath, error.c_str());
+            return 1;
+        }
+    }
+
+    SolverResult result = SolvePuzzle(start, options);
+    if (!result.error.empty()) {
+        fprintf(stderr, "%s\n", result.error.c_str());
+        return 1;
+    }
+
+    if (result.isSolved)
+        printf("solved in %zu moves: %s%s\n", result.moves.size(), result.moves.c_str(),
+               result.isVerified ? "" : " (replaying them does NOT reach the goal)");
+    else if (result.isLimitReached)
+        printf("no solution within %d moves and %lld boards\n", result.depth, static_cast<long long>(result.statesVisited));
+    else
+        printf("no solution, all %lld reachable boards searched\n", static_cast<long long>(result.statesVisited));
+
+    printf("%lld states explored, %lld visited, in %.2f s on %d threads and %d cores, %.0f states per second per core\n",
+           static_cast<long long>(result.statesExplored), static_cast<long long>(result.statesVisited),
+           result.seconds, result.threadCount, result.coreCount, result.StatesPerSecondPerCore());
+    printf("visited set %.1f MB in memory, %.1f MB of levels and visited boards spilled to disk\n",
+           result.visitedBytes / 1048576., result.spilledBytes / 1048576.);
+    if (result.keyCollisions > 0)
+        printf("%lld boards shared a key with another and were skipped, the solution may not be a shortest one\n",
+               static_cast<long long>(result.keyCollisions));
+
+    return result.isSolved && result.isVerified ? 0 : 1;
+}